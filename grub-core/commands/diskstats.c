@@ -0,0 +1,105 @@
+/* diskstats.c - per-disk I/O statistics  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/command.h>
+#include <grub/i18n.h>
+#include <grub/disk.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+static int
+disk_selected (const char *name, int argc, char **argv)
+{
+  int i;
+
+  if (argc == 0)
+    return 1;
+
+  for (i = 0; i < argc; i++)
+    {
+      const char *arg = argv[i];
+      grub_size_t len = grub_strlen (arg);
+
+      /* Accept both `hd0' and `(hd0)'.  */
+      if (len >= 2 && arg[0] == '(' && arg[len - 1] == ')')
+	{
+	  if (grub_strlen (name) == len - 2
+	      && grub_strncmp (name, arg + 1, len - 2) == 0)
+	    return 1;
+	}
+      else if (grub_strcmp (name, arg) == 0)
+	return 1;
+    }
+
+  return 0;
+}
+
+static grub_err_t
+grub_cmd_diskstats (struct grub_command *cmd __attribute__ ((unused)),
+		    int argc, char *argv[])
+{
+  struct grub_disk_stats *stats;
+
+  if (!grub_disk_stats_list)
+    {
+      grub_puts_ (N_("No disk statistics available"));
+      return 0;
+    }
+
+  for (stats = grub_disk_stats_list; stats; stats = stats->next)
+    {
+      grub_uint64_t total = stats->cache_hits + stats->cache_misses;
+      unsigned long ratio = 0;
+
+      if (!disk_selected (stats->name, argc, argv))
+	continue;
+
+      if (total)
+	ratio = grub_divmod64 (stats->cache_hits * 10000, total, 0);
+
+      grub_printf ("(%s):\n", stats->name);
+      grub_printf_ (N_("  cache hits: %llu (%lu.%02lu%%), misses: %llu\n"),
+		    (unsigned long long) stats->cache_hits,
+		    ratio / 100, ratio % 100,
+		    (unsigned long long) stats->cache_misses);
+      grub_printf_ (N_("  read %llu bytes in %llu calls, taking %llu ms\n"),
+		    (unsigned long long) stats->bytes_read,
+		    (unsigned long long) stats->read_calls,
+		    (unsigned long long) stats->read_time_ms);
+    }
+
+  return 0;
+}
+
+static grub_command_t cmd_diskstats;
+
+GRUB_MOD_INIT(diskstats)
+{
+  cmd_diskstats =
+    grub_register_command ("diskstats", grub_cmd_diskstats,
+			   N_("[DISK...]"),
+			   N_("Show disk cache and I/O statistics."));
+}
+
+GRUB_MOD_FINI(diskstats)
+{
+  grub_unregister_command (cmd_diskstats);
+}
@@ -0,0 +1,115 @@
+/* mmstats.c - heap and slab statistics  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/command.h>
+#include <grub/i18n.h>
+#include <grub/mm.h>
+#include <grub/mm_private.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+static unsigned long
+percent (grub_size_t part, grub_size_t whole)
+{
+  if (!whole)
+    return 0;
+  return grub_divmod64 ((grub_uint64_t) part * 100, whole, 0);
+}
+
+static grub_err_t
+grub_cmd_mmstats (struct grub_command *cmd __attribute__ ((unused)),
+		  int argc __attribute__ ((unused)),
+		  char *argv[] __attribute__ ((unused)))
+{
+  struct grub_mm_slab_stats slabs[GRUB_MM_SLAB_CLASSES];
+  grub_mm_region_t r;
+  grub_size_t total_free = 0, total_largest = 0, total_size = 0;
+  unsigned i;
+
+  grub_mm_get_slab_stats (slabs);
+  grub_puts_ (N_("Slabs:"));
+  grub_puts_ (N_("    size  slabs  objects     used  occupancy"));
+  for (i = 0; i < GRUB_MM_SLAB_CLASSES; i++)
+    grub_printf ("  %6lu %6lu %8lu %8lu  %8lu%%\n",
+		 (unsigned long) slabs[i].obj_size,
+		 (unsigned long) slabs[i].slabs,
+		 (unsigned long) slabs[i].objects,
+		 (unsigned long) slabs[i].used,
+		 percent (slabs[i].used, slabs[i].objects));
+
+  grub_puts_ (N_("Regions:"));
+  for (r = grub_mm_base; r; r = r->next)
+    {
+      grub_size_t free = 0, largest = 0, blocks = 0;
+      grub_mm_header_t p;
+
+      /* A region with nothing free has an allocated block as its head.  */
+      if (r->first->magic == GRUB_MM_FREE_MAGIC)
+	{
+	  p = r->first;
+	  do
+	    {
+	      grub_size_t size = p->size << GRUB_MM_ALIGN_LOG2;
+
+	      free += size;
+	      if (size > largest)
+		largest = size;
+	      blocks++;
+	      p = p->next;
+	    }
+	  while (p != r->first);
+	}
+
+      grub_printf_ (N_("  %p: %lu KiB, %lu KiB free in %lu blocks,"
+		       " largest %lu KiB\n"),
+		    r, (unsigned long) (r->size >> 10),
+		    (unsigned long) (free >> 10), (unsigned long) blocks,
+		    (unsigned long) (largest >> 10));
+
+      total_size += r->size;
+      total_free += free;
+      if (largest > total_largest)
+	total_largest = largest;
+    }
+
+  /* The share of free memory that a request as large as possible could
+     not use.  */
+  grub_printf_ (N_("Heap: %lu KiB, %lu KiB free, fragmentation %lu%%\n"),
+		(unsigned long) (total_size >> 10),
+		(unsigned long) (total_free >> 10),
+		total_free ? 100 - percent (total_largest, total_free) : 0);
+
+  return 0;
+}
+
+static grub_command_t cmd_mmstats;
+
+GRUB_MOD_INIT(mmstats)
+{
+  cmd_mmstats =
+    grub_register_command ("mmstats", grub_cmd_mmstats, 0,
+			   N_("Show heap fragmentation and slab usage."));
+}
+
+GRUB_MOD_FINI(mmstats)
+{
+  grub_unregister_command (cmd_mmstats);
+}
@@ -30,6 +30,9 @@
 #ifdef GRUB_UTIL
 #include <grub/emu/hostdisk.h>
 #endif
+#ifdef __x86_64__
+#include <grub/i386/cpuid.h>
+#endif
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -221,6 +224,327 @@ lrw_xor (const struct lrw_sector *sec,
 		   dev->lrw_precalc, sec->low_byte * GRUB_CRYPTODISK_GF_BYTES);
 }
 
+#ifdef __x86_64__
+/* AES-NI versions of the XTS and CBC loops.  Only used when the CPU has
+   the AES instructions and both the data and IV ciphers are AES.  */
+
+#define CPUID_FEATURE_AES (1 << 25)
+
+/* With -mno-sse the compiler never allocates the SSE registers itself and
+   refuses to accept them in clobber lists.  Stick to %xmm0-%xmm4: the rest
+   are callee-saved in the MS ABI.  */
+#ifdef __SSE__
+#define AESNI_CLOBBERS , "xmm0", "xmm1", "xmm2", "xmm3", "xmm4"
+#else
+#define AESNI_CLOBBERS
+#endif
+
+#define AESNI_MAX_ROUNDS 14
+/* Blocks handled per pass over the tweak or ciphertext copy.  */
+#define AESNI_BATCH 32
+
+struct aesni_key
+{
+  grub_uint8_t rk[AESNI_MAX_ROUNDS + 1][16];
+  int rounds;
+};
+
+struct grub_cryptodisk_aesni
+{
+  struct aesni_key enc;
+  struct aesni_key dec;
+  /* XTS tweak key.  */
+  struct aesni_key tweak;
+  /* ESSIV key, valid if have_essiv is set.  */
+  struct aesni_key essiv;
+  int have_essiv;
+};
+
+static int
+have_aesni (void)
+{
+  static int checked, have;
+
+  if (!checked)
+    {
+      grub_uint32_t eax, ebx, ecx, edx;
+
+      grub_cpuid (1, eax, ebx, ecx, edx);
+      have = !!(ecx & CPUID_FEATURE_AES);
+      checked = 1;
+    }
+  return have;
+}
+
+static int
+aesni_usable (grub_crypto_cipher_handle_t cipher, grub_size_t keysize)
+{
+  return (cipher && cipher->cipher->blocksize == 16
+	  && grub_strncmp (cipher->cipher->name, "AES", 3) == 0
+	  && (keysize == 16 || keysize == 24 || keysize == 32));
+}
+
+static grub_uint32_t
+aesni_subword (grub_uint32_t w)
+{
+  grub_uint32_t r;
+
+  /* aeskeygenassist puts SubWord of the second dword in the first one.  */
+  asm ("movd %1, %%xmm0\n\t"
+       "pshufd $0, %%xmm0, %%xmm0\n\t"
+       "aeskeygenassist $0, %%xmm0, %%xmm0\n\t"
+       "movd %%xmm0, %0"
+       : "=r" (r) : "r" (w) : "cc" AESNI_CLOBBERS);
+  return r;
+}
+
+static void
+aesni_expand_key (struct aesni_key *key, const grub_uint8_t *raw,
+		  grub_size_t keysize)
+{
+  grub_uint32_t w[4 * (AESNI_MAX_ROUNDS + 1)];
+  grub_uint32_t rcon = 1;
+  unsigned nk = keysize / 4, i;
+
+  key->rounds = nk + 6;
+  for (i = 0; i < nk; i++)
+    w[i] = grub_le_to_cpu32 (grub_get_unaligned32 (raw + 4 * i));
+  for (i = nk; i < 4 * (unsigned) (key->rounds + 1); i++)
+    {
+      grub_uint32_t t = w[i - 1];
+
+      if (i % nk == 0)
+	{
+	  t = aesni_subword ((t >> 8) | (t << 24)) ^ rcon;
+	  rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x11b : 0);
+	}
+      else if (nk > 6 && i % nk == 4)
+	t = aesni_subword (t);
+      w[i] = w[i - nk] ^ t;
+    }
+  for (i = 0; i < 4 * (unsigned) (key->rounds + 1); i++)
+    grub_set_unaligned32 (key->rk[i / 4] + 4 * (i % 4),
+			  grub_cpu_to_le32 (w[i]));
+}
+
+/* Round keys for the equivalent inverse cipher used by aesdec.  */
+static void
+aesni_invert_key (struct aesni_key *dec, const struct aesni_key *enc)
+{
+  int i;
+
+  dec->rounds = enc->rounds;
+  grub_memcpy (dec->rk[0], enc->rk[enc->rounds], 16);
+  for (i = 1; i < enc->rounds; i++)
+    asm volatile ("movdqu (%1), %%xmm0\n\t"
+		  "aesimc %%xmm0, %%xmm0\n\t"
+		  "movdqu %%xmm0, (%0)"
+		  : : "r" (dec->rk[i]), "r" (enc->rk[enc->rounds - i])
+		  : "memory" AESNI_CLOBBERS);
+  grub_memcpy (dec->rk[enc->rounds], enc->rk[0], 16);
+}
+
+#define AESNI_CRYPT1(name, round, last)					\
+static void								\
+name (const struct aesni_key *key, grub_uint8_t *buf)			\
+{									\
+  const grub_uint8_t *rk = key->rk[0];					\
+  grub_uint64_t n = key->rounds - 1;					\
+									\
+  asm volatile ("movdqu (%[rk]), %%xmm4\n\t"				\
+		"movdqu (%[buf]), %%xmm0\n\t"				\
+		"pxor %%xmm4, %%xmm0\n"					\
+		"1:\n\t"						\
+		"add $16, %[rk]\n\t"					\
+		"movdqu (%[rk]), %%xmm4\n\t"				\
+		round " %%xmm4, %%xmm0\n\t"				\
+		"dec %[n]\n\t"						\
+		"jnz 1b\n\t"						\
+		"movdqu 16(%[rk]), %%xmm4\n\t"				\
+		last " %%xmm4, %%xmm0\n\t"				\
+		"movdqu %%xmm0, (%[buf])"				\
+		: [rk] "+r" (rk), [n] "+r" (n)				\
+		: [buf] "r" (buf)					\
+		: "memory", "cc" AESNI_CLOBBERS);			\
+}
+
+/* Four independent blocks at once to hide the latency of the rounds.  */
+#define AESNI_CRYPT4(name, round, last)					\
+static void								\
+name (const struct aesni_key *key, grub_uint8_t *buf)			\
+{									\
+  const grub_uint8_t *rk = key->rk[0];					\
+  grub_uint64_t n = key->rounds - 1;					\
+									\
+  asm volatile ("movdqu (%[rk]), %%xmm4\n\t"				\
+		"movdqu (%[buf]), %%xmm0\n\t"				\
+		"movdqu 16(%[buf]), %%xmm1\n\t"				\
+		"movdqu 32(%[buf]), %%xmm2\n\t"				\
+		"movdqu 48(%[buf]), %%xmm3\n\t"				\
+		"pxor %%xmm4, %%xmm0\n\t"				\
+		"pxor %%xmm4, %%xmm1\n\t"				\
+		"pxor %%xmm4, %%xmm2\n\t"				\
+		"pxor %%xmm4, %%xmm3\n"					\
+		"1:\n\t"						\
+		"add $16, %[rk]\n\t"					\
+		"movdqu (%[rk]), %%xmm4\n\t"				\
+		round " %%xmm4, %%xmm0\n\t"				\
+		round " %%xmm4, %%xmm1\n\t"				\
+		round " %%xmm4, %%xmm2\n\t"				\
+		round " %%xmm4, %%xmm3\n\t"				\
+		"dec %[n]\n\t"						\
+		"jnz 1b\n\t"						\
+		"movdqu 16(%[rk]), %%xmm4\n\t"				\
+		last " %%xmm4, %%xmm0\n\t"				\
+		last " %%xmm4, %%xmm1\n\t"				\
+		last " %%xmm4, %%xmm2\n\t"				\
+		last " %%xmm4, %%xmm3\n\t"				\
+		"movdqu %%xmm0, (%[buf])\n\t"				\
+		"movdqu %%xmm1, 16(%[buf])\n\t"				\
+		"movdqu %%xmm2, 32(%[buf])\n\t"				\
+		"movdqu %%xmm3, 48(%[buf])"				\
+		: [rk] "+r" (rk), [n] "+r" (n)				\
+		: [buf] "r" (buf)					\
+		: "memory", "cc" AESNI_CLOBBERS);			\
+}
+
+AESNI_CRYPT1 (aesni_encrypt1, "aesenc", "aesenclast")
+AESNI_CRYPT1 (aesni_decrypt1, "aesdec", "aesdeclast")
+AESNI_CRYPT4 (aesni_encrypt4, "aesenc", "aesenclast")
+AESNI_CRYPT4 (aesni_decrypt4, "aesdec", "aesdeclast")
+
+static void
+aesni_ecb (const struct grub_cryptodisk_aesni *ctx, grub_uint8_t *buf,
+	   grub_size_t nblocks, int do_encrypt)
+{
+  for (; nblocks >= 4; nblocks -= 4, buf += 64)
+    if (do_encrypt)
+      aesni_encrypt4 (&ctx->enc, buf);
+    else
+      aesni_decrypt4 (&ctx->dec, buf);
+  for (; nblocks; nblocks--, buf += 16)
+    if (do_encrypt)
+      aesni_encrypt1 (&ctx->enc, buf);
+    else
+      aesni_decrypt1 (&ctx->dec, buf);
+}
+
+static void
+aesni_xts (const struct grub_cryptodisk_aesni *ctx, grub_uint8_t *data,
+	   grub_size_t size, grub_uint8_t *iv, int do_encrypt)
+{
+  grub_uint64_t tweak[AESNI_BATCH][2];
+  grub_uint64_t lo, hi;
+  grub_size_t off, n, j;
+
+  aesni_encrypt1 (&ctx->tweak, iv);
+  lo = grub_le_to_cpu64 (grub_get_unaligned64 (iv));
+  hi = grub_le_to_cpu64 (grub_get_unaligned64 (iv + 8));
+
+  for (off = 0; off < size; off += n * 16)
+    {
+      n = (size - off) / 16;
+      if (n > AESNI_BATCH)
+	n = AESNI_BATCH;
+      /* Same as gf_mul_x, 64 bits at a time.  */
+      for (j = 0; j < n; j++)
+	{
+	  grub_uint64_t over = hi >> 63;
+
+	  tweak[j][0] = grub_cpu_to_le64 (lo);
+	  tweak[j][1] = grub_cpu_to_le64 (hi);
+	  hi = (hi << 1) | (lo >> 63);
+	  lo = (lo << 1) ^ (over ? GF_POLYNOM : 0);
+	}
+      grub_crypto_xor (data + off, data + off, tweak, n * 16);
+      aesni_ecb (ctx, data + off, n, do_encrypt);
+      grub_crypto_xor (data + off, data + off, tweak, n * 16);
+    }
+}
+
+static void
+aesni_cbc (const struct grub_cryptodisk_aesni *ctx, grub_uint8_t *data,
+	   grub_size_t size, grub_uint8_t *iv, int do_encrypt)
+{
+  grub_uint8_t saved[AESNI_BATCH * 16];
+  grub_size_t off, n;
+
+  if (do_encrypt)
+    {
+      const grub_uint8_t *prev = iv;
+
+      for (off = 0; off < size; off += 16)
+	{
+	  grub_crypto_xor (data + off, data + off, prev, 16);
+	  aesni_encrypt1 (&ctx->enc, data + off);
+	  prev = data + off;
+	}
+      return;
+    }
+
+  /* Decryption has no chaining dependency, so decrypt a batch at once and
+     XOR in the saved ciphertext afterwards.  */
+  for (off = 0; off < size; off += n * 16)
+    {
+      n = (size - off) / 16;
+      if (n > AESNI_BATCH)
+	n = AESNI_BATCH;
+      grub_memcpy (saved, data + off, n * 16);
+      aesni_ecb (ctx, data + off, n, 0);
+      grub_crypto_xor (data + off, data + off, iv, 16);
+      grub_crypto_xor (data + off + 16, data + off + 16, saved, (n - 1) * 16);
+      grub_memcpy (iv, saved + (n - 1) * 16, 16);
+    }
+}
+
+static gcry_err_code_t
+aesni_setkey (grub_cryptodisk_t dev, const grub_uint8_t *key,
+	      grub_size_t real_keysize, const grub_uint8_t *essiv_key)
+{
+  struct grub_cryptodisk_aesni *ctx = dev->aesni;
+
+  if (!have_aesni ()
+      || (dev->mode != GRUB_CRYPTODISK_MODE_XTS
+	  && dev->mode != GRUB_CRYPTODISK_MODE_CBC)
+      || !aesni_usable (dev->cipher, real_keysize)
+      || (dev->mode == GRUB_CRYPTODISK_MODE_XTS
+	  && !aesni_usable (dev->secondary_cipher, real_keysize)))
+    {
+      grub_free (ctx);
+      dev->aesni = NULL;
+      return GPG_ERR_NO_ERROR;
+    }
+
+  if (!ctx)
+    {
+      ctx = grub_malloc (sizeof (*ctx));
+      if (!ctx)
+	return GPG_ERR_OUT_OF_MEMORY;
+      dev->aesni = ctx;
+    }
+
+  aesni_expand_key (&ctx->enc, key, real_keysize);
+  aesni_invert_key (&ctx->dec, &ctx->enc);
+  if (dev->mode == GRUB_CRYPTODISK_MODE_XTS)
+    aesni_expand_key (&ctx->tweak, key + real_keysize, real_keysize);
+  ctx->have_essiv = (essiv_key
+		     && aesni_usable (dev->essiv_cipher,
+				      dev->essiv_hash->mdlen));
+  if (ctx->have_essiv)
+    aesni_expand_key (&ctx->essiv, essiv_key, dev->essiv_hash->mdlen);
+  return GPG_ERR_NO_ERROR;
+}
+#else
+static gcry_err_code_t
+aesni_setkey (grub_cryptodisk_t dev __attribute__ ((unused)),
+	      const grub_uint8_t *key __attribute__ ((unused)),
+	      grub_size_t real_keysize __attribute__ ((unused)),
+	      const grub_uint8_t *essiv_key __attribute__ ((unused)))
+{
+  return GPG_ERR_NO_ERROR;
+}
+#endif
+
 static gcry_err_code_t
 grub_cryptodisk_endecrypt (struct grub_cryptodisk *dev,
 			   grub_uint8_t * data, grub_size_t len,
@@ -300,6 +624,13 @@ grub_cryptodisk_endecrypt (struct grub_cryptodisk *dev,
 	  break;
 	case GRUB_CRYPTODISK_MODE_IV_ESSIV:
 	  iv[0] = grub_cpu_to_le32 (sector & 0xFFFFFFFF);
+#ifdef __x86_64__
+	  if (dev->aesni && dev->aesni->have_essiv)
+	    {
+	      aesni_encrypt1 (&dev->aesni->essiv, (grub_uint8_t *) iv);
+	      break;
+	    }
+#endif
 	  err = grub_crypto_ecb_encrypt (dev->essiv_cipher, iv, iv,
 					 dev->cipher->cipher->blocksize);
 	  if (err)
@@ -309,6 +640,14 @@ grub_cryptodisk_endecrypt (struct grub_cryptodisk *dev,
       switch (dev->mode)
 	{
 	case GRUB_CRYPTODISK_MODE_CBC:
+#ifdef __x86_64__
+	  if (dev->aesni)
+	    {
+	      aesni_cbc (dev->aesni, data + i, (1U << dev->log_sector_size),
+			 (grub_uint8_t *) iv, do_encrypt);
+	      break;
+	    }
+#endif
 	  if (do_encrypt)
 	    err = grub_crypto_cbc_encrypt (dev->cipher, data + i, data + i,
 					   (1U << dev->log_sector_size), iv);
@@ -332,6 +671,15 @@ grub_cryptodisk_endecrypt (struct grub_cryptodisk *dev,
 	case GRUB_CRYPTODISK_MODE_XTS:
 	  {
 	    unsigned j;
+
+#ifdef __x86_64__
+	    if (dev->aesni)
+	      {
+		aesni_xts (dev->aesni, data + i, (1U << dev->log_sector_size),
+			   (grub_uint8_t *) iv, do_encrypt);
+		break;
+	      }
+#endif
 	    err = grub_crypto_ecb_encrypt (dev->secondary_cipher, iv, iv,
 					   dev->cipher->cipher->blocksize);
 	    if (err)
@@ -409,6 +757,8 @@ grub_cryptodisk_setkey (grub_cryptodisk_t dev, grub_uint8_t *key, grub_size_t ke
 {
   gcry_err_code_t err;
   int real_keysize;
+  grub_uint8_t hashed_key[GRUB_CRYPTO_MAX_MDLEN];
+  const grub_uint8_t *essiv_key = NULL;
 
   real_keysize = keysize;
   if (dev->mode == GRUB_CRYPTODISK_MODE_XTS)
@@ -427,7 +777,6 @@ grub_cryptodisk_setkey (grub_cryptodisk_t dev, grub_uint8_t *key, grub_size_t ke
   if (dev->mode_iv == GRUB_CRYPTODISK_MODE_IV_ESSIV)
     {
       grub_size_t essiv_keysize = dev->essiv_hash->mdlen;
-      grub_uint8_t hashed_key[GRUB_CRYPTO_MAX_MDLEN];
       if (essiv_keysize > GRUB_CRYPTO_MAX_MDLEN)
 	return GPG_ERR_INV_ARG;
 
@@ -436,6 +785,7 @@ grub_cryptodisk_setkey (grub_cryptodisk_t dev, grub_uint8_t *key, grub_size_t ke
 					hashed_key, essiv_keysize);
       if (err)
 	return err;
+      essiv_key = hashed_key;
     }
   if (dev->mode == GRUB_CRYPTODISK_MODE_XTS)
     {
@@ -465,7 +815,8 @@ grub_cryptodisk_setkey (grub_cryptodisk_t dev, grub_uint8_t *key, grub_size_t ke
 	  gf_mul_be (dev->lrw_precalc + i, idx, dev->lrw_key);
 	}
     }
-  return GPG_ERR_NO_ERROR;
+
+  return aesni_setkey (dev, key, real_keysize, essiv_key);
 }
 
 static int
@@ -816,6 +1167,7 @@ cryptodisk_close (grub_cryptodisk_t dev)
   grub_crypto_cipher_close (dev->cipher);
   grub_crypto_cipher_close (dev->secondary_cipher);
   grub_crypto_cipher_close (dev->essiv_cipher);
+  grub_free (dev->aesni);
   grub_free (dev);
 }
 
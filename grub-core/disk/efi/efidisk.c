@@ -23,6 +23,7 @@
 #include <grub/misc.h>
 #include <grub/err.h>
 #include <grub/term.h>
+#include <grub/time.h>
 #include <grub/efi/api.h>
 #include <grub/efi/efi.h>
 #include <grub/efi/disk.h>
@@ -33,11 +34,30 @@ struct grub_efidisk_data
   grub_efi_device_path_t *device_path;
   grub_efi_device_path_t *last_device_path;
   grub_efi_block_io_t *block_io;
+  /* Only used for reads, and only if the firmware provides it.  */
+  grub_efi_block_io2_t *block_io2;
   struct grub_efidisk_data *next;
 };
 
+/* Largest single transfer.  Some firmware fails bigger ones.  */
+#define EFIDISK_MAX_TRANSFER	0xa0000
+
+/* Number of Block I/O 2 transfers kept in flight at once.  */
+#define EFIDISK_QUEUE_DEPTH	8
+
+/* How long to wait for a batch of Block I/O 2 transfers, in ms, before
+   giving up on it and reading through Block I/O.  */
+#define EFIDISK_ASYNC_TIMEOUT	10000
+
 /* GUID.  */
 static grub_efi_guid_t block_io_guid = GRUB_EFI_BLOCK_IO_GUID;
+static grub_efi_guid_t block_io2_guid = GRUB_EFI_BLOCK_IO2_GUID;
+
+/* Aligned buffer for callers' buffers the device cannot transfer into,
+   kept from one request to the next until the disk cache is flushed.  */
+static char *bounce_buf;
+static grub_size_t bounce_size;
+static grub_size_t bounce_align;
 
 static struct grub_efidisk_data *fd_devices;
 static struct grub_efidisk_data *hd_devices;
@@ -107,6 +127,8 @@ make_devices (void)
       d->device_path = dp;
       d->last_device_path = ldp;
       d->block_io = bio;
+      d->block_io2 = grub_efi_open_protocol (*handle, &block_io2_guid,
+					     GRUB_EFI_OPEN_PROTOCOL_GET_PROTOCOL);
       d->next = devices;
       devices = d;
     }
@@ -503,9 +525,9 @@ grub_efidisk_open (const char *name, struct grub_disk *disk)
   /* FIXME: Probably it is better to store the block size in the disk,
      and total sectors should be replaced with total blocks.  */
   grub_dprintf ("efidisk",
-		"m = %p, last block = %llx, block size = %x, io align = %x\n",
+		"m = %p, last block = %llx, block size = %x, io align = %x%s\n",
 		m, (unsigned long long) m->last_block, m->block_size,
-		m->io_align);
+		m->io_align, d->block_io2 ? ", block io 2" : "");
 
   /* Ensure required buffer alignment is a power of two (or is zero). */
   if (m->io_align & (m->io_align - 1))
@@ -513,7 +535,12 @@ grub_efidisk_open (const char *name, struct grub_disk *disk)
 
   disk->total_sectors = m->last_block + 1;
   /* Don't increase this value due to bug in some EFI.  */
-  disk->max_agglomerate = 0xa0000 >> (GRUB_DISK_CACHE_BITS + GRUB_DISK_SECTOR_BITS);
+  disk->max_agglomerate = EFIDISK_MAX_TRANSFER >> (GRUB_DISK_CACHE_BITS
+						   + GRUB_DISK_SECTOR_BITS);
+  /* Larger reads are still split into transfers of that size, but they are
+     queued together.  */
+  if (d->block_io2)
+    disk->max_agglomerate *= EFIDISK_QUEUE_DEPTH;
   if (m->block_size & (m->block_size - 1) || !m->block_size)
     return grub_error (GRUB_ERR_IO, "invalid sector size %d",
 		       m->block_size);
@@ -534,14 +561,116 @@ grub_efidisk_close (struct grub_disk *disk __attribute__ ((unused)))
   grub_dprintf ("efidisk", "closing %s\n", disk->name);
 }
 
+static void
+free_bounce_buffer (void)
+{
+  grub_free (bounce_buf);
+  bounce_buf = 0;
+  bounce_size = 0;
+}
+
+static struct grub_disk_cache_hook bounce_cache_hook =
+  {
+    .flush = free_bounce_buffer
+  };
+
+static char *
+get_bounce_buffer (grub_size_t align, grub_size_t size)
+{
+  if (bounce_buf && bounce_size >= size && bounce_align >= align)
+    return bounce_buf;
+
+  /* Drop the old buffer first: running out of memory flushes the disk
+     cache, and with it the buffer.  */
+  free_bounce_buffer ();
+  bounce_buf = grub_memalign (align, size);
+  if (! bounce_buf)
+    return 0;
+  bounce_size = size;
+  bounce_align = align;
+  return bounce_buf;
+}
+
+/* Read NUM_BYTES at SECTOR into BUF through Block I/O 2, in transfers of
+   at most CHUNK bytes of which up to EFIDISK_QUEUE_DEPTH are in flight.
+   A batch that does not complete within EFIDISK_ASYNC_TIMEOUT is aborted
+   with a reset of the device and GRUB_EFI_TIMEOUT returned.  */
+static grub_efi_status_t
+grub_efidisk_read_async (struct grub_disk *disk, grub_efi_block_io2_t *bio2,
+			 grub_disk_addr_t sector, grub_size_t num_bytes,
+			 grub_size_t chunk, char *buf)
+{
+  grub_efi_boot_services_t *b = grub_efi_system_table->boot_services;
+  grub_efi_block_io2_token_t tokens[EFIDISK_QUEUE_DEPTH];
+  grub_efi_status_t status = GRUB_EFI_SUCCESS;
+  grub_size_t off = 0;
+
+  while (off < num_bytes && status == GRUB_EFI_SUCCESS)
+    {
+      grub_uint64_t start;
+      unsigned n, i;
+
+      for (n = 0; n < EFIDISK_QUEUE_DEPTH && off < num_bytes; n++)
+	{
+	  grub_size_t len = num_bytes - off;
+
+	  if (len > chunk)
+	    len = chunk;
+
+	  status = efi_call_5 (b->create_event, 0, 0, 0, 0, &tokens[n].event);
+	  if (status != GRUB_EFI_SUCCESS)
+	    break;
+	  tokens[n].transaction_status = GRUB_EFI_SUCCESS;
+
+	  status = efi_call_6 (bio2->read_blocks_ex, bio2,
+			       bio2->media->media_id,
+			       (grub_efi_uint64_t) sector
+			       + (off >> disk->log_sector_size),
+			       &tokens[n], (grub_efi_uintn_t) len, buf + off);
+	  if (status != GRUB_EFI_SUCCESS)
+	    {
+	      efi_call_1 (b->close_event, tokens[n].event);
+	      break;
+	    }
+	  off += len;
+	}
+
+      /* Even after a failed submission the ones before it belong to the
+	 firmware until they complete or the device is reset.  */
+      start = grub_get_time_ms ();
+      for (i = 0; i < n; i++)
+	{
+	  while (status != GRUB_EFI_TIMEOUT)
+	    {
+	      grub_efi_status_t done;
+
+	      done = efi_call_1 (b->check_event, tokens[i].event);
+	      if (done != GRUB_EFI_NOT_READY)
+		break;
+	      if (grub_get_time_ms () - start > EFIDISK_ASYNC_TIMEOUT)
+		{
+		  /* This aborts whatever is still queued.  */
+		  efi_call_2 (bio2->reset, bio2, 0);
+		  status = GRUB_EFI_TIMEOUT;
+		}
+	    }
+	  if (status == GRUB_EFI_SUCCESS)
+	    status = tokens[i].transaction_status;
+	  efi_call_1 (b->close_event, tokens[i].event);
+	}
+    }
+
+  return status;
+}
+
 static grub_efi_status_t
 grub_efidisk_readwrite (struct grub_disk *disk, grub_disk_addr_t sector,
 			grub_size_t size, char *buf, int wr)
 {
   struct grub_efidisk_data *d;
   grub_efi_block_io_t *bio;
-  grub_efi_status_t status;
-  grub_size_t io_align, num_bytes;
+  grub_efi_status_t status = GRUB_EFI_UNSUPPORTED;
+  grub_size_t io_align, num_bytes, chunk, off;
   char *aligned_buf;
 
   d = disk->data;
@@ -551,9 +680,16 @@ grub_efidisk_readwrite (struct grub_disk *disk, grub_disk_addr_t sector,
   io_align = bio->media->io_align ? bio->media->io_align : 1;
   num_bytes = size << disk->log_sector_size;
 
+  /* Every transfer must start on a block and on an aligned address.  */
+  chunk = (grub_size_t) 1 << disk->log_sector_size;
+  if (chunk < io_align)
+    chunk = io_align;
+  if (chunk < EFIDISK_MAX_TRANSFER)
+    chunk = EFIDISK_MAX_TRANSFER & ~(chunk - 1);
+
   if ((grub_addr_t) buf & (io_align - 1))
     {
-      aligned_buf = grub_memalign (io_align, num_bytes);
+      aligned_buf = get_bounce_buffer (io_align, num_bytes);
       if (! aligned_buf)
 	return GRUB_EFI_OUT_OF_RESOURCES;
       if (wr)
@@ -564,17 +700,37 @@ grub_efidisk_readwrite (struct grub_disk *disk, grub_disk_addr_t sector,
       aligned_buf = buf;
     }
 
-  status =  efi_call_5 ((wr ? bio->write_blocks : bio->read_blocks), bio,
-			bio->media->media_id, (grub_efi_uint64_t) sector,
-			(grub_efi_uintn_t) num_bytes, aligned_buf);
-
-  if ((grub_addr_t) buf & (io_align - 1))
+  if (!wr && d->block_io2)
     {
-      if (!wr)
-	grub_memcpy (buf, aligned_buf, num_bytes);
-      grub_free (aligned_buf);
+      status = grub_efidisk_read_async (disk, d->block_io2, sector,
+					num_bytes, chunk, aligned_buf);
+      if (status != GRUB_EFI_SUCCESS)
+	{
+	  /* Retry with Block I/O, and keep using it.  */
+	  grub_dprintf ("efidisk", "block io 2 read from %s failed: %ld\n",
+			disk->name, (long) status);
+	  d->block_io2 = 0;
+	}
     }
 
+  if (status != GRUB_EFI_SUCCESS)
+    for (off = 0, status = GRUB_EFI_SUCCESS;
+	 off < num_bytes && status == GRUB_EFI_SUCCESS; off += chunk)
+      {
+	grub_size_t len = num_bytes - off;
+
+	if (len > chunk)
+	  len = chunk;
+	status = efi_call_5 ((wr ? bio->write_blocks : bio->read_blocks), bio,
+			     bio->media->media_id,
+			     (grub_efi_uint64_t) sector
+			     + (off >> disk->log_sector_size),
+			     (grub_efi_uintn_t) len, aligned_buf + off);
+      }
+
+  if (aligned_buf != buf && !wr)
+    grub_memcpy (buf, aligned_buf, num_bytes);
+
   return status;
 }
 
@@ -644,6 +800,8 @@ grub_efidisk_fini (void)
   fd_devices = 0;
   hd_devices = 0;
   cd_devices = 0;
+  grub_disk_cache_unregister_hook (&bounce_cache_hook);
+  free_bounce_buffer ();
   grub_disk_dev_unregister (&grub_efidisk_dev);
 }
 
@@ -654,6 +812,7 @@ grub_efidisk_init (void)
 
   enumerate_disks ();
   grub_disk_dev_register (&grub_efidisk_dev);
+  grub_disk_cache_register_hook (&bounce_cache_hook);
 }
 
 /* Some utility functions to map GRUB devices with EFI devices.  */
@@ -27,6 +27,11 @@
 #include <grub/partition.h>
 #include <grub/i18n.h>
 
+#if defined (GRUB_UTIL) && defined (HAVE_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 GRUB_MOD_LICENSE ("GPLv3+");
 
 #define MAX_PASSPHRASE 256
@@ -307,6 +312,341 @@ configure_ciphers (grub_disk_t disk, const char *check_uuid,
   return newdev;
 }
 
+/* Derive the candidate master key from key slot SLOT, whose encrypted key
+   material has already been read into SPLIT_KEY, and check it against the
+   digest in the header.  Clobbers DEV's key and SPLIT_KEY.  Nothing here
+   touches the disk or global state, so distinct DEVs can be run in
+   parallel.  */
+static gcry_err_code_t
+luks_try_slot (grub_cryptodisk_t dev, const struct grub_luks_phdr *header,
+	       unsigned slot, const char *passphrase, grub_size_t keysize,
+	       grub_uint8_t *split_key, grub_uint8_t *candidate_key,
+	       int *match, const volatile int *cancel)
+{
+  grub_uint8_t digest[GRUB_CRYPTODISK_MAX_KEYLEN];
+  grub_uint8_t candidate_digest[sizeof (header->mkDigest)];
+  grub_size_t stripes = grub_be_to_cpu32 (header->keyblock[slot].stripes);
+  gcry_err_code_t gcry_err;
+
+  *match = 0;
+
+  /* Calculate the PBKDF2 of the user supplied passphrase.  */
+  gcry_err = grub_crypto_pbkdf2_cancel (dev->hash,
+					(const grub_uint8_t *) passphrase,
+					grub_strlen (passphrase),
+					header->keyblock[slot].passwordSalt,
+					sizeof (header->keyblock[slot].passwordSalt),
+					grub_be_to_cpu32 (header->keyblock[slot].
+							  passwordIterations),
+					digest, keysize, cancel);
+  if (gcry_err)
+    return gcry_err;
+
+  gcry_err = grub_cryptodisk_setkey (dev, digest, keysize);
+  if (gcry_err)
+    return gcry_err;
+
+  /* Decrypt the key material.  */
+  gcry_err = grub_cryptodisk_decrypt (dev, split_key, keysize * stripes, 0);
+  if (gcry_err)
+    return gcry_err;
+
+  /* Merge the decrypted key material to get the candidate master key.  */
+  gcry_err = AF_merge (dev->hash, split_key, candidate_key, keysize, stripes);
+  if (gcry_err)
+    return gcry_err;
+
+  /* Calculate the PBKDF2 of the candidate master key.  */
+  gcry_err = grub_crypto_pbkdf2_cancel (dev->hash, candidate_key,
+					grub_be_to_cpu32 (header->keyBytes),
+					header->mkDigestSalt,
+					sizeof (header->mkDigestSalt),
+					grub_be_to_cpu32 (header->mkDigestIterations),
+					candidate_digest, sizeof (candidate_digest),
+					cancel);
+  if (gcry_err)
+    return gcry_err;
+
+  /* Compare the calculated PBKDF2 to the digest stored
+     in the header to see if it's correct.  */
+  *match = (grub_memcmp (candidate_digest, header->mkDigest,
+			 sizeof (header->mkDigest)) == 0);
+  return GPG_ERR_NO_ERROR;
+}
+
+#if defined (GRUB_UTIL) && defined (HAVE_PTHREAD)
+/* The utilities try the key slots on host threads, one slot per thread
+   at a time.  Each thread works on its own copy of the device so the
+   cipher contexts are not shared.  */
+
+struct luks_slot_job
+{
+  struct grub_luks_phdr header;
+  char passphrase[MAX_PASSPHRASE];
+  grub_size_t keysize;
+  struct grub_cryptodisk tmpl;
+  const gcry_cipher_spec_t *cipher, *secondary_cipher, *essiv_cipher;
+  grub_uint8_t *split_key[ARRAY_SIZE (((struct grub_luks_phdr *) 0)->keyblock)];
+  /* Set under LOCK once a slot opened or failed.  Polled without it by
+     the PBKDF2 loops in flight so they stop right away.  */
+  volatile int cancel;
+
+  /* Everything below is protected by LOCK.  */
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  unsigned next;
+  int found;
+  gcry_err_code_t err;
+  int running;
+  /* The last thread out frees the job, so that the caller can return as
+     soon as a slot opens without waiting for a PBKDF2 in flight.  */
+  int refs;
+  grub_uint8_t key[GRUB_CRYPTODISK_MAX_KEYLEN];
+};
+
+static void
+luks_job_free (struct luks_slot_job *job)
+{
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (job->split_key); i++)
+    grub_free (job->split_key[i]);
+  pthread_mutex_destroy (&job->lock);
+  pthread_cond_destroy (&job->done);
+  grub_memset (job, 0, sizeof (*job));
+  grub_free (job);
+}
+
+static void
+luks_job_unref (struct luks_slot_job *job)
+{
+  int last;
+
+  pthread_mutex_lock (&job->lock);
+  last = (--job->refs == 0);
+  pthread_mutex_unlock (&job->lock);
+  if (last)
+    luks_job_free (job);
+}
+
+static void
+luks_clone_free (grub_cryptodisk_t dev)
+{
+  if (!dev)
+    return;
+  grub_crypto_cipher_close (dev->cipher);
+  grub_crypto_cipher_close (dev->secondary_cipher);
+  grub_crypto_cipher_close (dev->essiv_cipher);
+  grub_free (dev->lrw_precalc);
+  grub_free (dev->aesni);
+  grub_memset (dev, 0, sizeof (*dev));
+  grub_free (dev);
+}
+
+static grub_cryptodisk_t
+luks_clone (const struct luks_slot_job *job)
+{
+  grub_cryptodisk_t dev;
+
+  dev = grub_malloc (sizeof (*dev));
+  if (!dev)
+    return NULL;
+  *dev = job->tmpl;
+  dev->cipher = grub_crypto_cipher_open (job->cipher);
+  if (job->secondary_cipher)
+    dev->secondary_cipher = grub_crypto_cipher_open (job->secondary_cipher);
+  if (job->essiv_cipher)
+    dev->essiv_cipher = grub_crypto_cipher_open (job->essiv_cipher);
+  if (!dev->cipher || (job->secondary_cipher && !dev->secondary_cipher)
+      || (job->essiv_cipher && !dev->essiv_cipher))
+    {
+      luks_clone_free (dev);
+      return NULL;
+    }
+  return dev;
+}
+
+static void *
+luks_slot_worker (void *arg)
+{
+  struct luks_slot_job *job = arg;
+  grub_cryptodisk_t dev;
+  grub_uint8_t candidate_key[GRUB_CRYPTODISK_MAX_KEYLEN];
+
+  dev = luks_clone (job);
+
+  pthread_mutex_lock (&job->lock);
+  if (!dev && !job->err)
+    job->err = GPG_ERR_OUT_OF_MEMORY;
+  while (job->found < 0 && !job->err)
+    {
+      gcry_err_code_t gcry_err;
+      unsigned slot;
+      int match;
+
+      while (job->next < ARRAY_SIZE (job->split_key)
+	     && !job->split_key[job->next])
+	job->next++;
+      if (job->next >= ARRAY_SIZE (job->split_key))
+	break;
+      slot = job->next++;
+      pthread_mutex_unlock (&job->lock);
+
+      gcry_err = luks_try_slot (dev, &job->header, slot, job->passphrase,
+				job->keysize, job->split_key[slot],
+				candidate_key, &match, &job->cancel);
+
+      pthread_mutex_lock (&job->lock);
+      if (gcry_err == GPG_ERR_CANCELED)
+	break;
+      if (gcry_err && !job->err)
+	{
+	  job->err = gcry_err;
+	  job->cancel = 1;
+	}
+      else if (!gcry_err && match && job->found < 0)
+	{
+	  job->found = slot;
+	  grub_memcpy (job->key, candidate_key, job->keysize);
+	  job->cancel = 1;
+	}
+    }
+  job->running--;
+  pthread_cond_signal (&job->done);
+  pthread_mutex_unlock (&job->lock);
+
+  grub_memset (candidate_key, 0, sizeof (candidate_key));
+  luks_clone_free (dev);
+  luks_job_unref (job);
+  return NULL;
+}
+
+/* Returns 0 if the slots should be tried sequentially instead, otherwise
+   stores the outcome in *ERR.  */
+static int
+luks_recover_key_parallel (grub_disk_t source, grub_cryptodisk_t dev,
+			   const struct grub_luks_phdr *header,
+			   grub_size_t keysize, const char *passphrase,
+			   grub_err_t *err)
+{
+  struct luks_slot_job *job;
+  grub_uint8_t key[GRUB_CRYPTODISK_MAX_KEYLEN];
+  long ncpus;
+  unsigned i, nslots = 0, nthreads;
+  int found;
+  gcry_err_code_t gcry_err;
+
+  for (i = 0; i < ARRAY_SIZE (header->keyblock); i++)
+    if (grub_be_to_cpu32 (header->keyblock[i].active) == LUKS_KEY_ENABLED)
+      nslots++;
+  ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (nslots < 2 || ncpus < 2)
+    return 0;
+  nthreads = ncpus < nslots ? ncpus : nslots;
+
+  job = grub_zalloc (sizeof (*job));
+  if (!job)
+    return 0;
+  grub_memcpy (&job->header, header, sizeof (job->header));
+  grub_strncpy (job->passphrase, passphrase, sizeof (job->passphrase) - 1);
+  job->keysize = keysize;
+  job->tmpl = *dev;
+  job->tmpl.cipher = job->tmpl.secondary_cipher = job->tmpl.essiv_cipher = NULL;
+  job->tmpl.lrw_precalc = NULL;
+  job->tmpl.aesni = NULL;
+  job->cipher = dev->cipher->cipher;
+  job->secondary_cipher = dev->secondary_cipher ? dev->secondary_cipher->cipher : NULL;
+  job->essiv_cipher = dev->essiv_cipher ? dev->essiv_cipher->cipher : NULL;
+  job->found = -1;
+  pthread_mutex_init (&job->lock, NULL);
+  pthread_cond_init (&job->done, NULL);
+
+  /* Reading stays on this thread.  */
+  for (i = 0; i < ARRAY_SIZE (header->keyblock); i++)
+    {
+      grub_size_t length;
+
+      if (grub_be_to_cpu32 (header->keyblock[i].active) != LUKS_KEY_ENABLED)
+	continue;
+      length = keysize * grub_be_to_cpu32 (header->keyblock[i].stripes);
+      job->split_key[i] = grub_malloc (length);
+      if (!job->split_key[i])
+	{
+	  luks_job_free (job);
+	  *err = grub_errno;
+	  return 1;
+	}
+      *err = grub_disk_read (source,
+			     grub_be_to_cpu32 (header->keyblock[i].
+					       keyMaterialOffset), 0,
+			     length, job->split_key[i]);
+      if (*err)
+	{
+	  luks_job_free (job);
+	  return 1;
+	}
+    }
+
+  job->refs = 1;
+  for (i = 0; i < nthreads; i++)
+    {
+      pthread_t thread;
+
+      pthread_mutex_lock (&job->lock);
+      job->refs++;
+      job->running++;
+      pthread_mutex_unlock (&job->lock);
+      if (pthread_create (&thread, NULL, luks_slot_worker, job) != 0)
+	{
+	  pthread_mutex_lock (&job->lock);
+	  job->refs--;
+	  job->running--;
+	  pthread_mutex_unlock (&job->lock);
+	  break;
+	}
+      pthread_detach (thread);
+    }
+  grub_dprintf ("luks", "trying %u keyslots on %u threads\n", nslots, i);
+
+  pthread_mutex_lock (&job->lock);
+  if (i == 0)
+    {
+      pthread_mutex_unlock (&job->lock);
+      luks_job_unref (job);
+      return 0;
+    }
+  while (job->found < 0 && !job->err && job->running)
+    pthread_cond_wait (&job->done, &job->lock);
+  found = job->found;
+  gcry_err = job->err;
+  if (found >= 0)
+    grub_memcpy (key, job->key, keysize);
+  pthread_mutex_unlock (&job->lock);
+  luks_job_unref (job);
+
+  if (found >= 0)
+    {
+      gcry_err = grub_cryptodisk_setkey (dev, key, keysize);
+      grub_memset (key, 0, sizeof (key));
+    }
+
+  if (gcry_err)
+    {
+      *err = grub_crypto_gcry_error (gcry_err);
+      return 1;
+    }
+  if (found < 0)
+    {
+      *err = GRUB_ACCESS_DENIED;
+      return 1;
+    }
+
+  grub_printf_ (N_("Slot %d opened\n"), found);
+  *err = GRUB_ERR_NONE;
+  return 1;
+}
+#endif
+
 static grub_err_t
 luks_recover_key (grub_disk_t source,
 		  grub_cryptodisk_t dev)
@@ -315,7 +655,6 @@ luks_recover_key (grub_disk_t source,
   grub_size_t keysize;
   grub_uint8_t *split_key = NULL;
   char passphrase[MAX_PASSPHRASE] = "";
-  grub_uint8_t candidate_digest[sizeof (header.mkDigest)];
   unsigned i;
   grub_size_t length;
   grub_err_t err;
@@ -336,10 +675,6 @@ luks_recover_key (grub_disk_t source,
 	&& grub_be_to_cpu32 (header.keyblock[i].stripes) > max_stripes)
       max_stripes = grub_be_to_cpu32 (header.keyblock[i].stripes);
 
-  split_key = grub_malloc (keysize * max_stripes);
-  if (!split_key)
-    return grub_errno;
-
   /* Get the passphrase from the user.  */
   tmp = NULL;
   if (source->partition)
@@ -349,17 +684,24 @@ luks_recover_key (grub_disk_t source,
 	       dev->uuid);
   grub_free (tmp);
   if (!grub_password_get (passphrase, MAX_PASSPHRASE))
-    {
-      grub_free (split_key);
-      return grub_error (GRUB_ERR_BAD_ARGUMENT, "Passphrase not supplied");
-    }
+    return grub_error (GRUB_ERR_BAD_ARGUMENT, "Passphrase not supplied");
+
+#if defined (GRUB_UTIL) && defined (HAVE_PTHREAD)
+  if (luks_recover_key_parallel (source, dev, &header, keysize, passphrase,
+				 &err))
+    return err;
+#endif
+
+  split_key = grub_malloc (keysize * max_stripes);
+  if (!split_key)
+    return grub_errno;
 
   /* Try to recover master key from each active keyslot.  */
   for (i = 0; i < ARRAY_SIZE (header.keyblock); i++)
     {
       gcry_err_code_t gcry_err;
       grub_uint8_t candidate_key[GRUB_CRYPTODISK_MAX_KEYLEN];
-      grub_uint8_t digest[GRUB_CRYPTODISK_MAX_KEYLEN];
+      int match;
 
       /* Check if keyslot is enabled.  */
       if (grub_be_to_cpu32 (header.keyblock[i].active) != LUKS_KEY_ENABLED)
@@ -367,33 +709,9 @@ luks_recover_key (grub_disk_t source,
 
       grub_dprintf ("luks", "Trying keyslot %d\n", i);
 
-      /* Calculate the PBKDF2 of the user supplied passphrase.  */
-      gcry_err = grub_crypto_pbkdf2 (dev->hash, (grub_uint8_t *) passphrase,
-				     grub_strlen (passphrase),
-				     header.keyblock[i].passwordSalt,
-				     sizeof (header.keyblock[i].passwordSalt),
-				     grub_be_to_cpu32 (header.keyblock[i].
-						       passwordIterations),
-				     digest, keysize);
-
-      if (gcry_err)
-	{
-	  grub_free (split_key);
-	  return grub_crypto_gcry_error (gcry_err);
-	}
-
-      grub_dprintf ("luks", "PBKDF2 done\n");
-
-      gcry_err = grub_cryptodisk_setkey (dev, digest, keysize); 
-      if (gcry_err)
-	{
-	  grub_free (split_key);
-	  return grub_crypto_gcry_error (gcry_err);
-	}
-
       length = (keysize * grub_be_to_cpu32 (header.keyblock[i].stripes));
 
-      /* Read and decrypt the key material from the disk.  */
+      /* Read the key material from the disk.  */
       err = grub_disk_read (source,
 			    grub_be_to_cpu32 (header.keyblock
 					      [i].keyMaterialOffset), 0,
@@ -404,43 +722,15 @@ luks_recover_key (grub_disk_t source,
 	  return err;
 	}
 
-      gcry_err = grub_cryptodisk_decrypt (dev, split_key, length, 0);
-      if (gcry_err)
-	{
-	  grub_free (split_key);
-	  return grub_crypto_gcry_error (gcry_err);
-	}
-
-      /* Merge the decrypted key material to get the candidate master key.  */
-      gcry_err = AF_merge (dev->hash, split_key, candidate_key, keysize,
-			   grub_be_to_cpu32 (header.keyblock[i].stripes));
-      if (gcry_err)
-	{
-	  grub_free (split_key);
-	  return grub_crypto_gcry_error (gcry_err);
-	}
-
-      grub_dprintf ("luks", "candidate key recovered\n");
-
-      /* Calculate the PBKDF2 of the candidate master key.  */
-      gcry_err = grub_crypto_pbkdf2 (dev->hash, candidate_key,
-				     grub_be_to_cpu32 (header.keyBytes),
-				     header.mkDigestSalt,
-				     sizeof (header.mkDigestSalt),
-				     grub_be_to_cpu32
-				     (header.mkDigestIterations),
-				     candidate_digest,
-				     sizeof (candidate_digest));
+      gcry_err = luks_try_slot (dev, &header, i, passphrase, keysize,
+				split_key, candidate_key, &match, NULL);
       if (gcry_err)
 	{
 	  grub_free (split_key);
 	  return grub_crypto_gcry_error (gcry_err);
 	}
 
-      /* Compare the calculated PBKDF2 to the digest stored
-         in the header to see if it's correct.  */
-      if (grub_memcmp (candidate_digest, header.mkDigest,
-		       sizeof (header.mkDigest)) != 0)
+      if (!match)
 	{
 	  grub_dprintf ("luks", "bad digest\n");
 	  continue;
@@ -27,29 +27,28 @@
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
-static grub_err_t
-grub_raid5_recover (struct grub_diskfilter_segment *array, int disknr,
-                    char *buf, grub_disk_addr_t sector, grub_size_t size)
+grub_err_t
+grub_raid5_recover_gen (void *data, grub_uint64_t nstripes, int disknr,
+			char *buf, grub_uint64_t addr, grub_size_t size,
+			grub_raid_recover_read_t read_func)
 {
   char *buf2;
   int i;
 
-  size <<= GRUB_DISK_SECTOR_BITS;
   buf2 = grub_malloc (size);
   if (!buf2)
     return grub_errno;
 
   grub_memset (buf, 0, size);
 
-  for (i = 0; i < (int) array->node_count; i++)
+  for (i = 0; i < (int) nstripes; i++)
     {
       grub_err_t err;
 
       if (i == disknr)
         continue;
 
-      err = grub_diskfilter_read_node (&array->nodes[i], sector,
-				       size >> GRUB_DISK_SECTOR_BITS, buf2);
+      err = read_func (data, i, addr, buf2, size);
 
       if (err)
         {
@@ -65,12 +64,34 @@ grub_raid5_recover (struct grub_diskfilter_segment *array, int disknr,
   return GRUB_ERR_NONE;
 }
 
+static grub_err_t
+grub_raid5_read_node (void *data, int disknr, grub_uint64_t sector,
+		      void *buf, grub_size_t size)
+{
+  struct grub_diskfilter_segment *array = data;
+
+  return grub_diskfilter_read_node (&array->nodes[disknr],
+				    (grub_disk_addr_t) sector,
+				    size >> GRUB_DISK_SECTOR_BITS, buf);
+}
+
+static grub_err_t
+grub_raid5_recover (struct grub_diskfilter_segment *array, int disknr,
+                    char *buf, grub_disk_addr_t sector, grub_size_t size)
+{
+  return grub_raid5_recover_gen (array, array->node_count, disknr, buf,
+				 sector, size << GRUB_DISK_SECTOR_BITS,
+				 grub_raid5_read_node);
+}
+
 GRUB_MOD_INIT(raid5rec)
 {
   grub_raid5_recover_func = grub_raid5_recover;
+  grub_raid5_recover_gen_func = grub_raid5_recover_gen;
 }
 
 GRUB_MOD_FINI(raid5rec)
 {
   grub_raid5_recover_func = 0;
+  grub_raid5_recover_gen_func = 0;
 }
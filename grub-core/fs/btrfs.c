@@ -26,9 +26,11 @@
 #include <grub/types.h>
 #include <grub/lib/crc.h>
 #include <grub/deflate.h>
+#include <grub/zstd.h>
 #include <minilzo.h>
 #include <grub/i18n.h>
 #include <grub/btrfs.h>
+#include <grub/diskfilter.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -88,6 +90,44 @@ struct grub_btrfs_device_desc
   grub_uint64_t id;
 };
 
+#define GRUB_BTRFS_EXTENT_CACHE_SIZE 8
+/* Compressed extents are at most 128K when written by Linux; anything
+   bigger is decompressed on every read instead of being cached.  */
+#define GRUB_BTRFS_EXTENT_CACHE_MAX (1 << 20)
+
+/* A fully decompressed extent, covering [start, start + size) of the
+   file.  */
+struct grub_btrfs_extent_cache
+{
+  grub_uint64_t tree;
+  grub_uint64_t inode;
+  grub_uint64_t start;
+  grub_size_t size;
+  char *buf;
+  grub_uint64_t last_used;
+};
+
+/* A chunk of the logical address space with its stripe geometry.  */
+struct grub_btrfs_chunk_map
+{
+  grub_uint64_t start;
+  grub_uint64_t size;
+  grub_uint64_t profile;
+  grub_uint64_t stripe_length;
+  /* log2 of stripe_length, or -1 if it is not a power of two.  */
+  int stripe_shift;
+  grub_uint16_t nstripes;
+  grub_uint16_t nsubstripes;
+  /* Stripes holding different data, nstripes / nsubstripes for RAID10.  */
+  grub_uint16_t data_stripes;
+  /* Number of copies of each block.  */
+  unsigned redundancy;
+  /* Parity stripes per row for RAID5 and RAID6.  */
+  unsigned nparities;
+  struct grub_btrfs_chunk_item *chunk;
+  struct grub_btrfs_chunk_stripe *stripes;
+};
+
 struct grub_btrfs_data
 {
   struct grub_btrfs_superblock sblock;
@@ -105,6 +145,15 @@ struct grub_btrfs_data
   grub_uint64_t exttree;
   grub_size_t extsize;
   struct grub_btrfs_extent_data *extent;
+
+  struct grub_btrfs_extent_cache extent_cache[GRUB_BTRFS_EXTENT_CACHE_SIZE];
+  grub_uint64_t extent_cache_clock;
+
+  /* The chunk tree, sorted by start address.  It is read on the first
+     lookup the bootstrap mapping can't answer.  */
+  struct grub_btrfs_chunk_map *chunk_map;
+  unsigned n_chunk_map;
+  int chunk_map_loaded;
 };
 
 struct grub_btrfs_chunk_item
@@ -119,6 +168,8 @@ struct grub_btrfs_chunk_item
 #define GRUB_BTRFS_CHUNK_TYPE_RAID1         0x10
 #define GRUB_BTRFS_CHUNK_TYPE_DUPLICATED    0x20
 #define GRUB_BTRFS_CHUNK_TYPE_RAID10        0x40
+#define GRUB_BTRFS_CHUNK_TYPE_RAID5         0x80
+#define GRUB_BTRFS_CHUNK_TYPE_RAID6         0x100
   grub_uint8_t dummy2[0xc];
   grub_uint16_t nstripes;
   grub_uint16_t nsubstripes;
@@ -212,6 +263,7 @@ struct grub_btrfs_extent_data
 #define GRUB_BTRFS_COMPRESSION_NONE 0
 #define GRUB_BTRFS_COMPRESSION_ZLIB 1
 #define GRUB_BTRFS_COMPRESSION_LZO  2
+#define GRUB_BTRFS_COMPRESSION_ZSTD 3
 
 #define GRUB_BTRFS_OBJECT_ID_CHUNK 0x100
 
@@ -606,6 +658,258 @@ find_device (struct grub_btrfs_data *data, grub_uint64_t id, int do_rescan)
   return ctx.dev_found;
 }
 
+static void
+grub_btrfs_chunk_map_init (struct grub_btrfs_chunk_map *map,
+			   grub_uint64_t start,
+			   struct grub_btrfs_chunk_item *chunk)
+{
+  map->start = start;
+  map->size = grub_le_to_cpu64 (chunk->size);
+  map->profile = grub_le_to_cpu64 (chunk->type)
+    & ~GRUB_BTRFS_CHUNK_TYPE_BITS_DONTCARE;
+  map->nstripes = grub_le_to_cpu16 (chunk->nstripes) ? : 1;
+  map->nsubstripes = grub_le_to_cpu16 (chunk->nsubstripes) ? : 1;
+  map->stripe_length = grub_le_to_cpu64 (chunk->stripe_length) ? : 512;
+  map->data_stripes = map->nstripes;
+  map->nparities = 0;
+  map->redundancy = 1;
+  map->chunk = chunk;
+  map->stripes = (struct grub_btrfs_chunk_stripe *) (chunk + 1);
+
+  switch (map->profile)
+    {
+    case GRUB_BTRFS_CHUNK_TYPE_SINGLE:
+      /* Consecutive stripes rather than interleaved ones.  */
+      map->stripe_length = grub_divmod64 (map->size, map->nstripes, NULL);
+      if (map->stripe_length == 0)
+	map->stripe_length = 512;
+      break;
+    case GRUB_BTRFS_CHUNK_TYPE_DUPLICATED:
+    case GRUB_BTRFS_CHUNK_TYPE_RAID1:
+      map->redundancy = 2;
+      break;
+    case GRUB_BTRFS_CHUNK_TYPE_RAID10:
+      map->data_stripes = map->nstripes / map->nsubstripes ? : 1;
+      map->redundancy = map->nsubstripes;
+      break;
+    case GRUB_BTRFS_CHUNK_TYPE_RAID5:
+    case GRUB_BTRFS_CHUNK_TYPE_RAID6:
+      map->nparities = map->profile == GRUB_BTRFS_CHUNK_TYPE_RAID5 ? 1 : 2;
+      if (map->nstripes > map->nparities)
+	map->data_stripes = map->nstripes - map->nparities;
+      else
+	map->data_stripes = 1;
+      break;
+    }
+
+  /* The stripe length is 64K in practice, avoid the 64-bit division.  */
+  map->stripe_shift = -1;
+  if ((map->stripe_length & (map->stripe_length - 1)) == 0)
+    for (map->stripe_shift = 0;
+	 (1ULL << map->stripe_shift) < map->stripe_length;
+	 map->stripe_shift++);
+}
+
+static inline grub_uint64_t
+grub_btrfs_chunk_map_div (const struct grub_btrfs_chunk_map *map,
+			  grub_uint64_t off, grub_uint64_t *rem)
+{
+  if (map->stripe_shift >= 0)
+    {
+      *rem = off & (map->stripe_length - 1);
+      return off >> map->stripe_shift;
+    }
+  return grub_divmod64 (off, map->stripe_length, rem);
+}
+
+/* Find the chunk containing ADDR in the in-memory chunk map.  */
+static struct grub_btrfs_chunk_map *
+grub_btrfs_chunk_map_lookup (struct grub_btrfs_data *data, grub_uint64_t addr)
+{
+  unsigned lo = 0, hi = data->n_chunk_map;
+
+  while (lo < hi)
+    {
+      unsigned mid = lo + (hi - lo) / 2;
+
+      if (data->chunk_map[mid].start <= addr)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (lo == 0 || addr - data->chunk_map[lo - 1].start
+      >= data->chunk_map[lo - 1].size)
+    return NULL;
+  return &data->chunk_map[lo - 1];
+}
+
+static void
+grub_btrfs_free_chunk_map (struct grub_btrfs_data *data)
+{
+  unsigned i;
+
+  for (i = 0; i < data->n_chunk_map; i++)
+    grub_free (data->chunk_map[i].chunk);
+  grub_free (data->chunk_map);
+  data->chunk_map = NULL;
+  data->n_chunk_map = 0;
+}
+
+/* Read the whole chunk tree, so that logical addresses can be translated
+   without a tree search.  The tree itself lives in chunks of the bootstrap
+   mapping.  Failing is not fatal: lookups then go to the tree as
+   before.  */
+static void
+grub_btrfs_load_chunk_map (struct grub_btrfs_data *data)
+{
+  struct grub_btrfs_chunk_map *map = NULL;
+  struct grub_btrfs_leaf_descriptor desc;
+  struct grub_btrfs_key key_in, key_out;
+  grub_disk_addr_t elemaddr;
+  grub_size_t elemsize;
+  unsigned n = 0, allocated = 0;
+  grub_err_t err;
+  int r;
+
+  key_in.object_id = grub_cpu_to_le64_compile_time (GRUB_BTRFS_OBJECT_ID_CHUNK);
+  key_in.type = GRUB_BTRFS_ITEM_TYPE_CHUNK;
+  key_in.offset = 0;
+  err = lower_bound (data, &key_in, &key_out, data->sblock.chunk_tree,
+		     &elemaddr, &elemsize, &desc, 0);
+  if (err)
+    {
+      free_iterator (&desc);
+      goto fail;
+    }
+  r = 1;
+  if (key_out.type != GRUB_BTRFS_ITEM_TYPE_CHUNK
+      || key_out.object_id != key_in.object_id)
+    r = next (data, &desc, &elemaddr, &elemsize, &key_out);
+
+  for (; r > 0; r = next (data, &desc, &elemaddr, &elemsize, &key_out))
+    {
+      struct grub_btrfs_chunk_item *chunk;
+
+      if (key_out.type != GRUB_BTRFS_ITEM_TYPE_CHUNK
+	  || key_out.object_id != key_in.object_id)
+	break;
+
+      if (elemsize < sizeof (*chunk))
+	{
+	  r = -grub_error (GRUB_ERR_BAD_FS, "chunk item is too short");
+	  break;
+	}
+      chunk = grub_malloc (elemsize);
+      if (!chunk)
+	{
+	  r = -grub_errno;
+	  break;
+	}
+      err = grub_btrfs_read_logical (data, elemaddr, chunk, elemsize, 0);
+      if (!err && sizeof (*chunk) + grub_le_to_cpu16 (chunk->nstripes)
+	  * sizeof (struct grub_btrfs_chunk_stripe) > elemsize)
+	err = grub_error (GRUB_ERR_BAD_FS, "chunk item is too short");
+      if (!err && n == allocated)
+	{
+	  struct grub_btrfs_chunk_map *newmap;
+
+	  allocated = allocated ? 2 * allocated : 16;
+	  newmap = grub_realloc (map, allocated * sizeof (map[0]));
+	  if (newmap)
+	    map = newmap;
+	  else
+	    err = grub_errno;
+	}
+      if (err)
+	{
+	  grub_free (chunk);
+	  r = -err;
+	  break;
+	}
+      grub_btrfs_chunk_map_init (&map[n++], grub_le_to_cpu64 (key_out.offset),
+				 chunk);
+    }
+  free_iterator (&desc);
+
+  data->chunk_map = map;
+  data->n_chunk_map = n;
+  if (r >= 0)
+    {
+      grub_dprintf ("btrfs", "%u chunks in the chunk map\n", n);
+      return;
+    }
+  grub_btrfs_free_chunk_map (data);
+
+ fail:
+  grub_dprintf ("btrfs", "couldn't load the chunk map: %s\n", grub_errmsg);
+  grub_errno = GRUB_ERR_NONE;
+}
+
+/* Context for grub_btrfs_read_parity.  */
+struct grub_btrfs_parity_ctx
+{
+  struct grub_btrfs_data *data;
+  struct grub_btrfs_chunk_map *map;
+};
+
+/* Read SIZE bytes at STRIPE_OFFSET of member DISKNR of a RAID5/6 chunk.  */
+static grub_err_t
+grub_btrfs_read_parity_member (void *data, int disknr,
+			       grub_uint64_t stripe_offset, void *buf,
+			       grub_size_t size)
+{
+  struct grub_btrfs_parity_ctx *ctx = data;
+  struct grub_btrfs_chunk_stripe *stripe = &ctx->map->stripes[disknr];
+  grub_disk_addr_t paddr;
+  grub_device_t dev;
+
+  paddr = grub_le_to_cpu64 (stripe->offset) + stripe_offset;
+  dev = find_device (ctx->data, stripe->device_id, 1);
+  if (!dev)
+    return grub_errno;
+  return grub_disk_read (dev->disk, paddr >> GRUB_DISK_SECTOR_BITS,
+			 paddr & (GRUB_DISK_SECTOR_SIZE - 1), size, buf);
+}
+
+/* Rebuild the data of member DISKNR in row ROW from the rest of the row.
+   All members of a row share the same STRIPE_OFFSET.  */
+static grub_err_t
+grub_btrfs_read_parity (struct grub_btrfs_data *data,
+			struct grub_btrfs_chunk_map *map, grub_uint64_t row,
+			int disknr, grub_uint64_t stripe_offset,
+			void *buf, grub_size_t size)
+{
+  struct grub_btrfs_parity_ctx ctx = { data, map };
+  grub_uint64_t p;
+
+  grub_dprintf ("btrfs", "rebuilding stripe %d of row %" PRIxGRUB_UINT64_T
+		" from %s\n", disknr, row,
+		map->nparities == 1 ? "RAID5 parity" : "RAID6 syndromes");
+
+  if (map->nstripes <= map->nparities)
+    return grub_error (GRUB_ERR_BAD_FS, "too few stripes for RAID%d",
+		       map->nparities == 1 ? 5 : 6);
+
+  if (map->nparities == 1)
+    {
+      if (!grub_raid5_recover_gen_func)
+	return grub_error (GRUB_ERR_BAD_DEVICE,
+			   N_("module `%s' isn't loaded"), "raid5rec");
+      return grub_raid5_recover_gen_func (&ctx, map->nstripes, disknr, buf,
+					  stripe_offset, size,
+					  grub_btrfs_read_parity_member);
+    }
+
+  if (!grub_raid6_recover_gen_func)
+    return grub_error (GRUB_ERR_BAD_DEVICE,
+		       N_("module `%s' isn't loaded"), "raid6rec");
+  /* P follows the last data stripe of the row and Q follows P.  */
+  grub_divmod64 (row + map->data_stripes, map->nstripes, &p);
+  return grub_raid6_recover_gen_func (&ctx, map->nstripes, disknr, p, buf,
+				      stripe_offset, size, 0,
+				      grub_btrfs_read_parity_member);
+}
+
 static grub_err_t
 grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 			 void *buf, grub_size_t size, int recursion_depth)
@@ -614,7 +918,8 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
     {
       grub_uint8_t *ptr;
       struct grub_btrfs_key *key;
-      struct grub_btrfs_chunk_item *chunk;
+      struct grub_btrfs_chunk_item *chunk = NULL;
+      struct grub_btrfs_chunk_map *map, tmpmap;
       grub_uint64_t csize;
       grub_err_t err = 0;
       struct grub_btrfs_key key_out;
@@ -626,6 +931,10 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 
       grub_dprintf ("btrfs", "searching for laddr %" PRIxGRUB_UINT64_T "\n",
 		    addr);
+      map = grub_btrfs_chunk_map_lookup (data, addr);
+      if (map)
+	goto chunk_found;
+
       for (ptr = data->sblock.bootstrap_mapping;
 	   ptr < data->sblock.bootstrap_mapping
 	   + sizeof (data->sblock.bootstrap_mapping)
@@ -642,12 +951,21 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	  if (grub_le_to_cpu64 (key->offset) <= addr
 	      && addr < grub_le_to_cpu64 (key->offset)
 	      + grub_le_to_cpu64 (chunk->size))
-	    goto chunk_found;
+	    goto bootstrap_found;
 	  ptr += sizeof (*key) + sizeof (*chunk)
 	    + sizeof (struct grub_btrfs_chunk_stripe)
 	    * grub_le_to_cpu16 (chunk->nstripes);
 	}
 
+      if (!data->chunk_map_loaded)
+	{
+	  data->chunk_map_loaded = 1;
+	  grub_btrfs_load_chunk_map (data);
+	  map = grub_btrfs_chunk_map_lookup (data, addr);
+	  if (map)
+	    goto chunk_found;
+	}
+
       key_in.object_id = grub_cpu_to_le64_compile_time (GRUB_BTRFS_OBJECT_ID_CHUNK);
       key_in.type = GRUB_BTRFS_ITEM_TYPE_CHUNK;
       key_in.offset = grub_cpu_to_le64 (addr);
@@ -675,49 +993,42 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	  return err;
 	}
 
+    bootstrap_found:
+      grub_btrfs_chunk_map_init (&tmpmap, grub_le_to_cpu64 (key->offset),
+				 chunk);
+      map = &tmpmap;
+
     chunk_found:
       {
 	grub_uint64_t stripen;
 	grub_uint64_t stripe_offset;
-	grub_uint64_t off = addr - grub_le_to_cpu64 (key->offset);
-	grub_uint64_t chunk_stripe_length;
-	grub_uint16_t nstripes;
-	unsigned redundancy = 1;
+	grub_uint64_t row = 0;
+	grub_uint64_t off = addr - map->start;
 	unsigned i, j;
 
-	if (grub_le_to_cpu64 (chunk->size) <= off)
+	if (map->size <= off)
 	  {
 	    grub_dprintf ("btrfs", "no chunk\n");
+	    if (challoc)
+	      grub_free (chunk);
 	    return grub_error (GRUB_ERR_BAD_FS,
 			       "couldn't find the chunk descriptor");
 	  }
 
-	nstripes = grub_le_to_cpu16 (chunk->nstripes) ? : 1;
-	chunk_stripe_length = grub_le_to_cpu64 (chunk->stripe_length) ? : 512;
 	grub_dprintf ("btrfs", "chunk 0x%" PRIxGRUB_UINT64_T
 		      "+0x%" PRIxGRUB_UINT64_T
 		      " (%d stripes (%d substripes) of %"
 		      PRIxGRUB_UINT64_T ")\n",
-		      grub_le_to_cpu64 (key->offset),
-		      grub_le_to_cpu64 (chunk->size),
-		      nstripes,
-		      grub_le_to_cpu16 (chunk->nsubstripes),
-		      chunk_stripe_length);
-
-	switch (grub_le_to_cpu64 (chunk->type)
-		& ~GRUB_BTRFS_CHUNK_TYPE_BITS_DONTCARE)
+		      map->start, map->size, map->nstripes,
+		      map->nsubstripes, map->stripe_length);
+
+	switch (map->profile)
 	  {
 	  case GRUB_BTRFS_CHUNK_TYPE_SINGLE:
 	    {
-	      grub_uint64_t stripe_length;
 	      grub_dprintf ("btrfs", "single\n");
-	      stripe_length = grub_divmod64 (grub_le_to_cpu64 (chunk->size),
-					     nstripes,
-					     NULL);
-	      if (stripe_length == 0)
-		stripe_length = 512;
-	      stripen = grub_divmod64 (off, stripe_length, &stripe_offset);
-	      csize = (stripen + 1) * stripe_length - off;
+	      stripen = grub_btrfs_chunk_map_div (map, off, &stripe_offset);
+	      csize = (stripen + 1) * map->stripe_length - off;
 	      break;
 	    }
 	  case GRUB_BTRFS_CHUNK_TYPE_DUPLICATED:
@@ -726,8 +1037,7 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	      grub_dprintf ("btrfs", "RAID1\n");
 	      stripen = 0;
 	      stripe_offset = off;
-	      csize = grub_le_to_cpu64 (chunk->size) - off;
-	      redundancy = 2;
+	      csize = map->size - off;
 	      break;
 	    }
 	  case GRUB_BTRFS_CHUNK_TYPE_RAID0:
@@ -735,60 +1045,71 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	      grub_uint64_t middle, high;
 	      grub_uint64_t low;
 	      grub_dprintf ("btrfs", "RAID0\n");
-	      middle = grub_divmod64 (off,
-				      chunk_stripe_length,
-				      &low);
+	      middle = grub_btrfs_chunk_map_div (map, off, &low);
 
-	      high = grub_divmod64 (middle, nstripes,
+	      high = grub_divmod64 (middle, map->nstripes,
 				    &stripen);
 	      stripe_offset =
-		low + chunk_stripe_length * high;
-	      csize = chunk_stripe_length - low;
+		low + map->stripe_length * high;
+	      csize = map->stripe_length - low;
 	      break;
 	    }
 	  case GRUB_BTRFS_CHUNK_TYPE_RAID10:
 	    {
 	      grub_uint64_t middle, high;
 	      grub_uint64_t low;
-	      grub_uint16_t nsubstripes;
-	      nsubstripes = grub_le_to_cpu16 (chunk->nsubstripes) ? : 1;
-	      middle = grub_divmod64 (off,
-				      chunk_stripe_length,
-				      &low);
-
-	      high = grub_divmod64 (middle,
-				    nstripes / nsubstripes ? : 1,
+	      middle = grub_btrfs_chunk_map_div (map, off, &low);
+
+	      high = grub_divmod64 (middle, map->data_stripes,
 				    &stripen);
-	      stripen *= nsubstripes;
-	      redundancy = nsubstripes;
-	      stripe_offset = low + chunk_stripe_length
+	      stripen *= map->nsubstripes;
+	      stripe_offset = low + map->stripe_length
 		* high;
-	      csize = chunk_stripe_length - low;
+	      csize = map->stripe_length - low;
+	      break;
+	    }
+	  case GRUB_BTRFS_CHUNK_TYPE_RAID5:
+	  case GRUB_BTRFS_CHUNK_TYPE_RAID6:
+	    {
+	      grub_uint64_t middle, low;
+	      grub_dprintf ("btrfs", "RAID5/6\n");
+	      middle = grub_btrfs_chunk_map_div (map, off, &low);
+
+	      row = grub_divmod64 (middle, map->data_stripes, &stripen);
+	      /* Every row starts one member further.  */
+	      grub_divmod64 (row + stripen, map->nstripes, &stripen);
+	      stripe_offset = low + map->stripe_length * row;
+	      csize = map->stripe_length - low;
 	      break;
 	    }
 	  default:
 	    grub_dprintf ("btrfs", "unsupported RAID\n");
+	    if (challoc)
+	      grub_free (chunk);
 	    return grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
 			       "unsupported RAID flags %" PRIxGRUB_UINT64_T,
-			       grub_le_to_cpu64 (chunk->type));
+			       map->profile);
 	  }
 	if (csize == 0)
-	  return grub_error (GRUB_ERR_BUG,
-			     "couldn't find the chunk descriptor");
+	  {
+	    if (challoc)
+	      grub_free (chunk);
+	    return grub_error (GRUB_ERR_BUG,
+			       "couldn't find the chunk descriptor");
+	  }
 	if (csize > (grub_uint64_t) size)
 	  csize = size;
 
 	for (j = 0; j < 2; j++)
 	  {
-	    for (i = 0; i < redundancy; i++)
+	    for (i = 0; i < map->redundancy; i++)
 	      {
 		struct grub_btrfs_chunk_stripe *stripe;
 		grub_disk_addr_t paddr;
 
-		stripe = (struct grub_btrfs_chunk_stripe *) (chunk + 1);
-		/* Right now the redundancy handling is easy.
-		   With RAID5-like it will be more difficult.  */
-		stripe += stripen + i;
+		/* Mirrors are tried in turn, RAID5/6 members that can't be
+		   read are rebuilt from the parity below.  */
+		stripe = map->stripes + stripen + i;
 
 		paddr = grub_le_to_cpu64 (stripe->offset) + stripe_offset;
 
@@ -797,11 +1118,8 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 			      " (%d stripes (%d substripes) of %"
 			      PRIxGRUB_UINT64_T ") stripe %" PRIxGRUB_UINT64_T
 			      " maps to 0x%" PRIxGRUB_UINT64_T "\n",
-			      grub_le_to_cpu64 (key->offset),
-			      grub_le_to_cpu64 (chunk->size),
-			      grub_le_to_cpu16 (chunk->nstripes),
-			      grub_le_to_cpu16 (chunk->nsubstripes),
-			      grub_le_to_cpu64 (chunk->stripe_length),
+			      map->start, map->size, map->nstripes,
+			      map->nsubstripes, map->stripe_length,
 			      stripen, stripe->offset);
 		grub_dprintf ("btrfs", "reading paddr 0x%" PRIxGRUB_UINT64_T
 			      " for laddr 0x%" PRIxGRUB_UINT64_T "\n", paddr,
@@ -822,11 +1140,21 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 		  break;
 		grub_errno = GRUB_ERR_NONE;
 	      }
-	    if (i != redundancy)
+	    if (i != map->redundancy)
 	      break;
 	  }
+	if (err && map->nparities)
+	  {
+	    grub_errno = GRUB_ERR_NONE;
+	    err = grub_btrfs_read_parity (data, map, row, stripen,
+					  stripe_offset, buf, csize);
+	  }
 	if (err)
-	  return grub_errno = err;
+	  {
+	    if (challoc)
+	      grub_free (chunk);
+	    return grub_errno = err;
+	  }
       }
       size -= csize;
       buf = (grub_uint8_t *) buf + csize;
@@ -884,6 +1212,9 @@ grub_btrfs_unmount (struct grub_btrfs_data *data)
     grub_device_close (data->devices_attached[i].dev);
   grub_free (data->devices_attached);
   grub_free (data->extent);
+  for (i = 0; i < GRUB_BTRFS_EXTENT_CACHE_SIZE; i++)
+    grub_free (data->extent_cache[i].buf);
+  grub_btrfs_free_chunk_map (data);
   grub_free (data);
 }
 
@@ -1005,6 +1336,113 @@ grub_btrfs_lzo_decompress(char *ibuf, grub_size_t isize, grub_off_t off,
   return ret;
 }
 
+/* Decompress OSIZE bytes at offset EXTOFF of the current extent.  */
+static grub_err_t
+grub_btrfs_extent_decompress (struct grub_btrfs_data *data,
+			      grub_off_t extoff, char *obuf, grub_size_t osize)
+{
+  char *ibuf, *tmp = NULL;
+  grub_size_t isize;
+  grub_ssize_t ret;
+  grub_err_t err;
+
+  if (data->extent->type == GRUB_BTRFS_EXTENT_INLINE)
+    {
+      ibuf = data->extent->inl;
+      isize = data->extsize - ((grub_uint8_t *) data->extent->inl
+			       - (grub_uint8_t *) data->extent);
+    }
+  else
+    {
+      isize = grub_le_to_cpu64 (data->extent->compressed_size);
+      tmp = grub_malloc (isize);
+      if (!tmp)
+	return grub_errno;
+      err = grub_btrfs_read_logical (data,
+				     grub_le_to_cpu64 (data->extent->laddr),
+				     tmp, isize, 0);
+      if (err)
+	{
+	  grub_free (tmp);
+	  return err;
+	}
+      ibuf = tmp;
+      extoff += grub_le_to_cpu64 (data->extent->offset);
+    }
+
+  if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZLIB)
+    ret = grub_zlib_decompress (ibuf, isize, extoff, obuf, osize);
+  else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_LZO)
+    ret = grub_btrfs_lzo_decompress (ibuf, isize, extoff, obuf, osize);
+  else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZSTD)
+    ret = grub_zstd_decompress (ibuf, isize, extoff, obuf, osize);
+  else
+    ret = -1;
+
+  grub_free (tmp);
+
+  if (ret != (grub_ssize_t) osize)
+    {
+      if (!grub_errno)
+	grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		    "premature end of compressed");
+      return grub_errno;
+    }
+  return GRUB_ERR_NONE;
+}
+
+/* Read from the current, compressed, extent.  Small reads would otherwise
+   decompress the extent from its start every time, so whole extents are
+   kept in a small per-mount cache.  */
+static grub_err_t
+grub_btrfs_read_compressed (struct grub_btrfs_data *data, grub_off_t extoff,
+			    char *buf, grub_size_t csize)
+{
+  struct grub_btrfs_extent_cache *e, *victim = NULL;
+  grub_size_t size = data->extend - data->extstart;
+  char *ebuf;
+  unsigned i;
+
+  for (i = 0; i < GRUB_BTRFS_EXTENT_CACHE_SIZE; i++)
+    {
+      e = &data->extent_cache[i];
+      if (e->buf && e->tree == data->exttree && e->inode == data->extino
+	  && e->start == data->extstart && e->size == size)
+	{
+	  e->last_used = ++data->extent_cache_clock;
+	  grub_memcpy (buf, e->buf + extoff, csize);
+	  return GRUB_ERR_NONE;
+	}
+      if (!victim || !e->buf
+	  || (victim->buf && e->last_used < victim->last_used))
+	victim = e;
+    }
+
+  /* Not worth caching if the whole extent is read at once anyway.  */
+  if (size > GRUB_BTRFS_EXTENT_CACHE_MAX || (extoff == 0 && csize == size))
+    return grub_btrfs_extent_decompress (data, extoff, buf, csize);
+
+  ebuf = grub_malloc (size);
+  if (!ebuf)
+    return grub_errno;
+  if (grub_btrfs_extent_decompress (data, 0, ebuf, size))
+    {
+      grub_free (ebuf);
+      return grub_errno;
+    }
+
+  grub_free (victim->buf);
+  victim->tree = data->exttree;
+  victim->inode = data->extino;
+  victim->start = data->extstart;
+  victim->size = size;
+  victim->buf = ebuf;
+  victim->last_used = ++data->extent_cache_clock;
+
+  grub_memcpy (buf, ebuf + extoff, csize);
+  return GRUB_ERR_NONE;
+}
+
 static grub_ssize_t
 grub_btrfs_extent_read (struct grub_btrfs_data *data,
 			grub_uint64_t ino, grub_uint64_t tree,
@@ -1087,7 +1525,8 @@ grub_btrfs_extent_read (struct grub_btrfs_data *data,
 
       if (data->extent->compression != GRUB_BTRFS_COMPRESSION_NONE
 	  && data->extent->compression != GRUB_BTRFS_COMPRESSION_ZLIB
-	  && data->extent->compression != GRUB_BTRFS_COMPRESSION_LZO)
+	  && data->extent->compression != GRUB_BTRFS_COMPRESSION_LZO
+	  && data->extent->compression != GRUB_BTRFS_COMPRESSION_ZSTD)
 	{
 	  grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
 		      "compression type 0x%x not supported",
@@ -1104,27 +1543,9 @@ grub_btrfs_extent_read (struct grub_btrfs_data *data,
       switch (data->extent->type)
 	{
 	case GRUB_BTRFS_EXTENT_INLINE:
-	  if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZLIB)
-	    {
-	      if (grub_zlib_decompress (data->extent->inl, data->extsize -
-					((grub_uint8_t *) data->extent->inl
-					 - (grub_uint8_t *) data->extent),
-					extoff, buf, csize)
-		  != (grub_ssize_t) csize)
-		{
-		  if (!grub_errno)
-		    grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
-				"premature end of compressed");
-		  return -1;
-		}
-	    }
-	  else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_LZO)
+	  if (data->extent->compression != GRUB_BTRFS_COMPRESSION_NONE)
 	    {
-	      if (grub_btrfs_lzo_decompress(data->extent->inl, data->extsize -
-					   ((grub_uint8_t *) data->extent->inl
-					    - (grub_uint8_t *) data->extent),
-					   extoff, buf, csize)
-		  != (grub_ssize_t) csize)
+	      if (grub_btrfs_read_compressed (data, extoff, buf, csize))
 		return -1;
 	    }
 	  else
@@ -1139,44 +1560,8 @@ grub_btrfs_extent_read (struct grub_btrfs_data *data,
 
 	  if (data->extent->compression != GRUB_BTRFS_COMPRESSION_NONE)
 	    {
-	      char *tmp;
-	      grub_uint64_t zsize;
-	      grub_ssize_t ret;
-
-	      zsize = grub_le_to_cpu64 (data->extent->compressed_size);
-	      tmp = grub_malloc (zsize);
-	      if (!tmp)
+	      if (grub_btrfs_read_compressed (data, extoff, buf, csize))
 		return -1;
-	      err = grub_btrfs_read_logical (data,
-					     grub_le_to_cpu64 (data->extent->laddr),
-					     tmp, zsize, 0);
-	      if (err)
-		{
-		  grub_free (tmp);
-		  return -1;
-		}
-
-	      if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZLIB)
-		ret = grub_zlib_decompress (tmp, zsize, extoff
-				    + grub_le_to_cpu64 (data->extent->offset),
-				    buf, csize);
-	      else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_LZO)
-		ret = grub_btrfs_lzo_decompress (tmp, zsize, extoff
-				    + grub_le_to_cpu64 (data->extent->offset),
-				    buf, csize);
-	      else
-		ret = -1;
-
-	      grub_free (tmp);
-
-	      if (ret != (grub_ssize_t) csize)
-		{
-		  if (!grub_errno)
-		    grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
-				"premature end of compressed");
-		  return -1;
-		}
-
 	      break;
 	    }
 	  err = grub_btrfs_read_logical (data,
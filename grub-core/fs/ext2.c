@@ -463,54 +463,6 @@ grub_ext2_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
   grub_uint32_t indir;
   int shift;
 
-  if (inode->flags & grub_cpu_to_le32_compile_time (EXT4_EXTENTS_FLAG))
-    {
-      struct grub_ext4_extent_header *leaf;
-      struct grub_ext4_extent *ext;
-      int i;
-      grub_disk_addr_t ret;
-
-      leaf = grub_ext4_find_leaf (data, (struct grub_ext4_extent_header *) inode->blocks.dir_blocks, fileblock);
-      if (! leaf)
-        {
-          grub_error (GRUB_ERR_BAD_FS, "invalid extent");
-          return -1;
-        }
-
-      ext = (struct grub_ext4_extent *) (leaf + 1);
-      for (i = 0; i < grub_le_to_cpu16 (leaf->entries); i++)
-        {
-          if (fileblock < grub_le_to_cpu32 (ext[i].block))
-            break;
-        }
-
-      if (--i >= 0)
-        {
-          fileblock -= grub_le_to_cpu32 (ext[i].block);
-          if (fileblock >= grub_le_to_cpu16 (ext[i].len))
-	    ret = 0;
-          else
-            {
-              grub_disk_addr_t start;
-
-              start = grub_le_to_cpu16 (ext[i].start_hi);
-              start = (start << 32) + grub_le_to_cpu32 (ext[i].start);
-
-              ret = fileblock + start;
-            }
-        }
-      else
-        {
-          grub_error (GRUB_ERR_BAD_FS, "something wrong with extent");
-	  ret = -1;
-        }
-
-      if (leaf != (struct grub_ext4_extent_header *) inode->blocks.dir_blocks)
-	grub_free (leaf);
-
-      return ret;
-    }
-
   /* Direct blocks.  */
   if (fileblock < INDIRECT_BLOCKS)
     return grub_le_to_cpu32 (inode->blocks.dir_blocks[fileblock]);
@@ -561,6 +513,70 @@ indirect:
   return grub_le_to_cpu32 (indir);
 }
 
+/* Find the run of blocks containing FILEBLOCK.  Files using extents
+   map whole extents at once, files using indirect blocks are mapped one
+   block at a time.  */
+static grub_err_t
+grub_ext2_read_extent (grub_fshelp_node_t node, grub_disk_addr_t fileblock,
+		       struct grub_fshelp_extent *extent)
+{
+  struct grub_ext2_data *data = node->data;
+  struct grub_ext2_inode *inode = &node->inode;
+  struct grub_ext4_extent_header *leaf;
+  struct grub_ext4_extent *ext;
+  int i, entries;
+
+  if (! (inode->flags & grub_cpu_to_le32_compile_time (EXT4_EXTENTS_FLAG)))
+    {
+      extent->logical = fileblock;
+      extent->physical = grub_ext2_read_block (node, fileblock);
+      extent->length = 1;
+      return grub_errno;
+    }
+
+  leaf = grub_ext4_find_leaf (data, (struct grub_ext4_extent_header *) inode->blocks.dir_blocks, fileblock);
+  if (! leaf)
+    return grub_error (GRUB_ERR_BAD_FS, "invalid extent");
+
+  ext = (struct grub_ext4_extent *) (leaf + 1);
+  entries = grub_le_to_cpu16 (leaf->entries);
+  for (i = 0; i < entries; i++)
+    {
+      if (fileblock < grub_le_to_cpu32 (ext[i].block))
+	break;
+    }
+
+  if (--i >= 0
+      && fileblock - grub_le_to_cpu32 (ext[i].block)
+      < grub_le_to_cpu16 (ext[i].len))
+    {
+      grub_disk_addr_t start;
+
+      start = grub_le_to_cpu16 (ext[i].start_hi);
+      start = (start << 32) + grub_le_to_cpu32 (ext[i].start);
+
+      extent->logical = grub_le_to_cpu32 (ext[i].block);
+      extent->physical = start;
+      extent->length = grub_le_to_cpu16 (ext[i].len);
+    }
+  else
+    {
+      /* A hole up to the next extent in this leaf.  Past the last one
+	 the next leaf may continue, so only map this block.  */
+      extent->logical = fileblock;
+      extent->physical = 0;
+      if (i + 1 < entries)
+	extent->length = grub_le_to_cpu32 (ext[i + 1].block) - fileblock;
+      else
+	extent->length = 1;
+    }
+
+  if (leaf != (struct grub_ext4_extent_header *) inode->blocks.dir_blocks)
+    grub_free (leaf);
+
+  return GRUB_ERR_NONE;
+}
+
 /* Read LEN bytes from the file described by DATA starting with byte
    POS.  Return the amount of read bytes in READ.  */
 static grub_ssize_t
@@ -568,12 +584,12 @@ grub_ext2_read_file (grub_fshelp_node_t node,
 		     grub_disk_read_hook_t read_hook, void *read_hook_data,
 		     grub_off_t pos, grub_size_t len, char *buf)
 {
-  return grub_fshelp_read_file (node->data->disk, node,
-				read_hook, read_hook_data,
-				pos, len, buf, grub_ext2_read_block,
-				grub_cpu_to_le32 (node->inode.size)
-				| (((grub_off_t) grub_cpu_to_le32 (node->inode.size_high)) << 32),
-				LOG2_EXT2_BLOCK_SIZE (node->data), 0);
+  return grub_fshelp_read_file_extents (node->data->disk, node,
+					read_hook, read_hook_data,
+					pos, len, buf, grub_ext2_read_extent,
+					grub_cpu_to_le32 (node->inode.size)
+					| (((grub_off_t) grub_cpu_to_le32 (node->inode.size_high)) << 32),
+					LOG2_EXT2_BLOCK_SIZE (node->data), 0);
 
 }
 
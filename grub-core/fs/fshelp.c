@@ -344,23 +344,46 @@ grub_fshelp_find_file_lookup (const char *path, grub_fshelp_node_t rootnode,
 
 }
 
-/* Read LEN bytes from the file NODE on disk DISK into the buffer BUF,
-   beginning with the block POS.  READ_HOOK should be set before
-   reading a block from the file.  READ_HOOK_DATA is passed through as
-   the DATA argument to READ_HOOK.  GET_BLOCK is used to translate
-   file blocks to disk blocks.  The file is FILESIZE bytes big and the
-   blocks have a size of LOG2BLOCKSIZE (in log2).  */
-grub_ssize_t
-grub_fshelp_read_file (grub_disk_t disk, grub_fshelp_node_t node,
-		       grub_disk_read_hook_t read_hook, void *read_hook_data,
-		       grub_off_t pos, grub_size_t len, char *buf,
-		       grub_disk_addr_t (*get_block) (grub_fshelp_node_t node,
-                                                      grub_disk_addr_t block),
-		       grub_off_t filesize, int log2blocksize,
-		       grub_disk_addr_t blocks_start)
+typedef grub_disk_addr_t (*get_block_func) (grub_fshelp_node_t node,
+					    grub_disk_addr_t block);
+
+static grub_err_t
+read_run (grub_disk_t disk, grub_disk_read_hook_t read_hook,
+	  void *read_hook_data, grub_disk_addr_t sector, grub_off_t offset,
+	  grub_size_t size, char *buf)
 {
-  grub_disk_addr_t i, blockcnt;
-  int blocksize = 1 << (log2blocksize + GRUB_DISK_SECTOR_BITS);
+  if (!size)
+    return GRUB_ERR_NONE;
+
+  disk->read_hook = read_hook;
+  disk->read_hook_data = read_hook_data;
+  grub_disk_read (disk, sector, offset, size, buf);
+  disk->read_hook = 0;
+
+  return grub_errno;
+}
+
+/* Common part of grub_fshelp_read_file and grub_fshelp_read_file_extents.
+   Exactly one of GET_EXTENT and GET_BLOCK is set.  Blocks which follow
+   each other on disk are collected into a run and read at once.  */
+static grub_ssize_t
+read_file_real (grub_disk_t disk, grub_fshelp_node_t node,
+		grub_disk_read_hook_t read_hook, void *read_hook_data,
+		grub_off_t pos, grub_size_t len, char *buf,
+		grub_fshelp_get_extent_t get_extent,
+		get_block_func get_block,
+		grub_off_t filesize, int log2blocksize,
+		grub_disk_addr_t blocks_start)
+{
+  grub_disk_addr_t i, firstblock, blockcnt;
+  int log2bytes = log2blocksize + GRUB_DISK_SECTOR_BITS;
+  grub_size_t blocksize = (grub_size_t) 1 << log2bytes;
+  /* The pending run: SIZE bytes at OFFSET bytes after sector SECTOR,
+     to be stored at BUF.  */
+  grub_disk_addr_t run_sector = 0;
+  grub_off_t run_offset = 0;
+  grub_size_t run_size = 0;
+  char *run_buf = buf;
 
   if (pos > filesize)
     {
@@ -373,57 +396,129 @@ grub_fshelp_read_file (grub_disk_t disk, grub_fshelp_node_t node,
   if (pos + len > filesize)
     len = filesize - pos;
 
-  blockcnt = ((len + pos) + blocksize - 1) >> (log2blocksize + GRUB_DISK_SECTOR_BITS);
+  firstblock = pos >> log2bytes;
+  blockcnt = ((len + pos) + blocksize - 1) >> log2bytes;
 
-  for (i = pos >> (log2blocksize + GRUB_DISK_SECTOR_BITS); i < blockcnt; i++)
+  for (i = firstblock; i < blockcnt; )
     {
-      grub_disk_addr_t blknr;
-      int blockoff = pos & (blocksize - 1);
-      int blockend = blocksize;
+      struct grub_fshelp_extent extent;
+      grub_disk_addr_t count;
+      grub_off_t skipfirst = 0;
+      grub_size_t size;
 
-      int skipfirst = 0;
-
-      blknr = get_block (node, i);
-      if (grub_errno)
-	return -1;
-
-      blknr = blknr << log2blocksize;
-
-      /* Last block.  */
-      if (i == blockcnt - 1)
+      if (get_extent)
 	{
-	  blockend = (len + pos) & (blocksize - 1);
-
-	  /* The last portion is exactly blocksize.  */
-	  if (! blockend)
-	    blockend = blocksize;
+	  if (get_extent (node, i, &extent))
+	    return -1;
+	  if (extent.logical > i || extent.length <= i - extent.logical)
+	    {
+	      grub_error (GRUB_ERR_BAD_FS, "invalid extent");
+	      return -1;
+	    }
+	}
+      else
+	{
+	  extent.logical = i;
+	  extent.physical = get_block (node, i);
+	  if (grub_errno)
+	    return -1;
+	  extent.length = 1;
 	}
 
+      count = extent.length - (i - extent.logical);
+      if (count > blockcnt - i)
+	count = blockcnt - i;
+
+      size = count << log2bytes;
+
       /* First block.  */
-      if (i == (pos >> (log2blocksize + GRUB_DISK_SECTOR_BITS)))
+      if (i == firstblock)
 	{
-	  skipfirst = blockoff;
-	  blockend -= skipfirst;
+	  skipfirst = pos & (blocksize - 1);
+	  size -= skipfirst;
 	}
 
+      /* Last block.  */
+      if (i + count == blockcnt && ((len + pos) & (blocksize - 1)))
+	size -= blocksize - ((len + pos) & (blocksize - 1));
+
       /* If the block number is 0 this block is not stored on disk but
 	 is zero filled instead.  */
-      if (blknr)
+      if (extent.physical)
 	{
-	  disk->read_hook = read_hook;
-	  disk->read_hook_data = read_hook_data;
+	  grub_disk_addr_t blknr, sector;
 
-	  grub_disk_read (disk, blknr + blocks_start, skipfirst,
-			  blockend, buf);
-	  disk->read_hook = 0;
-	  if (grub_errno)
-	    return -1;
+	  blknr = extent.physical + (i - extent.logical);
+	  sector = (blknr << log2blocksize) + blocks_start;
+
+	  /* Extend the pending run if this one directly follows it.  */
+	  if (run_size
+	      && ((run_sector << GRUB_DISK_SECTOR_BITS) + run_offset + run_size
+		  == (sector << GRUB_DISK_SECTOR_BITS) + skipfirst))
+	    run_size += size;
+	  else
+	    {
+	      if (read_run (disk, read_hook, read_hook_data,
+			    run_sector, run_offset, run_size, run_buf))
+		return -1;
+	      run_sector = sector;
+	      run_offset = skipfirst;
+	      run_size = size;
+	      run_buf = buf;
+	    }
 	}
       else
-	grub_memset (buf, 0, blockend);
+	{
+	  if (read_run (disk, read_hook, read_hook_data,
+			run_sector, run_offset, run_size, run_buf))
+	    return -1;
+	  run_size = 0;
+	  grub_memset (buf, 0, size);
+	}
 
-      buf += blocksize - skipfirst;
+      buf += size;
+      i += count;
     }
 
+  if (read_run (disk, read_hook, read_hook_data,
+		run_sector, run_offset, run_size, run_buf))
+    return -1;
+
   return len;
 }
+
+/* Read LEN bytes from the file NODE on disk DISK into the buffer BUF,
+   beginning with the block POS.  READ_HOOK should be set before
+   reading a block from the file.  READ_HOOK_DATA is passed through as
+   the DATA argument to READ_HOOK.  GET_BLOCK is used to translate
+   file blocks to disk blocks.  The file is FILESIZE bytes big and the
+   blocks have a size of LOG2BLOCKSIZE (in log2).  */
+grub_ssize_t
+grub_fshelp_read_file (grub_disk_t disk, grub_fshelp_node_t node,
+		       grub_disk_read_hook_t read_hook, void *read_hook_data,
+		       grub_off_t pos, grub_size_t len, char *buf,
+		       grub_disk_addr_t (*get_block) (grub_fshelp_node_t node,
+                                                      grub_disk_addr_t block),
+		       grub_off_t filesize, int log2blocksize,
+		       grub_disk_addr_t blocks_start)
+{
+  return read_file_real (disk, node, read_hook, read_hook_data,
+			 pos, len, buf, NULL, get_block,
+			 filesize, log2blocksize, blocks_start);
+}
+
+/* Same as grub_fshelp_read_file, except that GET_EXTENT translates a
+   file block into the whole run of blocks containing it.  */
+grub_ssize_t
+grub_fshelp_read_file_extents (grub_disk_t disk, grub_fshelp_node_t node,
+			       grub_disk_read_hook_t read_hook,
+			       void *read_hook_data,
+			       grub_off_t pos, grub_size_t len, char *buf,
+			       grub_fshelp_get_extent_t get_extent,
+			       grub_off_t filesize, int log2blocksize,
+			       grub_disk_addr_t blocks_start)
+{
+  return read_file_real (disk, node, read_hook, read_hook_data,
+			 pos, len, buf, get_extent, NULL,
+			 filesize, log2blocksize, blocks_start);
+}
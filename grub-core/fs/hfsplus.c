@@ -115,10 +115,12 @@ grub_ssize_t (*grub_hfsplus_read_compressed) (struct grub_hfsplus_file *node,
 
 /* Find the extent that points to FILEBLOCK.  If it is not in one of
    the 8 extents described by EXTENT, return -1.  In that case set
-   FILEBLOCK to the next block.  */
+   FILEBLOCK to the next block.  Otherwise set COUNT to the number of
+   blocks left in the extent, starting with FILEBLOCK.  */
 static grub_disk_addr_t
 grub_hfsplus_find_block (struct grub_hfsplus_extent *extent,
-			 grub_disk_addr_t *fileblock)
+			 grub_disk_addr_t *fileblock,
+			 grub_disk_addr_t *count)
 {
   int i;
   grub_disk_addr_t blksleft = *fileblock;
@@ -127,7 +129,10 @@ grub_hfsplus_find_block (struct grub_hfsplus_extent *extent,
   for (i = 0; i < 8; i++)
     {
       if (blksleft < grub_be_to_cpu32 (extent[i].count))
-	return grub_be_to_cpu32 (extent[i].start) + blksleft;
+	{
+	  *count = grub_be_to_cpu32 (extent[i].count) - blksleft;
+	  return grub_be_to_cpu32 (extent[i].start) + blksleft;
+	}
       blksleft -= grub_be_to_cpu32 (extent[i].count);
     }
 
@@ -138,10 +143,11 @@ grub_hfsplus_find_block (struct grub_hfsplus_extent *extent,
 static int grub_hfsplus_cmp_extkey (struct grub_hfsplus_key *keya,
 				    struct grub_hfsplus_key_internal *keyb);
 
-/* Search for the block FILEBLOCK inside the file NODE.  Return the
-   blocknumber of this block on disk.  */
-static grub_disk_addr_t
-grub_hfsplus_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
+/* Search for the block FILEBLOCK inside the file NODE.  Store the
+   remainder of the extent containing it in EXTENT.  */
+static grub_err_t
+grub_hfsplus_read_extent (grub_fshelp_node_t node, grub_disk_addr_t fileblock,
+			  struct grub_fshelp_extent *extent)
 {
   struct grub_hfsplus_btnode *nnode = 0;
   grub_disk_addr_t blksleft = fileblock;
@@ -152,11 +158,11 @@ grub_hfsplus_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
     {
       struct grub_hfsplus_extkey *key;
       struct grub_hfsplus_key_internal extoverflow;
-      grub_disk_addr_t blk;
+      grub_disk_addr_t blk, count;
       grub_off_t ptr;
 
       /* Try to find this block in the current set of extents.  */
-      blk = grub_hfsplus_find_block (extents, &blksleft);
+      blk = grub_hfsplus_find_block (extents, &blksleft, &count);
 
       /* The previous iteration of this loop allocated memory.  The
 	 code above used this memory, it can be freed now.  */
@@ -164,7 +170,12 @@ grub_hfsplus_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
       nnode = 0;
 
       if (blk != 0xffffffffffffffffULL)
-	return blk;
+	{
+	  extent->logical = fileblock;
+	  extent->physical = blk;
+	  extent->length = count;
+	  return GRUB_ERR_NONE;
+	}
 
       /* For the extent overflow file, extra extents can't be found in
 	 the extent overflow file.  If this happens, you found a
@@ -204,7 +215,7 @@ grub_hfsplus_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
   grub_free (nnode);
 
   /* Too bad, you lose.  */
-  return -1;
+  return grub_errno;
 }
 
 
@@ -215,12 +226,12 @@ grub_hfsplus_read_file (grub_fshelp_node_t node,
 			grub_disk_read_hook_t read_hook, void *read_hook_data,
 			grub_off_t pos, grub_size_t len, char *buf)
 {
-  return grub_fshelp_read_file (node->data->disk, node,
-				read_hook, read_hook_data,
-				pos, len, buf, grub_hfsplus_read_block,
-				node->size,
-				node->data->log2blksize - GRUB_DISK_SECTOR_BITS,
-				node->data->embedded_offset);
+  return grub_fshelp_read_file_extents (node->data->disk, node,
+					read_hook, read_hook_data,
+					pos, len, buf, grub_hfsplus_read_extent,
+					node->size,
+					node->data->log2blksize - GRUB_DISK_SECTOR_BITS,
+					node->data->embedded_offset);
 }
 
 static struct grub_hfsplus_data *
@@ -26,6 +26,7 @@
 #include <grub/types.h>
 #include <grub/charset.h>
 #include <grub/i18n.h>
+#include <grub/fshelp.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -258,11 +259,13 @@ static grub_dl_t my_mod;
 
 static grub_err_t grub_jfs_lookup_symlink (struct grub_jfs_data *data, grub_uint32_t ino);
 
-static grub_int64_t
-getblk (struct grub_jfs_treehead *treehead,
-	struct grub_jfs_tree_extent *extents,
-	struct grub_jfs_data *data,
-	grub_uint64_t blk)
+/* Find the extent containing the block BLK and store it in EXTENT.
+   Return 1 if it was found and 0 otherwise or on error.  */
+static int
+getextent (struct grub_jfs_treehead *treehead,
+	   struct grub_jfs_tree_extent *extents,
+	   struct grub_jfs_data *data,
+	   grub_uint64_t blk, struct grub_fshelp_extent *extent)
 {
   int found = -1;
   int i;
@@ -271,13 +274,18 @@ getblk (struct grub_jfs_treehead *treehead,
     {
       if (treehead->flags & GRUB_JFS_TREE_LEAF)
 	{
+	  grub_uint64_t length = (grub_le_to_cpu16 (extents[i].extent.length)
+				  + (extents[i].extent.length2 << 16));
+
 	  /* Read the leafnode.  */
 	  if (grub_le_to_cpu32 (extents[i].offset2) <= blk
-	      && ((grub_le_to_cpu16 (extents[i].extent.length))
-		  + (extents[i].extent.length2 << 16)
-		  + grub_le_to_cpu32 (extents[i].offset2)) > blk)
-	    return (blk - grub_le_to_cpu32 (extents[i].offset2)
-		    + grub_le_to_cpu32 (extents[i].extent.blk2));
+	      && length + grub_le_to_cpu32 (extents[i].offset2) > blk)
+	    {
+	      extent->logical = grub_le_to_cpu32 (extents[i].offset2);
+	      extent->physical = grub_le_to_cpu32 (extents[i].extent.blk2);
+	      extent->length = length;
+	      return 1;
+	    }
 	}
       else
 	if (blk >= grub_le_to_cpu32 (extents[i].offset2))
@@ -286,7 +294,7 @@ getblk (struct grub_jfs_treehead *treehead,
 
   if (found != -1)
     {
-      grub_int64_t ret = -1;
+      int ret = 0;
       struct
       {
 	struct grub_jfs_treehead treehead;
@@ -295,19 +303,33 @@ getblk (struct grub_jfs_treehead *treehead,
 
       tree = grub_zalloc (sizeof (*tree));
       if (!tree)
-	return -1;
+	return 0;
 
       if (!grub_disk_read (data->disk,
 			   ((grub_disk_addr_t) grub_le_to_cpu32 (extents[found].extent.blk2))
 			   << (grub_le_to_cpu16 (data->sblock.log2_blksz)
 			       - GRUB_DISK_SECTOR_BITS), 0,
 			   sizeof (*tree), (char *) tree))
-	ret = getblk (&tree->treehead, &tree->extents[0], data, blk);
+	ret = getextent (&tree->treehead, &tree->extents[0], data, blk, extent);
       grub_free (tree);
       return ret;
     }
 
-  return -1;
+  return 0;
+}
+
+static grub_int64_t
+getblk (struct grub_jfs_treehead *treehead,
+	struct grub_jfs_tree_extent *extents,
+	struct grub_jfs_data *data,
+	grub_uint64_t blk)
+{
+  struct grub_fshelp_extent extent;
+
+  if (!getextent (treehead, extents, data, blk, &extent))
+    return -1;
+
+  return blk - extent.logical + extent.physical;
 }
 
 /* Get the block number for the block BLK in the node INODE in the
@@ -583,6 +605,26 @@ grub_jfs_getent (struct grub_jfs_diropen *diro)
 }
 
 
+/* Find the run of blocks of the current inode containing FILEBLOCK.
+   Blocks not described by the extent tree are sparse.  */
+static grub_err_t
+grub_jfs_read_extent (grub_fshelp_node_t node, grub_disk_addr_t fileblock,
+		      struct grub_fshelp_extent *extent)
+{
+  struct grub_jfs_data *data = (struct grub_jfs_data *) node;
+
+  if (getextent (&data->currinode.file.tree, &data->currinode.file.extents[0],
+		 data, fileblock, extent))
+    return GRUB_ERR_NONE;
+  if (grub_errno)
+    return grub_errno;
+
+  extent->logical = fileblock;
+  extent->physical = 0;
+  extent->length = 1;
+  return GRUB_ERR_NONE;
+}
+
 /* Read LEN bytes from the file described by DATA starting with byte
    POS.  Return the amount of read bytes in READ.  */
 static grub_ssize_t
@@ -590,55 +632,12 @@ grub_jfs_read_file (struct grub_jfs_data *data,
 		    grub_disk_read_hook_t read_hook, void *read_hook_data,
 		    grub_off_t pos, grub_size_t len, char *buf)
 {
-  grub_off_t i;
-  grub_off_t blockcnt;
-
-  blockcnt = (len + pos + grub_le_to_cpu32 (data->sblock.blksz) - 1)
-    >> grub_le_to_cpu16 (data->sblock.log2_blksz);
-
-  for (i = pos >> grub_le_to_cpu16 (data->sblock.log2_blksz); i < blockcnt; i++)
-    {
-      grub_disk_addr_t blknr;
-      grub_uint32_t blockoff = pos & (grub_le_to_cpu32 (data->sblock.blksz) - 1);
-      grub_uint32_t blockend = grub_le_to_cpu32 (data->sblock.blksz);
-
-      grub_uint64_t skipfirst = 0;
-
-      blknr = grub_jfs_blkno (data, &data->currinode, i);
-      if (grub_errno)
-	return -1;
-
-      /* Last block.  */
-      if (i == blockcnt - 1)
-	{
-	  blockend = (len + pos) & (grub_le_to_cpu32 (data->sblock.blksz) - 1);
-
-	  if (!blockend)
-	    blockend = grub_le_to_cpu32 (data->sblock.blksz);
-	}
-
-      /* First block.  */
-      if (i == (pos >> grub_le_to_cpu16 (data->sblock.log2_blksz)))
-	{
-	  skipfirst = blockoff;
-	  blockend -= skipfirst;
-	}
-
-      data->disk->read_hook = read_hook;
-      data->disk->read_hook_data = read_hook_data;
-      grub_disk_read (data->disk,
-		      blknr << (grub_le_to_cpu16 (data->sblock.log2_blksz)
-				- GRUB_DISK_SECTOR_BITS),
-		      skipfirst, blockend, buf);
-
-      data->disk->read_hook = 0;
-      if (grub_errno)
-	return -1;
-
-      buf += grub_le_to_cpu32 (data->sblock.blksz) - skipfirst;
-    }
-
-  return len;
+  return grub_fshelp_read_file_extents (data->disk, (grub_fshelp_node_t) data,
+					read_hook, read_hook_data,
+					pos, len, buf, grub_jfs_read_extent,
+					grub_le_to_cpu64 (data->currinode.size),
+					grub_le_to_cpu16 (data->sblock.log2_blksz)
+					- GRUB_DISK_SECTOR_BITS, 0);
 }
 
 
@@ -22,6 +22,7 @@
 #include <grub/mm.h>
 #include <grub/misc.h>
 #include <grub/disk.h>
+#include <grub/partition.h>
 #include <grub/dl.h>
 #include <grub/types.h>
 #include <grub/fshelp.h>
@@ -189,6 +190,9 @@ enum
 #define SQUASH_CHUNK_SIZE 0x2000
 #define XZBUFSIZ 0x2000
 
+/* Number of decompressed metadata, fragment and data blocks kept.  */
+#define SQUASH_CACHE_SIZE 8
+
 struct grub_squash_data
 {
   grub_disk_t disk;
@@ -216,6 +220,109 @@ struct grub_fshelp_node
   } stack[1];
 };
 
+struct grub_squash_cache_block
+{
+  unsigned long dev_id;
+  unsigned long disk_id;
+  /* Byte address of the compressed block on the whole disk.  */
+  grub_uint64_t addr;
+  grub_size_t size;
+  char *buf;
+  grub_uint64_t last_used;
+};
+
+/* Every open mounts the filesystem afresh, so the cache lives here rather
+   than in grub_squash_data: small files packed into one fragment, and
+   the inode and directory tables, are only worth caching across files.
+   It is flushed along with the disk cache, so it does not outlive a media
+   change and gives its memory back when the heap runs out.  */
+static struct grub_squash_cache_block squash_cache[SQUASH_CACHE_SIZE];
+static grub_uint64_t squash_cache_clock;
+
+static void
+squash_cache_flush (void)
+{
+  unsigned i;
+
+  for (i = 0; i < SQUASH_CACHE_SIZE; i++)
+    {
+      grub_free (squash_cache[i].buf);
+      squash_cache[i].buf = NULL;
+    }
+}
+
+static struct grub_disk_cache_hook squash_cache_hook =
+  {
+    .flush = squash_cache_flush
+  };
+
+/* Return the contents of the compressed block of CSIZE bytes at ADDR,
+   which decompresses to at most MAXSIZE bytes, and store its real size
+   in *SIZE.  The buffer belongs to the cache.  */
+static const char *
+read_cached_block (struct grub_squash_data *data, grub_uint64_t addr,
+		   grub_size_t csize, grub_size_t maxsize, grub_size_t *size)
+{
+  struct grub_squash_cache_block *e, *victim = NULL;
+  grub_uint64_t abs_addr;
+  grub_ssize_t res;
+  char *in, *out;
+  unsigned i;
+
+  abs_addr = (grub_partition_get_start (data->disk->partition)
+	      << GRUB_DISK_SECTOR_BITS) + addr;
+
+  for (i = 0; i < SQUASH_CACHE_SIZE; i++)
+    {
+      e = &squash_cache[i];
+      if (e->buf && e->addr == abs_addr && e->disk_id == data->disk->id
+	  && e->dev_id == data->disk->dev->id)
+	{
+	  e->last_used = ++squash_cache_clock;
+	  *size = e->size;
+	  return e->buf;
+	}
+      if (!victim
+	  || (victim->buf && (!e->buf || e->last_used < victim->last_used)))
+	victim = e;
+    }
+
+  in = grub_malloc (csize);
+  if (!in)
+    return NULL;
+  out = grub_malloc (maxsize);
+  if (!out)
+    {
+      grub_free (in);
+      return NULL;
+    }
+  if (grub_disk_read (data->disk, addr >> GRUB_DISK_SECTOR_BITS,
+		      addr & (GRUB_DISK_SECTOR_SIZE - 1), csize, in))
+    {
+      grub_free (in);
+      grub_free (out);
+      return NULL;
+    }
+  res = data->decompress (in, csize, 0, out, maxsize, data);
+  grub_free (in);
+  if (res < 0)
+    {
+      grub_free (out);
+      return NULL;
+    }
+
+  grub_free (victim->buf);
+  victim->dev_id = data->disk->dev->id;
+  victim->disk_id = data->disk->id;
+  victim->addr = abs_addr;
+  victim->size = res;
+  victim->buf = out;
+  victim->last_used = ++squash_cache_clock;
+
+  *size = res;
+  return out;
+}
+
 static grub_err_t
 read_chunk (struct grub_squash_data *data, void *buf, grub_size_t len,
 	    grub_uint64_t chunk_start, grub_off_t offset)
@@ -254,29 +361,17 @@ read_chunk (struct grub_squash_data *data, void *buf, grub_size_t len,
 	}
       else
 	{
-	  char *tmp;
+	  const char *block;
 	  grub_size_t bsize = grub_le_to_cpu16 (d) & ~SQUASH_CHUNK_FLAGS; 
-	  grub_disk_addr_t a = chunk_start + 2;
-	  tmp = grub_malloc (bsize);
-	  if (!tmp)
-	    return grub_errno;
-	  /* FIXME: buffer uncompressed data.  */
-	  err = grub_disk_read (data->disk, (a >> GRUB_DISK_SECTOR_BITS),
-				a & (GRUB_DISK_SECTOR_SIZE - 1),
-				bsize, tmp);
-	  if (err)
-	    {
-	      grub_free (tmp);
-	      return err;
-	    }
+	  grub_size_t usize;
 
-	  if (data->decompress (tmp, bsize, offset,
-				buf, csize, data) < 0)
-	    {
-	      grub_free (tmp);
-	      return grub_errno;
-	    }
-	  grub_free (tmp);
+	  block = read_cached_block (data, chunk_start + 2, bsize,
+				     SQUASH_CHUNK_SIZE, &usize);
+	  if (!block)
+	    return grub_errno;
+	  if (offset + csize > usize)
+	    return grub_error (GRUB_ERR_BAD_FS, "incorrect compressed chunk");
+	  grub_memcpy (buf, block + offset, csize);
 	}
       len -= csize;
       offset += csize;
@@ -314,6 +409,10 @@ lzo_decompress (char *inbuf, grub_size_t insize, grub_off_t off,
       grub_free (udata);
       return -1;
     }
+  if (off > usize)
+    off = usize;
+  if (len > usize - off)
+    len = usize - off;
   grub_memcpy (outbuf, udata + off, len);
   grub_free (udata);
   return len;
@@ -746,7 +845,7 @@ direct_read (struct grub_squash_data *data,
 	     struct grub_squash_cache_inode *ino,
 	     grub_off_t off, char *buf, grub_size_t len)
 {
-  grub_err_t err;
+  grub_err_t err = GRUB_ERR_NONE;
   grub_off_t cumulated_uncompressed_size = 0;
   grub_uint64_t a = 0;
   grub_size_t i;
@@ -828,6 +927,26 @@ direct_read (struct grub_squash_data *data,
 	  /* Sparse block */
 	  grub_memset (buf, '\0', curread);
 	}
+      else if (!(ino->block_sizes[i]
+	    & grub_cpu_to_le32_compile_time (SQUASH_BLOCK_UNCOMPRESSED))
+	       && curread < data->blksz)
+	{
+	  /* Partial block: keep it around for the next read.  */
+	  const char *block;
+	  grub_size_t csize, usize;
+
+	  csize = grub_le_to_cpu32 (ino->block_sizes[i]) & ~SQUASH_BLOCK_FLAGS;
+	  block = read_cached_block (data, ino->cumulated_block_sizes[i] + a,
+				     csize, data->blksz, &usize);
+	  if (!block)
+	    return -1;
+	  if (boff + curread > usize)
+	    {
+	      grub_error (GRUB_ERR_BAD_FS, "incorrect compressed chunk");
+	      return -1;
+	    }
+	  grub_memcpy (buf, block + boff, curread);
+	}
       else if (!(ino->block_sizes[i]
 	    & grub_cpu_to_le32_compile_time (SQUASH_BLOCK_UNCOMPRESSED)))
 	{
@@ -935,32 +1054,21 @@ grub_squash_read (grub_file_t file, char *buf, grub_size_t len)
   else
     b = grub_le_to_cpu32 (ino->ino.file.offset) + off;
   
-  /* FIXME: cache uncompressed chunks.  */
   if (compressed)
     {
-      char *block;
-      block = grub_malloc (grub_le_to_cpu32 (frag.size));
+      const char *block;
+      grub_size_t usize;
+
+      block = read_cached_block (data, a, grub_le_to_cpu32 (frag.size),
+				 data->blksz, &usize);
       if (!block)
 	return -1;
-      err = grub_disk_read (data->disk,
-			    a >> GRUB_DISK_SECTOR_BITS,
-			    a & (GRUB_DISK_SECTOR_SIZE - 1),
-			    grub_le_to_cpu32 (frag.size), block);
-      if (err)
-	{
-	  grub_free (block);
-	  return -1;
-	}
-      if (data->decompress (block, grub_le_to_cpu32 (frag.size),
-			    b, buf, len, data)
-	  != (grub_ssize_t) len)
+      if (b + len > usize)
 	{
-	  grub_free (block);
-	  if (!grub_errno)
-	    grub_error (GRUB_ERR_BAD_FS, "incorrect compressed chunk");
+	  grub_error (GRUB_ERR_BAD_FS, "incorrect compressed chunk");
 	  return -1;
 	}
-      grub_free (block);
+      grub_memcpy (buf, block + b, len);
     }
   else
     {
@@ -1010,10 +1118,13 @@ static struct grub_fs grub_squash_fs =
 GRUB_MOD_INIT(squash4)
 {
   grub_fs_register (&grub_squash_fs);
+  grub_disk_cache_register_hook (&squash_cache_hook);
 }
 
 GRUB_MOD_FINI(squash4)
 {
+  grub_disk_cache_unregister_hook (&squash_cache_hook);
   grub_fs_unregister (&grub_squash_fs);
+  squash_cache_flush ();
 }
 
@@ -500,13 +500,19 @@ get_fsb (const void *keys, int idx)
   return grub_be_to_cpu64 (grub_get_unaligned64 (p));
 }
 
-static grub_disk_addr_t
-grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
+/* Find the run of blocks containing FILEBLOCK.  */
+static grub_err_t
+grub_xfs_read_extent (grub_fshelp_node_t node, grub_disk_addr_t fileblock,
+		      struct grub_fshelp_extent *extent)
 {
   struct grub_xfs_btree_node *leaf = 0;
   int ex, nrec;
   struct grub_xfs_extent *exts;
-  grub_uint64_t ret = 0;
+
+  /* Until an extent is found, the block is sparse.  */
+  extent->logical = fileblock;
+  extent->physical = 0;
+  extent->length = 1;
 
   if (node->inode.format == XFS_INODE_FORMAT_BTREE)
     {
@@ -516,7 +522,7 @@ grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
 
       leaf = grub_malloc (node->data->bsize);
       if (leaf == 0)
-        return 0;
+        return grub_errno;
 
       root = (struct grub_xfs_btree_root *) grub_xfs_inode_data(&node->inode);
       nrec = grub_be_to_cpu16 (root->numrecs);
@@ -541,13 +547,16 @@ grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
           if (i == 0)
             {
               grub_free (leaf);
-              return 0;
+              return GRUB_ERR_NONE;
             }
 
           if (grub_disk_read (node->data->disk,
                               GRUB_XFS_FSB_TO_BLOCK (node->data, get_fsb (keys, i - 1 + recoffset)) << (node->data->sblock.log2_bsize - GRUB_DISK_SECTOR_BITS),
                               0, node->data->bsize, leaf))
-            return 0;
+            {
+              grub_free (leaf);
+              return grub_errno;
+            }
 
 	  if ((!node->data->hascrc &&
 	       grub_strncmp ((char *) leaf->magic, "BMAP", 4)) ||
@@ -555,8 +564,7 @@ grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
 	       grub_strncmp ((char *) leaf->magic, "BMA3", 4)))
             {
               grub_free (leaf);
-              grub_error (GRUB_ERR_BAD_FS, "not a correct XFS BMAP node");
-              return 0;
+              return grub_error (GRUB_ERR_BAD_FS, "not a correct XFS BMAP node");
             }
 
           nrec = grub_be_to_cpu16 (leaf->numrecs);
@@ -575,10 +583,9 @@ grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
     }
   else
     {
-      grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
-		  "XFS does not support inode format %d yet",
-		  node->inode.format);
-      return 0;
+      return grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
+			 "XFS does not support inode format %d yet",
+			 node->inode.format);
     }
 
   /* Iterate over each extent to figure out which extent has
@@ -589,19 +596,26 @@ grub_xfs_read_block (grub_fshelp_node_t node, grub_disk_addr_t fileblock)
       grub_uint64_t offset = GRUB_XFS_EXTENT_OFFSET (exts, ex);
       grub_uint64_t size = GRUB_XFS_EXTENT_SIZE (exts, ex);
 
-      /* Sparse block.  */
+      /* Sparse block, up to the start of this extent.  */
       if (fileblock < offset)
-        break;
+        {
+          extent->length = offset - fileblock;
+          break;
+        }
       else if (fileblock < offset + size)
         {
-          ret = (fileblock - offset + start);
+          /* An extent never crosses an allocation group boundary, so
+             it is contiguous on disk as well.  */
+          extent->logical = offset;
+          extent->physical = GRUB_XFS_FSB_TO_BLOCK (node->data, start);
+          extent->length = size;
           break;
         }
     }
 
   grub_free (leaf);
 
-  return GRUB_XFS_FSB_TO_BLOCK(node->data, ret);
+  return GRUB_ERR_NONE;
 }
 
 
@@ -612,12 +626,12 @@ grub_xfs_read_file (grub_fshelp_node_t node,
 		    grub_disk_read_hook_t read_hook, void *read_hook_data,
 		    grub_off_t pos, grub_size_t len, char *buf, grub_uint32_t header_size)
 {
-  return grub_fshelp_read_file (node->data->disk, node,
-				read_hook, read_hook_data,
-				pos, len, buf, grub_xfs_read_block,
-				grub_be_to_cpu64 (node->inode.size) + header_size,
-				node->data->sblock.log2_bsize
-				- GRUB_DISK_SECTOR_BITS, 0);
+  return grub_fshelp_read_file_extents (node->data->disk, node,
+					read_hook, read_hook_data,
+					pos, len, buf, grub_xfs_read_extent,
+					grub_be_to_cpu64 (node->inode.size) + header_size,
+					node->data->sblock.log2_bsize
+					- GRUB_DISK_SECTOR_BITS, 0);
 }
 
 
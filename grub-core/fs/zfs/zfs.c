@@ -53,6 +53,7 @@
 #include <grub/zfs/dsl_dir.h>
 #include <grub/zfs/dsl_dataset.h>
 #include <grub/deflate.h>
+#include <grub/zstd.h>
 #include <grub/crypto.h>
 #include <grub/i18n.h>
 
@@ -227,6 +228,20 @@ struct subvolume
   } *keyring;
 };
 
+/* Number of decoded indirect blocks kept per mount.  A sequential read
+   needs one per level of the block tree, the rest absorb dnode lookups in
+   the MOS and the dataset's object set.  */
+#define ZFS_IND_CACHE_SIZE 8
+
+struct zfs_ind_cache_entry
+{
+  /* Key: the first DVA and the birth txg, as stored on disk.  */
+  dva_t dva;
+  grub_uint64_t birth;
+  void *buf;
+  grub_uint64_t last_used;
+};
+
 struct grub_zfs_data
 {
   /* cache for a file block of the currently zfs_open()-ed file */
@@ -234,6 +249,10 @@ struct grub_zfs_data
   grub_uint64_t file_start;
   grub_uint64_t file_end;
 
+  /* cache for decoded indirect blocks, see zio_read_indirect */
+  struct zfs_ind_cache_entry ind_cache[ZFS_IND_CACHE_SIZE];
+  grub_uint64_t ind_cache_clock;
+
   /* cache for a dnode block */
   dnode_phys_t *dnode_buf;
   dnode_phys_t *dnode_mdn;
@@ -285,6 +304,7 @@ static const char *spa_feature_names[] = {
   "com.delphix:embedded_data",
   "com.delphix:extensible_dataset",
   "org.open-zfs:large_blocks",
+  "org.freebsd:zstd_compress",
   NULL
 };
 
@@ -306,6 +326,32 @@ zlib_decompress (void *s, void *d,
   return grub_errno;
 }
 
+/* OpenZFS prefixes the zstd frame with its big-endian length and the
+   version and level of the compressor.  */
+static grub_err_t
+zstd_decompress (void *s, void *d,
+		 grub_size_t slen, grub_size_t dlen)
+{
+  grub_uint32_t c_len;
+
+  if (slen < 8)
+    return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		       "zstd block too short");
+  c_len = grub_be_to_cpu32 (grub_get_unaligned32 (s));
+  if (c_len > slen - 8)
+    return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		       "zstd block length is out of range");
+
+  if (grub_zstd_decompress ((grub_uint8_t *) s + 8, c_len, 0, d, dlen)
+      == (grub_ssize_t) dlen)
+    return GRUB_ERR_NONE;
+
+  if (!grub_errno)
+    grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		"premature end of compressed");
+  return grub_errno;
+}
+
 static grub_err_t 
 zle_decompress (void *s, void *d,
 		grub_size_t slen, grub_size_t dlen)
@@ -356,6 +402,7 @@ static decomp_entry_t decomp_table[ZIO_COMPRESS_FUNCTIONS] = {
   {"gzip-9", zlib_decompress},  /* ZIO_COMPRESS_GZIP9 */
   {"zle", zle_decompress},      /* ZIO_COMPRESS_ZLE   */
   {"lz4", lz4_decompress},      /* ZIO_COMPRESS_LZ4   */
+  {"zstd", zstd_decompress},    /* ZIO_COMPRESS_ZSTD  */
 };
 
 static grub_err_t zio_read_data (blkptr_t * bp, grub_zfs_endian_t endian,
@@ -1279,6 +1326,37 @@ static grub_uint8_t powx[255 * 2];
 static int powx_inv[256];
 static const grub_uint8_t poly = 0x1d;
 
+/* A *= C, with the raid6rec kernels when that module is loaded.  */
+static void
+zfs_gf_mul (grub_uint8_t *a, grub_uint8_t c, grub_size_t s)
+{
+  if (grub_raid6_gf_mul_func)
+    {
+      grub_raid6_gf_mul_func (a, c, s);
+      return;
+    }
+  for (; s--; a++)
+    if (*a)
+      *a = c ? powx[powx_inv[*a] + powx_inv[c]] : 0;
+}
+
+/* A ^= B * C, likewise.  */
+static void
+zfs_gf_mul_xor (grub_uint8_t *a, const grub_uint8_t *b, grub_uint8_t c,
+		grub_size_t s)
+{
+  if (grub_raid6_gf_mul_xor_func)
+    {
+      grub_raid6_gf_mul_xor_func (a, b, c, s);
+      return;
+    }
+  if (!c)
+    return;
+  for (; s--; b++, a++)
+    if (*b)
+      *a ^= powx[powx_inv[*b] + powx_inv[c]];
+}
+
 /* perform the operation a ^= b * (x ** (known_idx * recovery_pow) ) */
 static inline void
 xor_out (grub_uint8_t *a, const grub_uint8_t *b, grub_size_t s,
@@ -1293,9 +1371,7 @@ xor_out (grub_uint8_t *a, const grub_uint8_t *b, grub_size_t s,
       return;
     }
   add = (known_idx * recovery_pow) % 255;
-  for (;s--; b++, a++)
-    if (*b)
-      *a ^= powx[powx_inv[*b] + add];
+  zfs_gf_mul_xor (a, b, powx[add], s);
 }
 
 static inline grub_uint8_t
@@ -1323,13 +1399,10 @@ recovery (grub_uint8_t *bufs[4], grub_size_t s, const int nbufs,
     case 1:
       {
 	int add;
-	grub_uint8_t *a;
 	if (powers[0] == 0 || idx[0] == 0)
 	  return GRUB_ERR_NONE;
 	add = 255 - ((powers[0] * idx[0]) % 255);
-	for (a = bufs[0]; s--; a++)
-	  if (*a)
-	    *a = powx[powx_inv[*a] + add];
+	zfs_gf_mul (bufs[0], powx[add], s);
 	return GRUB_ERR_NONE;
       }
       /* Case 2x2: Let's use the determinant formula.  */
@@ -1337,7 +1410,7 @@ recovery (grub_uint8_t *bufs[4], grub_size_t s, const int nbufs,
       {
 	grub_uint8_t det, det_inv;
 	grub_uint8_t matrixinv[2][2];
-	unsigned i;
+	grub_uint8_t *b0;
 	/* The determinant is: */
 	det = (powx[(powers[0] * idx[0] + powers[1] * idx[1]) % 255]
 	       ^ powx[(powers[0] * idx[1] + powers[1] * idx[0]) % 255]);
@@ -1348,23 +1421,22 @@ recovery (grub_uint8_t *bufs[4], grub_size_t s, const int nbufs,
 	matrixinv[1][1] = gf_mul (powx[(powers[0] * idx[0]) % 255], det_inv);
 	matrixinv[0][1] = gf_mul (powx[(powers[0] * idx[1]) % 255], det_inv);
 	matrixinv[1][0] = gf_mul (powx[(powers[1] * idx[0]) % 255], det_inv);
-	for (i = 0; i < s; i++)
-	  {
-	    grub_uint8_t b0, b1;
-	    b0 = bufs[0][i];
-	    b1 = bufs[1][i];
-
-	    bufs[0][i] = (gf_mul (b0, matrixinv[0][0])
-			  ^ gf_mul (b1, matrixinv[0][1]));
-	    bufs[1][i] = (gf_mul (b0, matrixinv[1][0])
-			  ^ gf_mul (b1, matrixinv[1][1]));
-	  }
+	b0 = grub_malloc (s);
+	if (!b0)
+	  return grub_errno;
+	grub_memcpy (b0, bufs[0], s);
+	zfs_gf_mul (bufs[0], matrixinv[0][0], s);
+	zfs_gf_mul_xor (bufs[0], bufs[1], matrixinv[0][1], s);
+	zfs_gf_mul (bufs[1], matrixinv[1][1], s);
+	zfs_gf_mul_xor (bufs[1], b0, matrixinv[1][0], s);
+	grub_free (b0);
 	return GRUB_ERR_NONE;
       }
       /* Otherwise use Gauss.  */
     case 3:
       {
 	grub_uint8_t matrix1[MAX_NBUFS][MAX_NBUFS], matrix2[MAX_NBUFS][MAX_NBUFS];
+	grub_uint8_t *b;
 	int i, j, k;
 
 	for (i = 0; i < nbufs; i++)
@@ -1430,18 +1502,18 @@ recovery (grub_uint8_t *bufs[4], grub_size_t s, const int nbufs,
 	      }
 	  }
 
-	for (i = 0; i < (int) s; i++)
+	b = grub_malloc (nbufs * s);
+	if (!b)
+	  return grub_errno;
+	for (j = 0; j < nbufs; j++)
+	  grub_memcpy (b + j * s, bufs[j], s);
+	for (j = 0; j < nbufs; j++)
 	  {
-	    grub_uint8_t b[MAX_NBUFS];
-	    for (j = 0; j < nbufs; j++)
-	      b[j] = bufs[j][i];
-	    for (j = 0; j < nbufs; j++)
-	      {
-		bufs[j][i] = 0;
-		for (k = 0; k < nbufs; k++)
-		  bufs[j][i] ^= gf_mul (matrix2[j][k], b[k]);
-	      }
+	    grub_memset (bufs[j], 0, s);
+	    for (k = 0; k < nbufs; k++)
+	      zfs_gf_mul_xor (bufs[j], b + k * s, matrix2[j][k], s);
 	  }
+	grub_free (b);
 	return GRUB_ERR_NONE;
       }
     default:
@@ -1995,6 +2067,57 @@ zio_read (blkptr_t *bp, grub_zfs_endian_t endian, void **buf,
   return GRUB_ERR_NONE;
 }
 
+/*
+ * Read an indirect block through the per-mount cache.  Blocks are never
+ * rewritten in place, so the DVA and birth txg identify the contents.  If
+ * *OWNED is set on return the caller must free *BUF, otherwise it belongs
+ * to the cache and stays valid until the next call.
+ */
+static grub_err_t
+zio_read_indirect (blkptr_t *bp, grub_zfs_endian_t endian, void **buf,
+		   int *owned, struct grub_zfs_data *data)
+{
+  struct zfs_ind_cache_entry *e, *victim = NULL;
+  grub_err_t err;
+  unsigned i;
+
+  *owned = 0;
+
+  /* Embedded block pointers have no address to key on.  */
+  if (BP_IS_EMBEDDED (bp))
+    {
+      *owned = 1;
+      return zio_read (bp, endian, buf, 0, data);
+    }
+
+  for (i = 0; i < ZFS_IND_CACHE_SIZE; i++)
+    {
+      e = &data->ind_cache[i];
+      if (e->buf && e->birth == bp->blk_birth
+	  && e->dva.dva_word[0] == bp->blk_dva[0].dva_word[0]
+	  && e->dva.dva_word[1] == bp->blk_dva[0].dva_word[1])
+	{
+	  e->last_used = ++data->ind_cache_clock;
+	  *buf = e->buf;
+	  return GRUB_ERR_NONE;
+	}
+      if (!victim || !e->buf
+	  || (victim->buf && e->last_used < victim->last_used))
+	victim = e;
+    }
+
+  err = zio_read (bp, endian, buf, 0, data);
+  if (err)
+    return err;
+
+  grub_free (victim->buf);
+  victim->dva = bp->blk_dva[0];
+  victim->birth = bp->blk_birth;
+  victim->buf = *buf;
+  victim->last_used = ++data->ind_cache_clock;
+  return GRUB_ERR_NONE;
+}
+
 /*
  * Get the block from a block id.
  * push the block onto the stack.
@@ -2010,6 +2133,8 @@ dmu_read (dnode_end_t * dn, grub_uint64_t blkid, void **buf,
   int epbs = dn->dn.dn_indblkshift - SPA_BLKPTRSHIFT;
   blkptr_t *bp;
   void *tmpbuf = 0;
+  /* Whether bp_array must be freed here.  */
+  int owned = 0;
   grub_zfs_endian_t endian;
   grub_err_t err = GRUB_ERR_NONE;
 
@@ -2023,11 +2148,10 @@ dmu_read (dnode_end_t * dn, grub_uint64_t blkid, void **buf,
       grub_dprintf ("zfs", "endian = %d\n", endian);
       idx = (blkid >> (epbs * level)) & ((1 << epbs) - 1);
       *bp = bp_array[idx];
-      if (bp_array != dn->dn.dn_blkptr)
-	{
-	  grub_free (bp_array);
-	  bp_array = 0;
-	}
+      if (owned)
+	grub_free (bp_array);
+      bp_array = 0;
+      owned = 0;
 
       if (BP_IS_HOLE (bp))
 	{
@@ -2052,13 +2176,13 @@ dmu_read (dnode_end_t * dn, grub_uint64_t blkid, void **buf,
 	  break;
 	}
       grub_dprintf ("zfs", "endian = %d\n", endian);
-      err = zio_read (bp, endian, &tmpbuf, 0, data);
+      err = zio_read_indirect (bp, endian, &tmpbuf, &owned, data);
       endian = (grub_zfs_to_cpu64 (bp->blk_prop, endian) >> 63) & 1;
       if (err)
 	break;
       bp_array = tmpbuf;
     }
-  if (bp_array != dn->dn.dn_blkptr)
+  if (owned)
     grub_free (bp_array);
   if (endian_out)
     *endian_out = endian;
@@ -2067,6 +2191,179 @@ dmu_read (dnode_end_t * dn, grub_uint64_t blkid, void **buf,
   return err;
 }
 
+/* Upper bound on the physical size of one batched read.  */
+#define ZFS_BATCH_MAX_BYTES (4 << 20)
+
+/*
+ * Read up to NBLKS data blocks of the open file starting at BLKID into
+ * BUF, as long as they are stored back to back on the same leaf or mirror
+ * vdev, with a single read_device call.  Uncompressed runs land directly
+ * in BUF; compressed ones are read into a bounce buffer and decompressed
+ * into BUF.  *DONE is set to the number of blocks read, which is 0 if the
+ * blocks at BLKID are not worth batching; the caller then falls back to
+ * dmu_read, which also copes with gang blocks, other DVAs and so on.
+ */
+static grub_err_t
+dmu_read_run (struct grub_zfs_data *data, grub_uint64_t blkid,
+	      grub_size_t nblks, grub_size_t blksz, char *buf,
+	      grub_size_t *done)
+{
+  dnode_end_t *dn = &data->dnode;
+  int epbs = dn->dn.dn_indblkshift - SPA_BLKPTRSHIFT;
+  blkptr_t *bp_array = dn->dn.dn_blkptr;
+  grub_zfs_endian_t endian = dn->endian;
+  struct grub_zfs_device_desc *desc = NULL;
+  grub_uint64_t offset0 = 0, physical = 0, vdev = 0;
+  grub_size_t idx0, nptrs, n, k;
+  int owned = 0, direct = 1, level;
+  char *rbuf = NULL;
+  grub_err_t err = GRUB_ERR_NONE;
+  unsigned i;
+
+  *done = 0;
+
+  /* Find the level-1 block pointer array.  */
+  for (level = dn->dn.dn_nlevels - 1; level > 0; level--)
+    {
+      blkptr_t bp;
+      void *tmpbuf;
+
+      bp = bp_array[(blkid >> (epbs * level)) & ((1 << epbs) - 1)];
+      if (owned)
+	grub_free (bp_array);
+      owned = 0;
+      if (BP_IS_HOLE (&bp))
+	return GRUB_ERR_NONE;
+      err = zio_read_indirect (&bp, endian, &tmpbuf, &owned, data);
+      if (err)
+	return err;
+      endian = (grub_zfs_to_cpu64 (bp.blk_prop, endian) >> 63) & 1;
+      bp_array = tmpbuf;
+    }
+
+  idx0 = blkid & ((1 << epbs) - 1);
+  nptrs = dn->dn.dn_nlevels == 1 ? dn->dn.dn_nblkptr : (1U << epbs);
+  if (idx0 >= nptrs)
+    goto out;
+  if (nblks > nptrs - idx0)
+    nblks = nptrs - idx0;
+
+  /* Collect the run.  */
+  for (n = 0; n < nblks; n++)
+    {
+      blkptr_t *bp = &bp_array[idx0 + n];
+      grub_uint64_t prop, asize, psize, comp;
+
+      if (BP_IS_HOLE (bp) || BP_IS_EMBEDDED (bp))
+	break;
+      prop = grub_zfs_to_cpu64 (bp->blk_prop, endian);
+      comp = (prop >> 32) & 0x7f;
+      psize = get_psize (bp, endian);
+      asize = (grub_zfs_to_cpu64 (bp->blk_dva[0].dva_word[0], endian)
+	       & 0xffffff) << SPA_MINBLOCKSHIFT;
+      if (((prop >> 60) & 3)
+	  || ((grub_zfs_to_cpu64 (bp->blk_dva[0].dva_word[1], endian)
+	       >> 63) & 1)
+	  || (((prop & 0xffff) + 1) << SPA_MINBLOCKSHIFT) != blksz
+	  || comp >= ZIO_COMPRESS_FUNCTIONS
+	  || (comp != ZIO_COMPRESS_OFF
+	      && decomp_table[comp].decomp_func == NULL)
+	  || asize < psize)
+	break;
+
+      if (n == 0)
+	{
+	  vdev = DVA_GET_VDEV (&bp->blk_dva[0]);
+	  offset0 = dva_get_offset (&bp->blk_dva[0], endian);
+	  for (i = 0; i < data->n_devices_attached; i++)
+	    if (data->devices_attached[i].id == vdev)
+	      {
+		desc = &data->devices_attached[i];
+		break;
+	      }
+	  /* RAID-Z stripes every block separately.  */
+	  if (!desc || desc->type == DEVICE_RAIDZ)
+	    break;
+	}
+      else if (DVA_GET_VDEV (&bp->blk_dva[0]) != vdev
+	       || dva_get_offset (&bp->blk_dva[0], endian)
+	       != offset0 + physical
+	       || physical + asize > ZFS_BATCH_MAX_BYTES)
+	break;
+
+      if (comp != ZIO_COMPRESS_OFF || psize != blksz || asize != psize)
+	direct = 0;
+      physical += asize;
+    }
+
+  if (n < 2)
+    goto out;
+
+  grub_dprintf ("zfs", "batched read of %" PRIuGRUB_SIZE " blocks, %"
+		PRIuGRUB_UINT64_T " bytes%s\n", n, physical,
+		direct ? "" : " (bounced)");
+
+  if (direct)
+    rbuf = buf;
+  else
+    {
+      rbuf = grub_malloc (physical);
+      if (!rbuf)
+	{
+	  err = grub_errno;
+	  goto out;
+	}
+    }
+
+  if (read_device (offset0, desc, physical, rbuf))
+    {
+      /* Let the block-by-block path retry with the other DVAs.  */
+      grub_errno = GRUB_ERR_NONE;
+      goto out;
+    }
+
+  for (k = 0, physical = 0; k < n; k++)
+    {
+      blkptr_t *bp = &bp_array[idx0 + k];
+      grub_uint64_t prop = grub_zfs_to_cpu64 (bp->blk_prop, endian);
+      grub_uint64_t comp = (prop >> 32) & 0x7f;
+      grub_size_t psize = get_psize (bp, endian);
+      char *src = rbuf + physical;
+
+      physical += (grub_zfs_to_cpu64 (bp->blk_dva[0].dva_word[0], endian)
+		   & 0xffffff) << SPA_MINBLOCKSHIFT;
+
+      if (zio_checksum_verify (bp->blk_cksum, (prop >> 40) & 0xff, endian,
+			       src, psize))
+	{
+	  /* Stop here; dmu_read will try the other copies.  */
+	  grub_dprintf ("zfs", "incorrect checksum in batched read\n");
+	  grub_errno = GRUB_ERR_NONE;
+	  break;
+	}
+
+      if (comp != ZIO_COMPRESS_OFF)
+	{
+	  if (decomp_table[comp].decomp_func (src, buf + k * blksz,
+					      psize, blksz))
+	    {
+	      grub_errno = GRUB_ERR_NONE;
+	      break;
+	    }
+	}
+      else if (!direct)
+	grub_memcpy (buf + k * blksz, src, blksz);
+    }
+  *done = k;
+
+ out:
+  if (rbuf != buf)
+    grub_free (rbuf);
+  if (owned)
+    grub_free (bp_array);
+  return err;
+}
+
 /*
  * mzap_lookup: Looks up property described by "name" and returns the value
  * in "value".
@@ -3597,6 +3894,8 @@ zfs_unmount (struct grub_zfs_data *data)
   grub_free (data->dnode_buf);
   grub_free (data->dnode_mdn);
   grub_free (data->file_buf);
+  for (i = 0; i < ZFS_IND_CACHE_SIZE; i++)
+    grub_free (data->ind_cache[i].buf);
   for (i = 0; i < data->subvol.nkeys; i++)
     grub_crypto_cipher_close (data->subvol.keyring[i].cipher);
   grub_free (data->subvol.keyring);
@@ -3881,19 +4180,38 @@ grub_zfs_read (grub_file_t file, char *buf, grub_size_t len)
 
   /*
    * Entire Dnode is too big to fit into the space available.  We
-   * will need to read it in chunks.  This could be optimized to
-   * read in as large a chunk as there is space available, but for
-   * now, this only reads in one data block at a time.
+   * will need to read it in chunks.  Runs of whole blocks that are
+   * contiguous on disk go straight into the caller's buffer in one
+   * read; everything else is read one data block at a time through
+   * file_buf.
    */
   length = len;
   read = 0;
   while (length)
     {
       void *t;
+      grub_uint64_t rem;
       /*
        * Find requested blkid and the offset within that block.
        */
-      grub_uint64_t blkid = grub_divmod64 (file->offset + read, blksz, 0);
+      grub_uint64_t blkid = grub_divmod64 (file->offset + read, blksz, &rem);
+
+      if (rem == 0 && length >= 2 * blksz)
+	{
+	  grub_size_t done;
+
+	  err = dmu_read_run (data, blkid, length / blksz, blksz, buf, &done);
+	  if (err)
+	    return -1;
+	  if (done)
+	    {
+	      buf += done * blksz;
+	      length -= done * blksz;
+	      read += done * blksz;
+	      continue;
+	    }
+	}
+
       grub_free (data->file_buf);
       data->file_buf = 0;
 
@@ -25,28 +25,108 @@
 #include <grub/time.h>
 #include <grub/file.h>
 #include <grub/i18n.h>
+#include <grub/list.h>
 
 #define	GRUB_CACHE_TIMEOUT	2
 
 /* The last time the disk was used.  */
 static grub_uint64_t grub_last_time = 0;
 
-struct grub_disk_cache grub_disk_cache_table[GRUB_DISK_CACHE_NUM];
+struct grub_disk_cache *grub_disk_cache_table;
+unsigned grub_disk_cache_num_sets;
+
+/* The cached data of all entries, allocated along with the table.  */
+static char *grub_disk_cache_slab;
+static grub_size_t grub_disk_cache_size = GRUB_DISK_CACHE_DEFAULT_SIZE;
+static unsigned long grub_disk_cache_clock;
+/* Set when not even the smallest cache could be allocated, so that
+   stores don't keep trying until the heap may have changed.  */
+static int grub_disk_cache_alloc_failed;
+static struct grub_disk_cache_hook *grub_disk_cache_hooks;
 
 void (*grub_disk_firmware_fini) (void);
 int grub_disk_firmware_is_tainted;
 
-#if DISK_CACHE_STATS
-static unsigned long grub_disk_cache_hits;
-static unsigned long grub_disk_cache_misses;
+grub_err_t (*grub_raid5_recover_gen_func) (void *data, grub_uint64_t nstripes,
+					   int disknr, char *buf,
+					   grub_uint64_t addr, grub_size_t size,
+					   grub_raid_recover_read_t read_func);
+grub_err_t (*grub_raid6_recover_gen_func) (void *data, grub_uint64_t nstripes,
+					   int disknr, int p, char *buf,
+					   grub_uint64_t addr, grub_size_t size,
+					   int layout,
+					   grub_raid_recover_read_t read_func);
+void (*grub_raid6_gf_mul_func) (grub_uint8_t *buf, grub_uint8_t c,
+				grub_size_t size);
+void (*grub_raid6_gf_mul_xor_func) (grub_uint8_t *dst, const grub_uint8_t *src,
+				    grub_uint8_t c, grub_size_t size);
+
+struct grub_disk_stats *grub_disk_stats_list;
 
 void
 grub_disk_cache_get_performance (unsigned long *hits, unsigned long *misses)
 {
-  *hits = grub_disk_cache_hits;
-  *misses = grub_disk_cache_misses;
+  struct grub_disk_stats *stats;
+
+  *hits = 0;
+  *misses = 0;
+  for (stats = grub_disk_stats_list; stats; stats = stats->next)
+    {
+      *hits += stats->cache_hits;
+      *misses += stats->cache_misses;
+    }
+}
+
+/* Find or create the statistics of DISK.  Statistics are optional, so
+   failing to allocate them is not an error.  */
+static struct grub_disk_stats *
+grub_disk_stats_get (grub_disk_t disk)
+{
+  struct grub_disk_stats *stats;
+
+  for (stats = grub_disk_stats_list; stats; stats = stats->next)
+    if (stats->dev_id == disk->dev->id && stats->disk_id == disk->id)
+      return stats;
+
+  stats = grub_zalloc (sizeof (*stats));
+  if (stats)
+    stats->name = grub_strdup (disk->name);
+  if (! stats || ! stats->name)
+    {
+      grub_free (stats);
+      grub_errno = GRUB_ERR_NONE;
+      return 0;
+    }
+
+  stats->dev_id = disk->dev->id;
+  stats->disk_id = disk->id;
+  stats->next = grub_disk_stats_list;
+  grub_disk_stats_list = stats;
+
+  return stats;
+}
+
+/* Read SIZE sectors of the native sector size of DISK through its
+   driver and account for the time it takes.  */
+static grub_err_t
+grub_disk_read_dev (grub_disk_t disk, grub_disk_addr_t sector,
+		    grub_size_t size, char *buf)
+{
+  grub_uint64_t start;
+  grub_err_t err;
+
+  if (! disk->stats)
+    return (disk->dev->read) (disk, sector, size, buf);
+
+  start = grub_get_time_ms ();
+  err = (disk->dev->read) (disk, sector, size, buf);
+  disk->stats->read_time_ms += grub_get_time_ms () - start;
+  disk->stats->read_calls++;
+  if (! err)
+    disk->stats->bytes_read += (grub_uint64_t) size << disk->log_sector_size;
+
+  return err;
 }
-#endif
 
 grub_err_t (*grub_disk_write_weak) (grub_disk_t disk,
 				    grub_disk_addr_t sector,
@@ -56,45 +136,124 @@ grub_err_t (*grub_disk_write_weak) (grub_disk_t disk,
 #include "disk_common.c"
 
 void
-grub_disk_cache_invalidate_all (void)
+grub_disk_cache_register_hook (struct grub_disk_cache_hook *hook)
 {
+  grub_list_push (GRUB_AS_LIST_P (&grub_disk_cache_hooks), GRUB_AS_LIST (hook));
+}
+
+void
+grub_disk_cache_unregister_hook (struct grub_disk_cache_hook *hook)
+{
+  grub_list_remove (GRUB_AS_LIST (hook));
+}
+
+/* Drop every entry that is not in use.  Return nonzero if some entry
+   still is.  */
+static int
+grub_disk_cache_clear (void)
+{
+  struct grub_disk_cache_hook *hook;
   unsigned i;
+  int locked = 0;
 
-  for (i = 0; i < GRUB_DISK_CACHE_NUM; i++)
+  FOR_LIST_ELEMENTS (hook, grub_disk_cache_hooks)
+    hook->flush ();
+
+  for (i = 0; i < grub_disk_cache_num_sets * GRUB_DISK_CACHE_WAYS; i++)
     {
       struct grub_disk_cache *cache = grub_disk_cache_table + i;
 
-      if (cache->data && ! cache->lock)
+      if (cache->lock)
+	locked = 1;
+      else
+	cache->data = 0;
+    }
+
+  return locked;
+}
+
+void
+grub_disk_cache_invalidate_all (void)
+{
+  grub_disk_cache_clear ();
+  grub_disk_cache_alloc_failed = 0;
+}
+
+void
+grub_disk_cache_release (void)
+{
+  /* Give the memory back unless an entry is still in use.  It is
+     allocated again on the next store.  */
+  if (grub_disk_cache_clear ())
+    return;
+
+  grub_free (grub_disk_cache_slab);
+  grub_free (grub_disk_cache_table);
+  grub_disk_cache_slab = 0;
+  grub_disk_cache_table = 0;
+  grub_disk_cache_num_sets = 0;
+}
+
+void
+grub_disk_cache_set_size (grub_size_t size)
+{
+  grub_disk_cache_size = size;
+  grub_disk_cache_alloc_failed = 0;
+  grub_disk_cache_release ();
+}
+
+/* Allocate the cache table and slab.  If memory is tight, settle for a
+   smaller cache.  */
+static grub_err_t
+grub_disk_cache_alloc (void)
+{
+  grub_size_t entry_size = GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS;
+  grub_size_t sets;
+  struct grub_disk_cache *table;
+  char *slab;
+
+  for (sets = grub_disk_cache_size / (entry_size * GRUB_DISK_CACHE_WAYS);
+       sets; sets /= 2)
+    {
+      table = grub_zalloc (sets * GRUB_DISK_CACHE_WAYS * sizeof (*table));
+      if (! table)
+	continue;
+      slab = grub_malloc (sets * GRUB_DISK_CACHE_WAYS * entry_size);
+      if (slab)
 	{
-	  grub_free (cache->data);
-	  cache->data = 0;
+	  grub_disk_cache_table = table;
+	  grub_disk_cache_slab = slab;
+	  grub_disk_cache_num_sets = sets;
+	  /* Larger attempts may have failed on the way.  */
+	  grub_errno = GRUB_ERR_NONE;
+	  return GRUB_ERR_NONE;
 	}
+      grub_free (table);
     }
+
+  /* Running without a cache is not an error.  */
+  grub_errno = GRUB_ERR_NONE;
+  grub_disk_cache_alloc_failed = 1;
+  return GRUB_ERR_OUT_OF_MEMORY;
 }
 
 static char *
-grub_disk_cache_fetch (unsigned long dev_id, unsigned long disk_id,
-		       grub_disk_addr_t sector)
+grub_disk_cache_fetch (grub_disk_t disk, grub_disk_addr_t sector)
 {
   struct grub_disk_cache *cache;
-  unsigned cache_index;
 
-  cache_index = grub_disk_cache_get_index (dev_id, disk_id, sector);
-  cache = grub_disk_cache_table + cache_index;
-
-  if (cache->dev_id == dev_id && cache->disk_id == disk_id
-      && cache->sector == sector)
+  cache = grub_disk_cache_find (disk->dev->id, disk->id, sector);
+  if (cache)
     {
       cache->lock = 1;
-#if DISK_CACHE_STATS
-      grub_disk_cache_hits++;
-#endif
+      cache->last_use = ++grub_disk_cache_clock;
+      if (disk->stats)
+	disk->stats->cache_hits++;
       return cache->data;
     }
 
-#if DISK_CACHE_STATS
-  grub_disk_cache_misses++;
-#endif
+  if (disk->stats)
+    disk->stats->cache_misses++;
 
   return 0;
 }
@@ -104,13 +263,9 @@ grub_disk_cache_unlock (unsigned long dev_id, unsigned long disk_id,
 			grub_disk_addr_t sector)
 {
   struct grub_disk_cache *cache;
-  unsigned cache_index;
-
-  cache_index = grub_disk_cache_get_index (dev_id, disk_id, sector);
-  cache = grub_disk_cache_table + cache_index;
 
-  if (cache->dev_id == dev_id && cache->disk_id == disk_id
-      && cache->sector == sector)
+  cache = grub_disk_cache_find (dev_id, disk_id, sector);
+  if (cache)
     cache->lock = 0;
 }
 
@@ -118,31 +273,51 @@ static grub_err_t
 grub_disk_cache_store (unsigned long dev_id, unsigned long disk_id,
 		       grub_disk_addr_t sector, const char *data)
 {
-  unsigned cache_index;
-  struct grub_disk_cache *cache;
+  struct grub_disk_cache *set, *cache;
+  unsigned i;
 
-  cache_index = grub_disk_cache_get_index (dev_id, disk_id, sector);
-  cache = grub_disk_cache_table + cache_index;
+  if (! grub_disk_cache_table
+      && (grub_disk_cache_alloc_failed || grub_disk_cache_alloc ()))
+    return GRUB_ERR_NONE;
 
-  cache->lock = 1;
-  grub_free (cache->data);
-  cache->data = 0;
-  cache->lock = 0;
+  /* Replace the same sector if present, otherwise take a free entry
+     or evict the least recently used one.  */
+  cache = grub_disk_cache_find (dev_id, disk_id, sector);
+  if (! cache)
+    {
+      set = grub_disk_cache_table
+	+ grub_disk_cache_get_index (dev_id, disk_id, sector);
+      for (i = 0; i < GRUB_DISK_CACHE_WAYS; i++)
+	{
+	  if (set[i].lock)
+	    continue;
+	  if (! set[i].data)
+	    {
+	      cache = set + i;
+	      break;
+	    }
+	  if (! cache || set[i].last_use < cache->last_use)
+	    cache = set + i;
+	}
+    }
 
-  cache->data = grub_malloc (GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS);
-  if (! cache->data)
-    return grub_errno;
+  if (! cache || cache->lock)
+    return GRUB_ERR_NONE;
 
+  cache->data = grub_disk_cache_slab
+    + ((grub_size_t) (cache - grub_disk_cache_table)
+       << (GRUB_DISK_CACHE_BITS + GRUB_DISK_SECTOR_BITS));
   grub_memcpy (cache->data, data,
 	       GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS);
   cache->dev_id = dev_id;
   cache->disk_id = disk_id;
   cache->sector = sector;
+  cache->last_use = ++grub_disk_cache_clock;
 
   return GRUB_ERR_NONE;
 }
 
-
+
 
 grub_disk_dev_t grub_disk_dev_list;
 
@@ -247,6 +422,7 @@ grub_disk_open (const char *name)
     }
 
   disk->dev = dev;
+  disk->stats = grub_disk_stats_get (disk);
 
   if (p)
     {
@@ -310,6 +486,46 @@ grub_disk_close (grub_disk_t disk)
   grub_free (disk);
 }
 
+/* Return the number of cache units to read on a cache miss at SECTOR.
+   A miss right after the previous window means the disk is read
+   sequentially, so the window is doubled up to the largest read the
+   driver supports; any other miss starts over with a single unit.  */
+static unsigned
+grub_disk_readahead (grub_disk_t disk, grub_disk_addr_t sector)
+{
+  unsigned window = 1, max = disk->max_agglomerate;
+
+  if (max > GRUB_DISK_READAHEAD_MAX)
+    max = GRUB_DISK_READAHEAD_MAX;
+  /* Don't let a window evict itself from the cache.  */
+  if (grub_disk_cache_table && max > grub_disk_cache_num_sets)
+    max = grub_disk_cache_num_sets;
+
+  if (disk->readahead_window && sector == disk->readahead_next)
+    window = disk->readahead_window * 2;
+  if (window > max)
+    window = max;
+
+  if (disk->total_sectors != GRUB_DISK_SIZE_UNKNOWN)
+    {
+      grub_disk_addr_t total = disk->total_sectors
+	<< (disk->log_sector_size - GRUB_DISK_SECTOR_BITS);
+
+      if (sector >= total)
+	window = 1;
+      else if (window > ((total - sector - 1) >> GRUB_DISK_CACHE_BITS))
+	window = (total - sector - 1) >> GRUB_DISK_CACHE_BITS;
+    }
+  if (! window)
+    window = 1;
+
+  disk->readahead_window = window;
+  disk->readahead_next = sector + ((grub_disk_addr_t) window
+				   << GRUB_DISK_CACHE_BITS);
+
+  return window;
+}
+
 /* Small read (less than cache size and not pass across cache unit boundaries).
    sector is already adjusted and is divisible by cache unit size.
  */
@@ -319,9 +535,10 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
 {
   char *data;
   char *tmp_buf;
+  unsigned window;
 
   /* Fetch the cache.  */
-  data = grub_disk_cache_fetch (disk->dev->id, disk->id, sector);
+  data = grub_disk_cache_fetch (disk, sector);
   if (data)
     {
       /* Just copy it!  */
@@ -330,6 +547,38 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
       return GRUB_ERR_NONE;
     }
 
+  /* Read ahead and cache the following units as well.  */
+  window = grub_disk_readahead (disk, sector);
+  if (window > 1)
+    {
+      tmp_buf = grub_malloc ((grub_size_t) window
+			     << (GRUB_DISK_CACHE_BITS + GRUB_DISK_SECTOR_BITS));
+      if (tmp_buf
+	  && grub_disk_read_dev (disk, transform_sector (disk, sector),
+				 window << (GRUB_DISK_CACHE_BITS
+					    + GRUB_DISK_SECTOR_BITS
+					    - disk->log_sector_size),
+				 tmp_buf) == GRUB_ERR_NONE)
+	{
+	  unsigned i;
+
+	  grub_memcpy (buf, tmp_buf + offset, size);
+	  for (i = 0; i < window; i++)
+	    grub_disk_cache_store (disk->dev->id, disk->id,
+				   sector + (i << GRUB_DISK_CACHE_BITS),
+				   tmp_buf
+				   + (i << (GRUB_DISK_CACHE_BITS
+					    + GRUB_DISK_SECTOR_BITS)));
+	  grub_free (tmp_buf);
+	  return GRUB_ERR_NONE;
+	}
+
+      /* Fall back to reading just what is needed.  */
+      grub_free (tmp_buf);
+      grub_errno = GRUB_ERR_NONE;
+      disk->readahead_window = 0;
+    }
+
   /* Allocate a temporary buffer.  */
   tmp_buf = grub_malloc (GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS);
   if (! tmp_buf)
@@ -341,10 +590,10 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
       < (disk->total_sectors << (disk->log_sector_size - GRUB_DISK_SECTOR_BITS)))
     {
       grub_err_t err;
-      err = (disk->dev->read) (disk, transform_sector (disk, sector),
-			       1U << (GRUB_DISK_CACHE_BITS
-				      + GRUB_DISK_SECTOR_BITS
-				      - disk->log_sector_size), tmp_buf);
+      err = grub_disk_read_dev (disk, transform_sector (disk, sector),
+				1U << (GRUB_DISK_CACHE_BITS
+				       + GRUB_DISK_SECTOR_BITS
+				       - disk->log_sector_size), tmp_buf);
       if (!err)
 	{
 	  /* Copy it and store it in the disk cache.  */
@@ -377,8 +626,8 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
     if (!tmp_buf)
       return grub_errno;
     
-    if ((disk->dev->read) (disk, transform_sector (disk, aligned_sector),
-			   num, tmp_buf))
+    if (grub_disk_read_dev (disk, transform_sector (disk, aligned_sector),
+			    num, tmp_buf))
       {
 	grub_error_push ();
 	grub_dprintf ("disk", "%s read failed\n", disk->name);
@@ -461,7 +710,7 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
 	     && agglomerate < disk->max_agglomerate;
 	   agglomerate++)
 	{
-	  data = grub_disk_cache_fetch (disk->dev->id, disk->id,
+	  data = grub_disk_cache_fetch (disk,
 					sector + (agglomerate
 						  << GRUB_DISK_CACHE_BITS));
 	  if (data)
@@ -483,11 +732,11 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
 	{
 	  grub_disk_addr_t i;
 
-	  err = (disk->dev->read) (disk, transform_sector (disk, sector),
-				   agglomerate << (GRUB_DISK_CACHE_BITS
-						   + GRUB_DISK_SECTOR_BITS
-						   - disk->log_sector_size),
-				   buf);
+	  err = grub_disk_read_dev (disk, transform_sector (disk, sector),
+				    agglomerate << (GRUB_DISK_CACHE_BITS
+						    + GRUB_DISK_SECTOR_BITS
+						    - disk->log_sector_size),
+				    buf);
 	  if (err)
 	    return err;
 	  
@@ -741,6 +741,16 @@ grub_dl_load (const char *name)
     return 0;
   }
 
+  mod = grub_dl_load_bundled (grub_dl_dir, name);
+  if (mod)
+    return mod;
+  if (grub_errno)
+    {
+      /* The loose module may still be fine.  */
+      grub_dprintf ("modules", "bundled %s failed: %s\n", name, grub_errmsg);
+      grub_errno = GRUB_ERR_NONE;
+    }
+
   filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM "/%s.mod",
 			     grub_dl_dir, name);
   if (! filename)
@@ -0,0 +1,279 @@
+/* dl_bundle.c - load modules from a module bundle */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/types.h>
+#include <grub/file.h>
+#include <grub/i18n.h>
+
+/* The index of the module bundle under PREFIX, kept across loads.  */
+static struct
+{
+  char *prefix;
+  /* Set if PREFIX has no usable bundle.  */
+  int missing;
+  grub_off_t file_size;
+  grub_uint32_t nmods;
+  struct grub_dl_bundle_entry *entries;
+  grub_uint32_t ndeps;
+  grub_uint32_t *deps;
+  const char *names;
+  grub_uint32_t names_size;
+} bundle;
+
+static void
+grub_dl_bundle_forget (void)
+{
+  grub_free (bundle.prefix);
+  grub_free (bundle.entries);
+  grub_memset (&bundle, 0, sizeof (bundle));
+}
+
+static grub_err_t
+grub_dl_bundle_read_index (grub_file_t file)
+{
+  struct grub_dl_bundle_header hdr;
+  grub_uint32_t index_size, i;
+  grub_size_t fixed;
+  char *index;
+
+  if (grub_file_read (file, &hdr, sizeof (hdr)) != sizeof (hdr))
+    return grub_error (GRUB_ERR_BAD_MODULE, "truncated module bundle");
+
+  index_size = grub_le_to_cpu32 (hdr.index_size);
+  bundle.nmods = grub_le_to_cpu32 (hdr.nmods);
+  bundle.ndeps = grub_le_to_cpu32 (hdr.ndeps);
+  fixed = (grub_size_t) bundle.nmods * sizeof (bundle.entries[0])
+    + (grub_size_t) bundle.ndeps * sizeof (bundle.deps[0]);
+  if (grub_memcmp (hdr.magic, GRUB_DL_BUNDLE_MAGIC, sizeof (hdr.magic)) != 0
+      || index_size > grub_file_size (file) - sizeof (hdr)
+      || bundle.nmods > index_size || bundle.ndeps > index_size
+      || fixed >= index_size)
+    return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+
+  index = grub_malloc (index_size);
+  if (!index)
+    return grub_errno;
+  bundle.entries = (struct grub_dl_bundle_entry *) index;
+  if (grub_file_read (file, index, index_size) != (grub_ssize_t) index_size)
+    return grub_error (GRUB_ERR_BAD_MODULE, "truncated module bundle");
+
+  bundle.deps = (grub_uint32_t *) (index + bundle.nmods
+				   * sizeof (bundle.entries[0]));
+  bundle.names = index + fixed;
+  bundle.names_size = index_size - fixed;
+  if (bundle.names[bundle.names_size - 1] != '\0')
+    return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+
+  /* Check everything once here so that lookups can trust the index.  */
+  for (i = 0; i < bundle.nmods; i++)
+    {
+      struct grub_dl_bundle_entry *e = &bundle.entries[i];
+      grub_uint32_t first_dep = grub_le_to_cpu32 (e->first_dep);
+      grub_uint32_t ndeps = grub_le_to_cpu32 (e->ndeps);
+      grub_uint32_t j;
+
+      if (grub_le_to_cpu32 (e->name) >= bundle.names_size
+	  || first_dep > bundle.ndeps || ndeps > bundle.ndeps - first_dep
+	  || grub_le_to_cpu32 (e->offset) > grub_file_size (file)
+	  || grub_le_to_cpu32 (e->size) > grub_file_size (file)
+	  - grub_le_to_cpu32 (e->offset))
+	return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+      for (j = 0; j < ndeps; j++)
+	if (grub_le_to_cpu32 (bundle.deps[first_dep + j]) >= i
+	    || (j && grub_le_to_cpu32 (bundle.deps[first_dep + j])
+		<= grub_le_to_cpu32 (bundle.deps[first_dep + j - 1])))
+	  return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+/* Open the bundle under DIR and make sure its index is loaded.  Returns
+   NULL without an error if there is no usable bundle.  */
+static grub_file_t
+grub_dl_bundle_open (const char *dir)
+{
+  char *filename;
+  grub_file_t file;
+
+  if (bundle.prefix && bundle.missing && grub_strcmp (bundle.prefix, dir) == 0)
+    return 0;
+
+  filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM "/"
+			     GRUB_DL_BUNDLE_NAME, dir);
+  if (! filename)
+    return 0;
+  file = grub_file_open (filename);
+  grub_free (filename);
+
+  if (! file)
+    {
+      /* Only remember a definite answer; the device may show up later.  */
+      if (grub_errno == GRUB_ERR_FILE_NOT_FOUND)
+	{
+	  grub_dl_bundle_forget ();
+	  bundle.prefix = grub_strdup (dir);
+	  bundle.missing = 1;
+	}
+      grub_errno = GRUB_ERR_NONE;
+      return 0;
+    }
+
+  if (bundle.prefix && grub_strcmp (bundle.prefix, dir) == 0
+      && bundle.file_size == grub_file_size (file))
+    return file;
+
+  grub_dl_bundle_forget ();
+  bundle.prefix = grub_strdup (dir);
+  bundle.file_size = grub_file_size (file);
+  if (! bundle.prefix || grub_dl_bundle_read_index (file))
+    {
+      grub_dprintf ("modules", "ignoring module bundle in %s: %s\n",
+		    dir, grub_errmsg);
+      grub_errno = GRUB_ERR_NONE;
+      grub_file_close (file);
+      grub_dl_bundle_forget ();
+      bundle.prefix = grub_strdup (dir);
+      bundle.missing = 1;
+      return 0;
+    }
+
+  return file;
+}
+
+/* Load NAME and whatever it still needs from the bundle under DIR.
+   Returns NULL without an error if the bundle does not have NAME.  */
+grub_dl_t
+grub_dl_load_bundled (const char *dir, const char *name)
+{
+  grub_file_t file;
+  grub_uint32_t idx, ndeps, first_dep, nload = 0, i, j, k;
+  struct
+  {
+    grub_uint32_t idx;
+    grub_uint32_t offset;
+    grub_uint32_t size;
+    char *image;
+    /* Set on the first module of each read; owns the buffer.  */
+    char *buf;
+  } *load;
+  grub_dl_t mod = 0;
+
+  file = grub_dl_bundle_open (dir);
+  if (! file)
+    return 0;
+
+  for (idx = 0; idx < bundle.nmods; idx++)
+    if (grub_strcmp (bundle.names
+		     + grub_le_to_cpu32 (bundle.entries[idx].name), name) == 0)
+      break;
+  if (idx == bundle.nmods)
+    {
+      grub_file_close (file);
+      return 0;
+    }
+
+  grub_boot_time ("Loading bundled module %s", name);
+
+  first_dep = grub_le_to_cpu32 (bundle.entries[idx].first_dep);
+  ndeps = grub_le_to_cpu32 (bundle.entries[idx].ndeps);
+  load = grub_zalloc ((ndeps + 1) * sizeof (load[0]));
+  if (! load)
+    {
+      grub_file_close (file);
+      return 0;
+    }
+
+  /* Dependencies are listed in file order, each after its own
+     dependencies, so this is also a valid loading order.  */
+  for (i = 0; i <= ndeps; i++)
+    {
+      k = (i < ndeps) ? grub_le_to_cpu32 (bundle.deps[first_dep + i]) : idx;
+      if (k != idx
+	  && grub_dl_get (bundle.names
+			  + grub_le_to_cpu32 (bundle.entries[k].name)))
+	continue;
+      load[nload].idx = k;
+      load[nload].offset = grub_le_to_cpu32 (bundle.entries[k].offset);
+      load[nload].size = grub_le_to_cpu32 (bundle.entries[k].size);
+      nload++;
+    }
+
+  /* Read runs of neighbouring modules with a single request each.  */
+  for (i = 0; i < nload; i = j)
+    {
+      grub_uint32_t len = load[i].size;
+
+      for (j = i + 1; j < nload; j++)
+	{
+	  if (load[j].idx != load[j - 1].idx + 1
+	      || load[j].offset != ALIGN_UP (load[j - 1].offset
+					     + load[j - 1].size,
+					     GRUB_DL_BUNDLE_ALIGN))
+	    break;
+	  len = load[j].offset + load[j].size - load[i].offset;
+	}
+
+      load[i].buf = grub_malloc (len);
+      if (! load[i].buf)
+	goto fail;
+      grub_file_seek (file, load[i].offset);
+      if (grub_file_read (file, load[i].buf, len) != (grub_ssize_t) len)
+	{
+	  if (! grub_errno)
+	    grub_error (GRUB_ERR_FILE_READ_ERROR, N_("premature end of file %s"),
+			GRUB_DL_BUNDLE_NAME);
+	  goto fail;
+	}
+      for (k = i; k < j; k++)
+	load[k].image = load[i].buf + (load[k].offset - load[i].offset);
+    }
+
+  /* As in grub_dl_load_file, close before initialising anything.  */
+  grub_file_close (file);
+  file = 0;
+
+  for (i = 0; i < nload; i++)
+    {
+      grub_dl_t m;
+
+      m = grub_dl_load_core (load[i].image, load[i].size);
+      if (! m)
+	break;
+      m->ref_count--;
+      if (i == nload - 1)
+	mod = m;
+    }
+
+  if (mod && grub_strcmp (mod->name, name) != 0)
+    grub_error (GRUB_ERR_BAD_MODULE, "mismatched names");
+
+ fail:
+  if (file)
+    grub_file_close (file);
+  for (i = 0; i < nload; i++)
+    grub_free (load[i].buf);
+  grub_free (load);
+  return mod;
+}
@@ -56,6 +56,16 @@
   For safety, both allocated blocks and free ones are marked by magic
   numbers. Whenever anything unexpected is detected, GRUB aborts the
   operation.
+
+  Small requests from grub_malloc do not go through the ring at all. They
+  are served from slabs: blocks of GRUB_MM_SLAB_SIZE bytes allocated from
+  the regions, aligned to their own size and cut into objects of a single
+  size class. A slab header sits at the start of each slab, so masking an
+  object's address finds it, and a small hash of slab addresses tells slab
+  objects apart from ordinary blocks. Freed objects are kept on a list in
+  their slab, so both allocation and freeing take constant time. A slab
+  that becomes empty goes back to its region unless it is the only one
+  left with room in its class.
  */
 
 #include <config.h>
@@ -105,6 +115,111 @@ get_header_from_pointer (void *ptr, grub_mm_header_t *p, grub_mm_region_t *r)
 		(unsigned long) (*p)->magic);
 }
 
+#define GRUB_MM_SLAB_SIZE	16384
+#define GRUB_MM_SLAB_MIN_LOG2	4
+#define GRUB_MM_SLAB_MAX	(1 << (GRUB_MM_SLAB_MIN_LOG2 \
+				       + GRUB_MM_SLAB_CLASSES - 1))
+#define GRUB_MM_SLAB_HASH_SIZE	64
+/* Stored in the second word of every free slab object.  */
+#define GRUB_MM_SLAB_FREE_MAGIC	0x51ab2808
+
+struct grub_mm_slab
+{
+  /* Slabs of this class that have free objects.  */
+  struct grub_mm_slab *next;
+  struct grub_mm_slab *prev;
+  struct grub_mm_slab *hash_next;
+  /* Freed objects, linked through their first word.  */
+  void **free;
+  /* Objects from here on have never been handed out.  */
+  char *unused;
+  char *objects;
+  unsigned class;
+  unsigned used;
+  unsigned total;
+};
+
+static struct
+{
+  struct grub_mm_slab *partial;
+  grub_size_t slabs;
+  grub_size_t objects;
+  grub_size_t used;
+} slab_classes[GRUB_MM_SLAB_CLASSES];
+
+static struct grub_mm_slab *slab_hash[GRUB_MM_SLAB_HASH_SIZE];
+static grub_addr_t slab_lowest = ~(grub_addr_t) 0, slab_highest;
+
+static inline unsigned
+slab_hash_index (grub_addr_t base)
+{
+  return (base / GRUB_MM_SLAB_SIZE) % GRUB_MM_SLAB_HASH_SIZE;
+}
+
+/* Return the slab holding PTR, or NULL if PTR is an ordinary block.  */
+static inline struct grub_mm_slab *
+slab_lookup (void *ptr)
+{
+  grub_addr_t base = (grub_addr_t) ptr & ~(grub_addr_t) (GRUB_MM_SLAB_SIZE - 1);
+  struct grub_mm_slab *s;
+
+  if (base < slab_lowest || base > slab_highest)
+    return 0;
+
+  for (s = slab_hash[slab_hash_index (base)]; s; s = s->hash_next)
+    if ((grub_addr_t) s == base)
+      return s;
+
+  return 0;
+}
+
+static void
+slab_unlink (struct grub_mm_slab *s)
+{
+  if (s->prev)
+    s->prev->next = s->next;
+  else
+    slab_classes[s->class].partial = s->next;
+  if (s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+/* Give the empty slab S back to its region.  */
+static void
+slab_release (struct grub_mm_slab *s)
+{
+  struct grub_mm_slab **p;
+
+  slab_unlink (s);
+  for (p = &slab_hash[slab_hash_index ((grub_addr_t) s)]; *p != s;
+       p = &(*p)->hash_next);
+  *p = s->hash_next;
+
+  slab_classes[s->class].slabs--;
+  slab_classes[s->class].objects -= s->total;
+  grub_free (s);
+}
+
+/* Release every empty slab, when memory runs out.  */
+static void
+slab_release_empty (void)
+{
+  unsigned i;
+
+  for (i = 0; i < GRUB_MM_SLAB_CLASSES; i++)
+    {
+      struct grub_mm_slab *s, *next;
+
+      for (s = slab_classes[i].partial; s; s = next)
+	{
+	  next = s->next;
+	  if (! s->used)
+	    slab_release (s);
+	}
+    }
+}
+
 /* Initialize a region starting from ADDR and whose size is SIZE,
    to use it as free space.  */
 void
@@ -314,9 +429,11 @@ grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
   return 0;
 }
 
-/* Allocate SIZE bytes with the alignment ALIGN and return the pointer.  */
-void *
-grub_memalign (grub_size_t align, grub_size_t size)
+/* Allocate SIZE bytes with the alignment ALIGN from the regions.  Return
+   NULL without setting an error if there is no room.  Unless RECLAIM is
+   set, caches are left alone when memory runs out.  */
+static void *
+grub_mm_region_alloc (grub_size_t align, grub_size_t size, int reclaim)
 {
   grub_mm_region_t r;
   grub_size_t n = ((size + GRUB_MM_ALIGN - 1) >> GRUB_MM_ALIGN_LOG2) + 1;
@@ -349,12 +466,16 @@ grub_memalign (grub_size_t align, grub_size_t size)
 	return p;
     }
 
+  if (!reclaim)
+    goto fail;
+
   /* If failed, increase free memory somehow.  */
   switch (count)
     {
     case 0:
-      /* Invalidate disk caches.  */
-      grub_disk_cache_invalidate_all ();
+      /* Invalidate disk caches and drop empty slabs.  */
+      grub_disk_cache_release ();
+      slab_release_empty ();
       count++;
       goto again;
 
@@ -371,14 +492,176 @@ grub_memalign (grub_size_t align, grub_size_t size)
     }
 
  fail:
-  grub_error (GRUB_ERR_OUT_OF_MEMORY, N_("out of memory"));
   return 0;
 }
 
+/* Allocate SIZE bytes with the alignment ALIGN and return the pointer.  */
+void *
+grub_memalign (grub_size_t align, grub_size_t size)
+{
+  void *ret;
+
+  ret = grub_mm_region_alloc (align, size, 1);
+  if (! ret)
+    grub_error (GRUB_ERR_OUT_OF_MEMORY, N_("out of memory"));
+
+  return ret;
+}
+
+static struct grub_mm_slab *
+slab_new (unsigned class)
+{
+  struct grub_mm_slab *s;
+  grub_size_t obj_size = (grub_size_t) 1 << (class + GRUB_MM_SLAB_MIN_LOG2);
+  struct grub_mm_slab **bucket;
+
+  /* Small allocations can do without a slab, that is no reason to throw
+     away the disk cache.  */
+  s = grub_mm_region_alloc (GRUB_MM_SLAB_SIZE, GRUB_MM_SLAB_SIZE, 0);
+  if (! s)
+    return 0;
+
+  s->class = class;
+  s->used = 0;
+  s->free = 0;
+  s->objects = (char *) s + ALIGN_UP (sizeof (*s), GRUB_MM_ALIGN);
+  s->unused = s->objects;
+  s->total = (GRUB_MM_SLAB_SIZE - (s->objects - (char *) s)) / obj_size;
+
+  bucket = &slab_hash[slab_hash_index ((grub_addr_t) s)];
+  s->hash_next = *bucket;
+  *bucket = s;
+  if ((grub_addr_t) s < slab_lowest)
+    slab_lowest = (grub_addr_t) s;
+  if ((grub_addr_t) s > slab_highest)
+    slab_highest = (grub_addr_t) s;
+
+  s->prev = 0;
+  s->next = slab_classes[class].partial;
+  if (s->next)
+    s->next->prev = s;
+  slab_classes[class].partial = s;
+  slab_classes[class].slabs++;
+  slab_classes[class].objects += s->total;
+
+  return s;
+}
+
+static void *
+slab_alloc (grub_size_t size)
+{
+  unsigned class = 0;
+  struct grub_mm_slab *s;
+  void **obj;
+
+  if (size > 1)
+    for (size = (size - 1) >> GRUB_MM_SLAB_MIN_LOG2; size; size >>= 1)
+      class++;
+
+  s = slab_classes[class].partial;
+  if (! s)
+    {
+      s = slab_new (class);
+      if (! s)
+	return 0;
+    }
+
+  if (s->free)
+    {
+      obj = s->free;
+      s->free = *obj;
+    }
+  else
+    {
+      obj = (void **) s->unused;
+      s->unused += (grub_size_t) 1 << (class + GRUB_MM_SLAB_MIN_LOG2);
+    }
+  ((grub_size_t *) obj)[1] = 0;
+
+  s->used++;
+  slab_classes[class].used++;
+  if (s->used == s->total)
+    slab_unlink (s);
+
+  return obj;
+}
+
+/* Free PTR if it is a slab object.  Return zero if it is not.  */
+static int
+slab_free (void *ptr)
+{
+  struct grub_mm_slab *s;
+  grub_size_t obj_size;
+
+  s = slab_lookup (ptr);
+  if (! s)
+    return 0;
+
+  obj_size = (grub_size_t) 1 << (s->class + GRUB_MM_SLAB_MIN_LOG2);
+  if ((char *) ptr < s->objects || (char *) ptr >= s->unused
+      || ((grub_addr_t) ((char *) ptr - s->objects) & (obj_size - 1)))
+    grub_fatal ("invalid slab pointer %p", ptr);
+
+  /* The magic alone may be user data; only then walk the list.  */
+  if (((grub_size_t *) ptr)[1] == GRUB_MM_SLAB_FREE_MAGIC)
+    {
+      void **q;
+
+      for (q = s->free; q; q = *q)
+	if (q == ptr)
+	  grub_fatal ("double free at %p", ptr);
+    }
+
+  if (s->used == s->total)
+    {
+      s->prev = 0;
+      s->next = slab_classes[s->class].partial;
+      if (s->next)
+	s->next->prev = s;
+      slab_classes[s->class].partial = s;
+    }
+
+  *(void **) ptr = s->free;
+  ((grub_size_t *) ptr)[1] = GRUB_MM_SLAB_FREE_MAGIC;
+  s->free = ptr;
+  s->used--;
+  slab_classes[s->class].used--;
+
+  /* Keep one slab with room around so that a malloc/free pair at the
+     boundary does not keep fetching and returning it.  */
+  if (! s->used && (s->next || s->prev))
+    slab_release (s);
+
+  return 1;
+}
+
+void
+grub_mm_get_slab_stats (struct grub_mm_slab_stats *stats)
+{
+  unsigned i;
+
+  for (i = 0; i < GRUB_MM_SLAB_CLASSES; i++)
+    {
+      stats[i].obj_size = (grub_size_t) 1 << (i + GRUB_MM_SLAB_MIN_LOG2);
+      stats[i].slabs = slab_classes[i].slabs;
+      stats[i].objects = slab_classes[i].objects;
+      stats[i].used = slab_classes[i].used;
+    }
+}
+
 /* Allocate SIZE bytes and return the pointer.  */
 void *
 grub_malloc (grub_size_t size)
 {
+  if (size <= GRUB_MM_SLAB_MAX)
+    {
+      void *ret;
+
+      ret = slab_alloc (size);
+      if (ret)
+	return ret;
+    }
+
   return grub_memalign (0, size);
 }
 
@@ -388,7 +671,7 @@ grub_zalloc (grub_size_t size)
 {
   void *ret;
 
-  ret = grub_memalign (0, size);
+  ret = grub_malloc (size);
   if (ret)
     grub_memset (ret, 0, size);
 
@@ -405,6 +688,9 @@ grub_free (void *ptr)
   if (! ptr)
     return;
 
+  if (slab_free (ptr))
+    return;
+
   get_header_from_pointer (ptr, &p, &r);
 
   if (r->first->magic == GRUB_MM_ALLOC_MAGIC)
@@ -484,6 +770,25 @@ grub_realloc (void *ptr, grub_size_t size)
       return 0;
     }
 
+  {
+    struct grub_mm_slab *s = slab_lookup (ptr);
+
+    if (s)
+      {
+	grub_size_t obj_size = (grub_size_t) 1 << (s->class
+						    + GRUB_MM_SLAB_MIN_LOG2);
+
+	if (size <= obj_size)
+	  return ptr;
+	q = grub_malloc (size);
+	if (! q)
+	  return q;
+	grub_memcpy (q, ptr, obj_size);
+	grub_free (ptr);
+	return q;
+      }
+  }
+
   /* FIXME: Not optimal.  */
   n = ((size + GRUB_MM_ALIGN - 1) >> GRUB_MM_ALIGN_LOG2) + 1;
   get_header_from_pointer (ptr, &p, &r);
@@ -495,8 +800,10 @@ grub_realloc (void *ptr, grub_size_t size)
   if (! q)
     return q;
 
-  /* We've already checked that p->size < n.  */
-  grub_memcpy (q, ptr, p->size << GRUB_MM_ALIGN_LOG2);
+  /* We've already checked that p->size < n, so the data part of the old
+     block (everything but its header cell) is smaller than SIZE.  The new
+     block may be a slab object, which has no room for more.  */
+  grub_memcpy (q, ptr, (p->size - 1) << GRUB_MM_ALIGN_LOG2);
   grub_free (ptr);
   return q;
 }
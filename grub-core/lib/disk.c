@@ -34,21 +34,14 @@ static void
 grub_disk_cache_invalidate (unsigned long dev_id, unsigned long disk_id,
 			    grub_disk_addr_t sector)
 {
-  unsigned cache_index;
   struct grub_disk_cache *cache;
 
   sector &= ~((grub_disk_addr_t) GRUB_DISK_CACHE_SIZE - 1);
-  cache_index = grub_disk_cache_get_index (dev_id, disk_id, sector);
-  cache = grub_disk_cache_table + cache_index;
+  cache = grub_disk_cache_find (dev_id, disk_id, sector);
 
-  if (cache->dev_id == dev_id && cache->disk_id == disk_id
-      && cache->sector == sector && cache->data)
-    {
-      cache->lock = 1;
-      grub_free (cache->data);
-      cache->data = 0;
-      cache->lock = 0;
-    }
+  /* The data lives in the cache slab, just forget about it.  */
+  if (cache)
+    cache->data = 0;
 }
 
 grub_err_t
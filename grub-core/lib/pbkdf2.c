@@ -25,6 +25,20 @@
 
 GRUB_MOD_LICENSE ("GPLv2+");
 
+/* Finish an HMAC whose inner hash has been fed into WORK, using the
+   precomputed outer pad state OUTER.  WORK is clobbered.  */
+static void
+hmac_finish (const struct gcry_md_spec *md, void *work, const void *outer,
+	     grub_uint8_t *out)
+{
+  md->final (work);
+  grub_memcpy (out, md->read (work), md->mdlen);
+  grub_memcpy (work, outer, md->contextsize);
+  md->write (work, out, md->mdlen);
+  md->final (work);
+  grub_memcpy (out, md->read (work), md->mdlen);
+}
+
 /* Implement PKCS#5 PBKDF2 as per RFC 2898.  The PRF to use is HMAC variant
    of digest supplied by MD.  Inputs are the password P of length PLEN,
    the salt S of length SLEN, the iteration counter C (> 0), and the
@@ -38,6 +52,19 @@ grub_crypto_pbkdf2 (const struct gcry_md_spec *md,
 		    const grub_uint8_t *S, grub_size_t Slen,
 		    unsigned int c,
 		    grub_uint8_t *DK, grub_size_t dkLen)
+{
+  return grub_crypto_pbkdf2_cancel (md, P, Plen, S, Slen, c, DK, dkLen, NULL);
+}
+
+/* Same as above, but stop early with GPG_ERR_CANCELED once CANCEL, if
+   not NULL, points to a non-zero value.  */
+gcry_err_code_t
+grub_crypto_pbkdf2_cancel (const struct gcry_md_spec *md,
+			   const grub_uint8_t *P, grub_size_t Plen,
+			   const grub_uint8_t *S, grub_size_t Slen,
+			   unsigned int c,
+			   grub_uint8_t *DK, grub_size_t dkLen,
+			   const volatile int *cancel)
 {
   unsigned int hLen = md->mdlen;
   grub_uint8_t U[GRUB_CRYPTO_MAX_MDLEN];
@@ -47,11 +74,11 @@ grub_crypto_pbkdf2 (const struct gcry_md_spec *md,
   unsigned int r;
   unsigned int i;
   unsigned int k;
-  gcry_err_code_t rc;
-  grub_uint8_t *tmp;
-  grub_size_t tmplen = Slen + 4;
+  grub_uint8_t *mem, *inner, *outer, *work, *pad;
+  gcry_err_code_t err = GPG_ERR_NO_ERROR;
 
-  if (md->mdlen > GRUB_CRYPTO_MAX_MDLEN || md->mdlen == 0)
+  if (md->mdlen > GRUB_CRYPTO_MAX_MDLEN || md->mdlen == 0
+      || md->mdlen > md->blocksize)
     return GPG_ERR_INV_ARG;
 
   if (c == 0)
@@ -66,35 +93,59 @@ grub_crypto_pbkdf2 (const struct gcry_md_spec *md,
   l = ((dkLen - 1) / hLen) + 1;
   r = dkLen - (l - 1) * hLen;
 
-  tmp = grub_malloc (tmplen);
-  if (tmp == NULL)
+  /* The HMAC key is the same for every iteration, so hash the inner and
+     outer pads once and restart each HMAC from a copy of those states.
+     That halves the number of compression function calls and avoids
+     the allocations grub_crypto_hmac_buffer would do per iteration.  */
+  mem = grub_malloc (3 * md->contextsize + md->blocksize);
+  if (mem == NULL)
     return GPG_ERR_OUT_OF_MEMORY;
-
-  grub_memcpy (tmp, S, Slen);
+  inner = mem;
+  outer = inner + md->contextsize;
+  work = outer + md->contextsize;
+  pad = work + md->contextsize;
+
+  grub_memset (pad, 0, md->blocksize);
+  if (Plen > md->blocksize)
+    grub_crypto_hash (md, pad, P, Plen);
+  else
+    grub_memcpy (pad, P, Plen);
+
+  for (k = 0; k < md->blocksize; k++)
+    pad[k] ^= 0x36;
+  md->init (inner);
+  md->write (inner, pad, md->blocksize);
+
+  for (k = 0; k < md->blocksize; k++)
+    pad[k] ^= 0x36 ^ 0x5c;
+  md->init (outer);
+  md->write (outer, pad, md->blocksize);
 
   for (i = 1; i - 1 < l; i++)
     {
-      grub_memset (T, 0, hLen);
+      grub_uint8_t be_i[4];
 
-      for (u = 0; u < c; u++)
-	{
-	  if (u == 0)
-	    {
-	      tmp[Slen + 0] = (i & 0xff000000) >> 24;
-	      tmp[Slen + 1] = (i & 0x00ff0000) >> 16;
-	      tmp[Slen + 2] = (i & 0x0000ff00) >> 8;
-	      tmp[Slen + 3] = (i & 0x000000ff) >> 0;
+      be_i[0] = (i & 0xff000000) >> 24;
+      be_i[1] = (i & 0x00ff0000) >> 16;
+      be_i[2] = (i & 0x0000ff00) >> 8;
+      be_i[3] = (i & 0x000000ff) >> 0;
 
-	      rc = grub_crypto_hmac_buffer (md, P, Plen, tmp, tmplen, U);
-	    }
-	  else
-	    rc = grub_crypto_hmac_buffer (md, P, Plen, U, hLen, U);
+      grub_memcpy (work, inner, md->contextsize);
+      md->write (work, S, Slen);
+      md->write (work, be_i, sizeof (be_i));
+      hmac_finish (md, work, outer, U);
+      grub_memcpy (T, U, hLen);
 
-	  if (rc != GPG_ERR_NO_ERROR)
+      for (u = 1; u < c; u++)
+	{
+	  if (cancel && *cancel)
 	    {
-	      grub_free (tmp);
-	      return rc;
+	      err = GPG_ERR_CANCELED;
+	      goto out;
 	    }
+	  grub_memcpy (work, inner, md->contextsize);
+	  md->write (work, U, hLen);
+	  hmac_finish (md, work, outer, U);
 
 	  for (k = 0; k < hLen; k++)
 	    T[k] ^= U[k];
@@ -103,7 +154,11 @@ grub_crypto_pbkdf2 (const struct gcry_md_spec *md,
       grub_memcpy (DK + (i - 1) * hLen, T, i == l ? r : hLen);
     }
 
-  grub_free (tmp);
+ out:
+  grub_memset (mem, 0, 3 * md->contextsize + md->blocksize);
+  grub_free (mem);
+  grub_memset (U, 0, sizeof (U));
+  grub_memset (T, 0, sizeof (T));
 
-  return GPG_ERR_NO_ERROR;
+  return err;
 }
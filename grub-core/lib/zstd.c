@@ -0,0 +1,1163 @@
+/* zstd.c - Zstandard decompression (RFC 8878)  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A small one-shot decoder: the whole output is kept in memory, so the
+   window size announced by the frame does not matter and matches may
+   reach back to the start of the frame.  Dictionaries are not supported
+   and the optional content checksum is not verified, which is what the
+   filesystems using zstd need.  */
+
+#include <grub/types.h>
+#include <grub/err.h>
+#include <grub/mm.h>
+#include <grub/misc.h>
+#include <grub/dl.h>
+#include <grub/zstd.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_SKIPPABLE_MAGIC	0x184d2a50
+#define ZSTD_SKIPPABLE_MASK	0xfffffff0
+
+#define ZSTD_BLOCK_MAX		(128 * 1024)
+
+#define ZSTD_LL_MAX_SYMBOL	35
+#define ZSTD_ML_MAX_SYMBOL	52
+#define ZSTD_OF_MAX_SYMBOL	31
+#define ZSTD_HUF_WEIGHT_MAX_SYMBOL	15
+
+#define ZSTD_LL_MAX_LOG		9
+#define ZSTD_ML_MAX_LOG		9
+#define ZSTD_OF_MAX_LOG		8
+#define ZSTD_HUF_WEIGHT_MAX_LOG	6
+#define ZSTD_FSE_MAX_LOG	9
+#define ZSTD_HUF_MAX_LOG	11
+
+enum
+  {
+    ZSTD_BLOCK_RAW,
+    ZSTD_BLOCK_RLE,
+    ZSTD_BLOCK_COMPRESSED
+  };
+
+enum
+  {
+    ZSTD_LIT_RAW,
+    ZSTD_LIT_RLE,
+    ZSTD_LIT_COMPRESSED,
+    ZSTD_LIT_TREELESS
+  };
+
+enum
+  {
+    ZSTD_MODE_PREDEFINED,
+    ZSTD_MODE_RLE,
+    ZSTD_MODE_FSE,
+    ZSTD_MODE_REPEAT
+  };
+
+struct zstd_fse_entry
+{
+  grub_uint16_t base;
+  grub_uint8_t symbol;
+  grub_uint8_t nbits;
+};
+
+struct zstd_fse_table
+{
+  struct zstd_fse_entry e[1 << ZSTD_FSE_MAX_LOG];
+  unsigned log;
+  int valid;
+};
+
+struct zstd_huf_entry
+{
+  grub_uint8_t symbol;
+  grub_uint8_t nbits;
+};
+
+struct zstd_ctx
+{
+  struct zstd_fse_table ll, of, ml;
+  /* Used while decoding the Huffman weights.  */
+  struct zstd_fse_table weights;
+  struct zstd_huf_entry huf[1 << ZSTD_HUF_MAX_LOG];
+  /* Zero while the frame has no Huffman table yet.  */
+  unsigned huf_log;
+  grub_uint32_t rep[3];
+  grub_uint8_t lit[ZSTD_BLOCK_MAX];
+};
+
+/* Predefined distributions and code tables, RFC 8878 section 3.1.1.3.2.  */
+static const grub_int16_t ll_default[ZSTD_LL_MAX_SYMBOL + 1] =
+  {
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+    -1, -1, -1, -1
+  };
+
+static const grub_int16_t ml_default[ZSTD_ML_MAX_SYMBOL + 1] =
+  {
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+    -1, -1, -1, -1, -1
+  };
+
+static const grub_int16_t of_default[ZSTD_OF_MAX_SYMBOL + 1] =
+  {
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, 0, 0, 0
+  };
+
+#define ZSTD_LL_DEFAULT_LOG	6
+#define ZSTD_ML_DEFAULT_LOG	6
+#define ZSTD_OF_DEFAULT_LOG	5
+
+static const grub_uint32_t ll_base[ZSTD_LL_MAX_SYMBOL + 1] =
+  {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+    8192, 16384, 32768, 65536
+  };
+
+static const grub_uint8_t ll_bits[ZSTD_LL_MAX_SYMBOL + 1] =
+  {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+    13, 14, 15, 16
+  };
+
+static const grub_uint32_t ml_base[ZSTD_ML_MAX_SYMBOL + 1] =
+  {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+    19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+    35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+    4099, 8195, 16387, 32771, 65539
+  };
+
+static const grub_uint8_t ml_bits[ZSTD_ML_MAX_SYMBOL + 1] =
+  {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+    12, 13, 14, 15, 16
+  };
+
+static inline unsigned
+highbit32 (grub_uint32_t v)
+{
+  unsigned r = 0;
+
+  while (v >>= 1)
+    r++;
+  return r;
+}
+
+static inline grub_uint32_t
+get_le24 (const grub_uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | ((grub_uint32_t) p[2] << 16);
+}
+
+/* Backward bit stream as used by the FSE and Huffman coded parts.  The
+   stream is read from its last byte towards the first one, the container
+   always holds the 8 bytes at PTR and CONSUMED counts the bits already used
+   from its top.  */
+struct zstd_bits
+{
+  const grub_uint8_t *start;
+  const grub_uint8_t *ptr;
+  grub_uint64_t container;
+  unsigned consumed;
+};
+
+static grub_err_t
+bits_init (struct zstd_bits *b, const grub_uint8_t *src, grub_size_t size)
+{
+  grub_uint8_t last;
+  grub_size_t i;
+
+  if (size == 0 || (last = src[size - 1]) == 0)
+    return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		       "zstd: corrupted bitstream");
+
+  b->start = src;
+  if (size >= 8)
+    {
+      b->ptr = src + size - 8;
+      b->container = grub_le_to_cpu64 (grub_get_unaligned64 (b->ptr));
+      b->consumed = 0;
+    }
+  else
+    {
+      b->ptr = src;
+      b->container = 0;
+      for (i = 0; i < size; i++)
+	b->container |= (grub_uint64_t) src[i] << (8 * i);
+      b->consumed = (8 - size) * 8;
+    }
+  /* Skip the padding up to and including the final 1 bit.  */
+  b->consumed += 8 - highbit32 (last);
+  return GRUB_ERR_NONE;
+}
+
+static inline grub_uint64_t
+bits_peek (const struct zstd_bits *b, unsigned n)
+{
+  return ((b->container << (b->consumed & 63)) >> 1) >> ((63 - n) & 63);
+}
+
+static inline grub_uint64_t
+bits_read (struct zstd_bits *b, unsigned n)
+{
+  grub_uint64_t v = bits_peek (b, n);
+
+  b->consumed += n;
+  return v;
+}
+
+/* Refill the container.  Returns 1 once more bits were read than the stream
+   holds.  */
+static inline int
+bits_reload (struct zstd_bits *b)
+{
+  unsigned nbytes;
+
+  if (b->consumed > 64)
+    return 1;
+  if (b->ptr >= b->start + 8)
+    {
+      b->ptr -= b->consumed >> 3;
+      b->consumed &= 7;
+    }
+  else if (b->ptr == b->start)
+    return 0;
+  else
+    {
+      nbytes = b->consumed >> 3;
+      if (nbytes > (grub_size_t) (b->ptr - b->start))
+	nbytes = b->ptr - b->start;
+      b->ptr -= nbytes;
+      b->consumed -= nbytes * 8;
+    }
+  b->container = grub_le_to_cpu64 (grub_get_unaligned64 (b->ptr));
+  return 0;
+}
+
+static inline int
+bits_finished (const struct zstd_bits *b)
+{
+  return b->ptr == b->start && b->consumed == 64;
+}
+
+/* Read up to 25 bits at bit offset POS of a forward little-endian stream.  */
+static grub_uint32_t
+fwd_bits (const grub_uint8_t *src, grub_size_t size, grub_size_t pos,
+	  unsigned n)
+{
+  grub_size_t byte = pos >> 3;
+  grub_uint32_t v = 0;
+  unsigned i;
+
+  for (i = 0; i < 4 && byte + i < size; i++)
+    v |= (grub_uint32_t) src[byte + i] << (8 * i);
+  return (v >> (pos & 7)) & ((1U << n) - 1);
+}
+
+/* Parse an FSE table description (RFC 8878 section 4.1.1) into NORM.
+   Returns the size of the description or -1.  */
+static grub_ssize_t
+fse_read_header (const grub_uint8_t *src, grub_size_t size,
+		 grub_int16_t *norm, unsigned max_symbol, unsigned max_log,
+		 unsigned *log_out)
+{
+  grub_size_t pos;
+  unsigned log, symbol = 0, nbits, i;
+  int remaining, threshold, previous0 = 0;
+
+  if (size == 0)
+    goto corrupted;
+
+  log = (src[0] & 0xf) + 5;
+  if (log > max_log)
+    goto corrupted;
+  pos = 4;
+  remaining = (1 << log) + 1;
+  threshold = 1 << log;
+  nbits = log + 1;
+
+  while (remaining > 1)
+    {
+      int max, count;
+      grub_uint32_t v;
+
+      if (previous0)
+	{
+	  unsigned repeat;
+
+	  do
+	    {
+	      repeat = fwd_bits (src, size, pos, 2);
+	      pos += 2;
+	      for (i = 0; i < repeat; i++)
+		{
+		  if (symbol > max_symbol)
+		    goto corrupted;
+		  norm[symbol++] = 0;
+		}
+	    }
+	  while (repeat == 3);
+	}
+      if (symbol > max_symbol)
+	goto corrupted;
+
+      max = (2 * threshold - 1) - remaining;
+      v = fwd_bits (src, size, pos, nbits);
+      if ((int) (v & (threshold - 1)) < max)
+	{
+	  count = v & (threshold - 1);
+	  pos += nbits - 1;
+	}
+      else
+	{
+	  count = v & (2 * threshold - 1);
+	  if (count >= threshold)
+	    count -= max;
+	  pos += nbits;
+	}
+      count--;
+      remaining -= count < 0 ? -count : count;
+      norm[symbol++] = count;
+      previous0 = (count == 0);
+      while (remaining < threshold)
+	{
+	  nbits--;
+	  threshold >>= 1;
+	}
+    }
+
+  if (remaining != 1 || (pos + 7) / 8 > size)
+    goto corrupted;
+  for (; symbol <= max_symbol; symbol++)
+    norm[symbol] = 0;
+  *log_out = log;
+  return (pos + 7) / 8;
+
+ corrupted:
+  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: corrupted FSE table");
+  return -1;
+}
+
+static grub_err_t
+fse_build (struct zstd_fse_table *t, const grub_int16_t *norm,
+	   unsigned max_symbol, unsigned log)
+{
+  grub_uint16_t next[ZSTD_ML_MAX_SYMBOL + 1];
+  unsigned size = 1 << log, high = size - 1, mask = size - 1;
+  unsigned step = (size >> 1) + (size >> 3) + 3;
+  unsigned pos = 0, s, i;
+  int j;
+
+  t->valid = 0;
+
+  /* Symbols with a "less than 1" probability go to the end of the table.  */
+  for (s = 0; s <= max_symbol; s++)
+    if (norm[s] == -1)
+      {
+	t->e[high--].symbol = s;
+	next[s] = 1;
+      }
+    else
+      next[s] = norm[s];
+
+  for (s = 0; s <= max_symbol; s++)
+    for (j = 0; j < norm[s]; j++)
+      {
+	t->e[pos].symbol = s;
+	do
+	  pos = (pos + step) & mask;
+	while (pos > high);
+      }
+  if (pos != 0)
+    return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		       "zstd: corrupted FSE table");
+
+  for (i = 0; i < size; i++)
+    {
+      unsigned n = next[t->e[i].symbol]++;
+      unsigned nb = log - highbit32 (n);
+
+      t->e[i].nbits = nb;
+      t->e[i].base = (n << nb) - size;
+    }
+
+  t->log = log;
+  t->valid = 1;
+  return GRUB_ERR_NONE;
+}
+
+static void
+fse_build_rle (struct zstd_fse_table *t, grub_uint8_t symbol)
+{
+  t->e[0].symbol = symbol;
+  t->e[0].nbits = 0;
+  t->e[0].base = 0;
+  t->log = 0;
+  t->valid = 1;
+}
+
+/* Read the Huffman tree description (RFC 8878 section 4.2.1) and build the
+   single-symbol decoding table.  Returns the size of the description or
+   -1.  */
+static grub_ssize_t
+huf_read_table (struct zstd_ctx *ctx, const grub_uint8_t *src,
+		grub_size_t size)
+{
+  grub_uint8_t weights[256];
+  unsigned count[ZSTD_HUF_MAX_LOG + 2];
+  unsigned start[ZSTD_HUF_MAX_LOG + 2];
+  unsigned nweights = 0, header, i, w, max_bits, pos;
+  grub_uint32_t total = 0, left;
+  grub_size_t used;
+
+  if (size == 0)
+    goto corrupted;
+
+  header = src[0];
+  if (header >= 128)
+    {
+      nweights = header - 127;
+      used = 1 + (nweights + 1) / 2;
+      if (used > size)
+	goto corrupted;
+      for (i = 0; i < nweights; i++)
+	weights[i] = (i & 1) ? (src[1 + i / 2] & 0xf) : (src[1 + i / 2] >> 4);
+    }
+  else
+    {
+      struct zstd_fse_table *t = &ctx->weights;
+      grub_int16_t norm[ZSTD_HUF_WEIGHT_MAX_SYMBOL + 1];
+      struct zstd_bits b;
+      grub_ssize_t hdr;
+      unsigned log, s1, s2;
+
+      used = 1 + header;
+      if (used > size)
+	goto corrupted;
+      hdr = fse_read_header (src + 1, header, norm,
+			     ZSTD_HUF_WEIGHT_MAX_SYMBOL,
+			     ZSTD_HUF_WEIGHT_MAX_LOG, &log);
+      if (hdr < 0)
+	return -1;
+      if (fse_build (t, norm, ZSTD_HUF_WEIGHT_MAX_SYMBOL, log)
+	  || bits_init (&b, src + 1 + hdr, header - hdr))
+	return -1;
+
+      /* Two interleaved states sharing one table.  */
+      s1 = bits_read (&b, log);
+      s2 = bits_read (&b, log);
+      while (1)
+	{
+	  if (bits_reload (&b) || nweights >= 254)
+	    goto corrupted;
+	  weights[nweights++] = t->e[s1].symbol;
+	  s1 = t->e[s1].base + bits_read (&b, t->e[s1].nbits);
+	  if (bits_reload (&b))
+	    {
+	      weights[nweights++] = t->e[s2].symbol;
+	      break;
+	    }
+	  weights[nweights++] = t->e[s2].symbol;
+	  s2 = t->e[s2].base + bits_read (&b, t->e[s2].nbits);
+	  if (bits_reload (&b))
+	    {
+	      if (nweights >= 255)
+		goto corrupted;
+	      weights[nweights++] = t->e[s1].symbol;
+	      break;
+	    }
+	}
+    }
+
+  for (i = 0; i < nweights; i++)
+    {
+      if (weights[i] > ZSTD_HUF_MAX_LOG)
+	goto corrupted;
+      if (weights[i])
+	total += 1 << (weights[i] - 1);
+    }
+  if (total == 0)
+    goto corrupted;
+
+  /* The weight of the last symbol is implied by the others.  */
+  max_bits = highbit32 (total) + 1;
+  if (max_bits > ZSTD_HUF_MAX_LOG)
+    goto corrupted;
+  left = (1U << max_bits) - total;
+  if (left & (left - 1))
+    goto corrupted;
+  weights[nweights++] = highbit32 (left) + 1;
+
+  grub_memset (count, 0, sizeof (count));
+  for (i = 0; i < nweights; i++)
+    count[weights[i]]++;
+  pos = 0;
+  for (w = 1; w <= max_bits; w++)
+    {
+      start[w] = pos;
+      pos += count[w] << (w - 1);
+    }
+
+  for (i = 0; i < nweights; i++)
+    {
+      unsigned len, j;
+
+      w = weights[i];
+      if (!w)
+	continue;
+      len = 1 << (w - 1);
+      for (j = 0; j < len; j++)
+	{
+	  ctx->huf[start[w] + j].symbol = i;
+	  ctx->huf[start[w] + j].nbits = max_bits + 1 - w;
+	}
+      start[w] += len;
+    }
+
+  ctx->huf_log = max_bits;
+  return used;
+
+ corrupted:
+  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: corrupted Huffman table");
+  return -1;
+}
+
+static grub_err_t
+huf_decode_stream (struct zstd_ctx *ctx, const grub_uint8_t *src,
+		   grub_size_t size, grub_uint8_t *out, grub_size_t n)
+{
+  const struct zstd_huf_entry *e;
+  unsigned log = ctx->huf_log;
+  struct zstd_bits b;
+  grub_size_t i = 0;
+
+  if (bits_init (&b, src, size))
+    return grub_errno;
+
+  /* Four symbols take at most 44 bits, a refilled container has 57.  */
+  while (i + 4 <= n)
+    {
+      if (bits_reload (&b))
+	break;
+      e = &ctx->huf[bits_peek (&b, log)];
+      out[i++] = e->symbol;
+      b.consumed += e->nbits;
+      e = &ctx->huf[bits_peek (&b, log)];
+      out[i++] = e->symbol;
+      b.consumed += e->nbits;
+      e = &ctx->huf[bits_peek (&b, log)];
+      out[i++] = e->symbol;
+      b.consumed += e->nbits;
+      e = &ctx->huf[bits_peek (&b, log)];
+      out[i++] = e->symbol;
+      b.consumed += e->nbits;
+    }
+  while (i < n)
+    {
+      if (bits_reload (&b))
+	break;
+      e = &ctx->huf[bits_peek (&b, log)];
+      out[i++] = e->symbol;
+      b.consumed += e->nbits;
+    }
+
+  if (i != n || bits_reload (&b) || !bits_finished (&b))
+    return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		       "zstd: corrupted literals");
+  return GRUB_ERR_NONE;
+}
+
+/* Decode the literals section of a compressed block.  Returns its size or
+   -1 and points *LIT at the regenerated literals.  */
+static grub_ssize_t
+decode_literals (struct zstd_ctx *ctx, const grub_uint8_t *src,
+		 grub_size_t size, const grub_uint8_t **lit, grub_size_t *nlit)
+{
+  unsigned type, fmt;
+  grub_size_t regen, comp, hsize, rem;
+  const grub_uint8_t *p;
+
+  if (size < 1)
+    goto corrupted;
+
+  type = src[0] & 3;
+  fmt = (src[0] >> 2) & 3;
+
+  if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE)
+    {
+      switch (fmt)
+	{
+	case 1:
+	  hsize = 2;
+	  if (size < hsize)
+	    goto corrupted;
+	  regen = (src[0] >> 4) | (src[1] << 4);
+	  break;
+	case 3:
+	  hsize = 3;
+	  if (size < hsize)
+	    goto corrupted;
+	  regen = get_le24 (src) >> 4;
+	  break;
+	default:
+	  hsize = 1;
+	  regen = src[0] >> 3;
+	  break;
+	}
+      if (regen > ZSTD_BLOCK_MAX)
+	goto corrupted;
+
+      if (type == ZSTD_LIT_RAW)
+	{
+	  if (hsize + regen > size)
+	    goto corrupted;
+	  *lit = src + hsize;
+	  *nlit = regen;
+	  return hsize + regen;
+	}
+
+      if (hsize + 1 > size)
+	goto corrupted;
+      grub_memset (ctx->lit, src[hsize], regen);
+      *lit = ctx->lit;
+      *nlit = regen;
+      return hsize + 1;
+    }
+
+  switch (fmt)
+    {
+    case 2:
+      {
+	grub_uint32_t h;
+
+	hsize = 4;
+	if (size < hsize)
+	  goto corrupted;
+	h = grub_le_to_cpu32 (grub_get_unaligned32 (src));
+	regen = (h >> 4) & 0x3fff;
+	comp = h >> 18;
+	break;
+      }
+    case 3:
+      {
+	grub_uint64_t h;
+
+	hsize = 5;
+	if (size < hsize)
+	  goto corrupted;
+	h = grub_le_to_cpu32 (grub_get_unaligned32 (src))
+	  | ((grub_uint64_t) src[4] << 32);
+	regen = (h >> 4) & 0x3ffff;
+	comp = (h >> 22) & 0x3ffff;
+	break;
+      }
+    default:
+      {
+	grub_uint32_t h;
+
+	hsize = 3;
+	if (size < hsize)
+	  goto corrupted;
+	h = get_le24 (src);
+	regen = (h >> 4) & 0x3ff;
+	comp = (h >> 14) & 0x3ff;
+	break;
+      }
+    }
+  if (regen > ZSTD_BLOCK_MAX || hsize + comp > size)
+    goto corrupted;
+
+  p = src + hsize;
+  rem = comp;
+  if (type == ZSTD_LIT_COMPRESSED)
+    {
+      grub_ssize_t used = huf_read_table (ctx, p, rem);
+
+      if (used < 0)
+	return -1;
+      p += used;
+      rem -= used;
+    }
+  else if (!ctx->huf_log)
+    goto corrupted;
+
+  if (fmt == 0)
+    {
+      if (huf_decode_stream (ctx, p, rem, ctx->lit, regen))
+	return -1;
+    }
+  else
+    {
+      grub_size_t s1, s2, s3, seg;
+
+      if (rem < 6)
+	goto corrupted;
+      s1 = grub_le_to_cpu16 (grub_get_unaligned16 (p));
+      s2 = grub_le_to_cpu16 (grub_get_unaligned16 (p + 2));
+      s3 = grub_le_to_cpu16 (grub_get_unaligned16 (p + 4));
+      p += 6;
+      rem -= 6;
+      seg = (regen + 3) / 4;
+      if (s1 + s2 + s3 > rem || seg * 3 > regen)
+	goto corrupted;
+      if (huf_decode_stream (ctx, p, s1, ctx->lit, seg)
+	  || huf_decode_stream (ctx, p + s1, s2, ctx->lit + seg, seg)
+	  || huf_decode_stream (ctx, p + s1 + s2, s3, ctx->lit + 2 * seg, seg)
+	  || huf_decode_stream (ctx, p + s1 + s2 + s3, rem - s1 - s2 - s3,
+				ctx->lit + 3 * seg, regen - 3 * seg))
+	return -1;
+    }
+
+  *lit = ctx->lit;
+  *nlit = regen;
+  return hsize + comp;
+
+ corrupted:
+  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: corrupted literals");
+  return -1;
+}
+
+static grub_ssize_t
+seq_table (struct zstd_fse_table *t, unsigned mode, const grub_uint8_t *src,
+	   grub_size_t size, const grub_int16_t *def, unsigned def_log,
+	   unsigned max_symbol, unsigned max_log)
+{
+  switch (mode)
+    {
+    case ZSTD_MODE_PREDEFINED:
+      if (fse_build (t, def, max_symbol, def_log))
+	return -1;
+      return 0;
+
+    case ZSTD_MODE_RLE:
+      if (size < 1 || src[0] > max_symbol)
+	break;
+      fse_build_rle (t, src[0]);
+      return 1;
+
+    case ZSTD_MODE_FSE:
+      {
+	grub_int16_t norm[ZSTD_ML_MAX_SYMBOL + 1];
+	grub_ssize_t hdr;
+	unsigned log;
+
+	hdr = fse_read_header (src, size, norm, max_symbol, max_log, &log);
+	if (hdr < 0 || fse_build (t, norm, max_symbol, log))
+	  return -1;
+	return hdr;
+      }
+
+    case ZSTD_MODE_REPEAT:
+      if (!t->valid)
+	break;
+      return 0;
+    }
+
+  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: corrupted sequences");
+  return -1;
+}
+
+/* Copy a match of LEN bytes from OFF bytes back; the areas may overlap.  */
+static inline void
+copy_match (grub_uint8_t *op, grub_size_t off, grub_size_t len)
+{
+  const grub_uint8_t *m = op - off;
+
+  if (off >= 8)
+    {
+      for (; len >= 8; len -= 8, op += 8, m += 8)
+	grub_set_unaligned64 (op, grub_get_unaligned64 (m));
+    }
+  while (len--)
+    *op++ = *m++;
+}
+
+/* Decode the sequences section and execute it.  Output goes to *OP_IO up to
+   OEND and history starts at OSTART.  Sets *FULL when OEND was reached.  */
+static grub_err_t
+decode_sequences (struct zstd_ctx *ctx, const grub_uint8_t *src,
+		  grub_size_t size, const grub_uint8_t *lit, grub_size_t nlit,
+		  grub_uint8_t *ostart, grub_uint8_t **op_io,
+		  grub_uint8_t *oend, int *full)
+{
+  grub_uint8_t *op = *op_io;
+  grub_size_t nseq, p, litpos = 0, i, n;
+  unsigned sll, sof, sml;
+  struct zstd_bits b;
+  grub_ssize_t r;
+  grub_uint8_t modes;
+
+  if (size < 1)
+    goto corrupted;
+  if (src[0] < 128)
+    {
+      nseq = src[0];
+      p = 1;
+    }
+  else if (src[0] < 255)
+    {
+      if (size < 2)
+	goto corrupted;
+      nseq = ((src[0] - 128) << 8) + src[1];
+      p = 2;
+    }
+  else
+    {
+      if (size < 3)
+	goto corrupted;
+      nseq = src[1] + (src[2] << 8) + 0x7f00;
+      p = 3;
+    }
+
+  if (nseq == 0)
+    goto last_literals;
+
+  if (p >= size)
+    goto corrupted;
+  modes = src[p++];
+  if (modes & 3)
+    goto corrupted;
+
+  r = seq_table (&ctx->ll, modes >> 6, src + p, size - p, ll_default,
+		 ZSTD_LL_DEFAULT_LOG, ZSTD_LL_MAX_SYMBOL, ZSTD_LL_MAX_LOG);
+  if (r < 0)
+    return grub_errno;
+  p += r;
+  r = seq_table (&ctx->of, (modes >> 4) & 3, src + p, size - p, of_default,
+		 ZSTD_OF_DEFAULT_LOG, ZSTD_OF_MAX_SYMBOL, ZSTD_OF_MAX_LOG);
+  if (r < 0)
+    return grub_errno;
+  p += r;
+  r = seq_table (&ctx->ml, (modes >> 2) & 3, src + p, size - p, ml_default,
+		 ZSTD_ML_DEFAULT_LOG, ZSTD_ML_MAX_SYMBOL, ZSTD_ML_MAX_LOG);
+  if (r < 0)
+    return grub_errno;
+  p += r;
+
+  if (bits_init (&b, src + p, size - p))
+    return grub_errno;
+  sll = bits_read (&b, ctx->ll.log);
+  sof = bits_read (&b, ctx->of.log);
+  sml = bits_read (&b, ctx->ml.log);
+
+  for (i = 0; i < nseq; i++)
+    {
+      const struct zstd_fse_entry *le = &ctx->ll.e[sll];
+      const struct zstd_fse_entry *oe = &ctx->of.e[sof];
+      const struct zstd_fse_entry *me = &ctx->ml.e[sml];
+      grub_size_t ll, ml, off;
+
+      /* A refilled container has at least 57 bits: enough for the offset,
+	 and after the next refill for both lengths (16 bits each at most).  */
+      if (bits_reload (&b))
+	goto corrupted;
+      off = ((grub_size_t) 1 << oe->symbol) + bits_read (&b, oe->symbol);
+      if (bits_reload (&b))
+	goto corrupted;
+      ml = ml_base[me->symbol] + bits_read (&b, ml_bits[me->symbol]);
+      ll = ll_base[le->symbol] + bits_read (&b, ll_bits[le->symbol]);
+
+      /* Repeat offsets, RFC 8878 section 3.1.2.5.  */
+      if (oe->symbol > 1)
+	{
+	  off -= 3;
+	  ctx->rep[2] = ctx->rep[1];
+	  ctx->rep[1] = ctx->rep[0];
+	  ctx->rep[0] = off;
+	}
+      else
+	{
+	  unsigned idx = off - 1 + (ll == 0);
+
+	  if (idx == 0)
+	    off = ctx->rep[0];
+	  else
+	    {
+	      off = idx == 3 ? ctx->rep[0] - 1 : ctx->rep[idx];
+	      if (idx > 1)
+		ctx->rep[2] = ctx->rep[1];
+	      ctx->rep[1] = ctx->rep[0];
+	      ctx->rep[0] = off;
+	    }
+	}
+
+      if (i + 1 < nseq)
+	{
+	  if (bits_reload (&b))
+	    goto corrupted;
+	  sll = le->base + bits_read (&b, le->nbits);
+	  sml = me->base + bits_read (&b, me->nbits);
+	  sof = oe->base + bits_read (&b, oe->nbits);
+	}
+
+      if (ll > nlit - litpos)
+	goto corrupted;
+      n = ll;
+      if (n > (grub_size_t) (oend - op))
+	n = oend - op;
+      grub_memcpy (op, lit + litpos, n);
+      op += n;
+      litpos += ll;
+      if (n < ll)
+	goto full;
+
+      if (off == 0 || off > (grub_size_t) (op - ostart))
+	goto corrupted;
+      n = ml;
+      if (n > (grub_size_t) (oend - op))
+	n = oend - op;
+      copy_match (op, off, n);
+      op += n;
+      if (n < ml)
+	goto full;
+    }
+
+  if (bits_reload (&b) || !bits_finished (&b))
+    goto corrupted;
+
+ last_literals:
+  n = nlit - litpos;
+  if (n > (grub_size_t) (oend - op))
+    n = oend - op;
+  grub_memcpy (op, lit + litpos, n);
+  op += n;
+  if (n < nlit - litpos)
+    goto full;
+  *op_io = op;
+  return GRUB_ERR_NONE;
+
+ full:
+  *op_io = op;
+  *full = 1;
+  return GRUB_ERR_NONE;
+
+ corrupted:
+  return grub_error (GRUB_ERR_BAD_COMPRESSED_DATA,
+		     "zstd: corrupted sequences");
+}
+
+/* Decode every frame in SRC into OUT, stopping once CAP bytes were
+   produced.  Returns the number of bytes produced or -1.  */
+static grub_ssize_t
+zstd_decode (struct zstd_ctx *ctx, const grub_uint8_t *src, grub_size_t size,
+	     grub_uint8_t *out, grub_size_t cap)
+{
+  static const grub_uint8_t did_size[4] = { 0, 1, 2, 4 };
+  static const grub_uint8_t fcs_size[4] = { 0, 2, 4, 8 };
+  grub_uint8_t *op = out, *oend = out + cap;
+  int nframes = 0, full = 0;
+
+  while (!full && size >= 4)
+    {
+      grub_uint32_t magic = grub_le_to_cpu32 (grub_get_unaligned32 (src));
+      grub_uint8_t *fstart = op;
+      grub_size_t p, n, i;
+      grub_uint8_t fhd;
+      int last, checksum;
+
+      if ((magic & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC)
+	{
+	  if (size < 8)
+	    goto corrupted;
+	  n = grub_le_to_cpu32 (grub_get_unaligned32 (src + 4));
+	  if (n > size - 8)
+	    goto corrupted;
+	  src += 8 + n;
+	  size -= 8 + n;
+	  continue;
+	}
+      if (magic != ZSTD_MAGIC)
+	{
+	  /* Compressed extents are padded, ignore what follows the data.  */
+	  if (nframes)
+	    break;
+	  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: no frame found");
+	  return -1;
+	}
+
+      if (size < 5)
+	goto corrupted;
+      fhd = src[4];
+      if (fhd & 0x08)
+	goto corrupted;
+      p = 5;
+      /* Window descriptor, only present for multi-segment frames.  */
+      if (!(fhd & 0x20))
+	p++;
+      if (p + did_size[fhd & 3] > size)
+	goto corrupted;
+      for (i = 0; i < did_size[fhd & 3]; i++)
+	if (src[p + i])
+	  {
+	    grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
+			"zstd: dictionaries are not supported");
+	    return -1;
+	  }
+      p += did_size[fhd & 3];
+      if ((fhd >> 6) == 0 && (fhd & 0x20))
+	p += 1;
+      else
+	p += fcs_size[fhd >> 6];
+      checksum = (fhd >> 2) & 1;
+
+      ctx->rep[0] = 1;
+      ctx->rep[1] = 4;
+      ctx->rep[2] = 8;
+      ctx->huf_log = 0;
+      ctx->ll.valid = ctx->of.valid = ctx->ml.valid = 0;
+
+      do
+	{
+	  grub_uint32_t bh;
+	  grub_size_t bsize;
+
+	  if (p + 3 > size)
+	    goto corrupted;
+	  bh = get_le24 (src + p);
+	  p += 3;
+	  last = bh & 1;
+	  bsize = bh >> 3;
+	  if (bsize > ZSTD_BLOCK_MAX)
+	    goto corrupted;
+
+	  switch ((bh >> 1) & 3)
+	    {
+	    case ZSTD_BLOCK_RAW:
+	      if (p + bsize > size)
+		goto corrupted;
+	      n = bsize;
+	      if (n > (grub_size_t) (oend - op))
+		{
+		  n = oend - op;
+		  full = 1;
+		}
+	      grub_memcpy (op, src + p, n);
+	      op += n;
+	      p += bsize;
+	      break;
+
+	    case ZSTD_BLOCK_RLE:
+	      if (p + 1 > size)
+		goto corrupted;
+	      n = bsize;
+	      if (n > (grub_size_t) (oend - op))
+		{
+		  n = oend - op;
+		  full = 1;
+		}
+	      grub_memset (op, src[p], n);
+	      op += n;
+	      p += 1;
+	      break;
+
+	    case ZSTD_BLOCK_COMPRESSED:
+	      {
+		const grub_uint8_t *lit;
+		grub_size_t nlit;
+		grub_ssize_t used;
+
+		if (p + bsize > size)
+		  goto corrupted;
+		used = decode_literals (ctx, src + p, bsize, &lit, &nlit);
+		if (used < 0)
+		  return -1;
+		if (decode_sequences (ctx, src + p + used, bsize - used,
+				      lit, nlit, fstart, &op, oend, &full))
+		  return -1;
+		p += bsize;
+		break;
+	      }
+
+	    default:
+	      goto corrupted;
+	    }
+	}
+      while (!last && !full);
+
+      if (!full && checksum)
+	p += 4;
+      if (p > size)
+	goto corrupted;
+      src += p;
+      size -= p;
+      nframes++;
+    }
+
+  if (!nframes && !full)
+    goto corrupted;
+  return op - out;
+
+ corrupted:
+  grub_error (GRUB_ERR_BAD_COMPRESSED_DATA, "zstd: corrupted frame");
+  return -1;
+}
+
+grub_ssize_t
+grub_zstd_decompress (const void *inbuf, grub_size_t insize, grub_off_t off,
+		      void *outbuf, grub_size_t outsize)
+{
+  struct zstd_ctx *ctx;
+  grub_uint8_t *tmp = NULL;
+  grub_ssize_t ret;
+
+  ctx = grub_malloc (sizeof (*ctx));
+  if (!ctx)
+    return -1;
+
+  /* Matches may reach into the skipped part, so it has to be produced.  */
+  if (off)
+    {
+      if (off + outsize < off)
+	{
+	  grub_free (ctx);
+	  grub_error (GRUB_ERR_OUT_OF_RANGE, "zstd: offset too large");
+	  return -1;
+	}
+      tmp = grub_malloc (off + outsize);
+      if (!tmp)
+	{
+	  grub_free (ctx);
+	  return -1;
+	}
+      ret = zstd_decode (ctx, inbuf, insize, tmp, off + outsize);
+      if (ret >= 0)
+	{
+	  ret = (grub_off_t) ret > off ? ret - (grub_ssize_t) off : 0;
+	  grub_memcpy (outbuf, tmp + off, ret);
+	}
+      grub_free (tmp);
+    }
+  else
+    ret = zstd_decode (ctx, inbuf, insize, outbuf, outsize);
+
+  grub_free (ctx);
+  return ret;
+}
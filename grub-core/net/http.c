@@ -26,14 +26,51 @@
 #include <grub/dl.h>
 #include <grub/file.h>
 #include <grub/i18n.h>
+#include <grub/env.h>
+#include <grub/time.h>
+#include <grub/loader.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
 enum
   {
-    HTTP_PORT = 80
+    HTTP_PORT = 80,
+    /* Idle keep-alive connections kept around for later requests.  */
+    HTTP_MAX_IDLE_CONNS = 4,
+    /* A connection is only reused if no more than this much of the
+       previous response is left to skip.  Past that a new handshake is
+       cheaper.  */
+    HTTP_MAX_DISCARD = 65536,
+    /* Parallel downloads split the file into chunks of this size.  */
+    HTTP_RANGE_SIZE = 1 << 20,
+    HTTP_MAX_CONNECTIONS = 16,
+    /* A parallel connection that can't be opened is tried again after
+       HTTP_DIAL_DELAY ms, twice as long after each further failure, and
+       given up after HTTP_MAX_DIAL_FAILURES.  */
+    HTTP_DIAL_DELAY = 500,
+    HTTP_MAX_DIAL_FAILURES = 4
   };
 
+struct http_data;
+
+/* A TCP connection to an HTTP server.  Once a file is done with it, the
+   connection goes to the idle pool if the server allows it.  */
+struct http_conn
+{
+  struct http_conn *next;
+  struct http_conn **prev;
+  char *server;
+  grub_net_tcp_socket_t sock;
+  /* File and response being received, NULL while idle.  */
+  grub_file_t file;
+  struct http_data *data;
+  /* Bytes left of an abandoned response.  A new request may already be
+     pipelined behind them.  */
+  grub_uint64_t discard;
+  int closed;
+};
+
+static struct http_conn *idle_conns;
 
 typedef struct http_data
 {
@@ -42,15 +79,77 @@ typedef struct http_data
   int headers_recv;
   int first_line_recv;
   int size_recv;
-  grub_net_tcp_socket_t sock;
+  struct http_conn *conn;
   char *filename;
   grub_err_t err;
   char *errmsg;
   int chunked;
   grub_size_t chunk_rem;
   int in_chunk_len;
+  int have_length;
+  grub_uint64_t content_length;
+  grub_uint64_t body_rem;
+  int conn_close;
+  int partial;
+  /* The server has nothing at or after the offset asked for.  */
+  int past_end;
+  /* Content-Range of a partial response, [range_start, range_end].  */
+  int have_range;
+  grub_uint64_t range_start;
+  grub_uint64_t range_end;
+  grub_uint64_t range_total;
+  /* Chunk this response belongs to in a parallel download.  */
+  struct http_range *range;
+  /* Parallel download state of the file.  */
+  struct http_ranges *ranges;
 } *http_data_t;
 
+/* One connection of a parallel download.  */
+struct http_range
+{
+  struct http_data resp;
+  /* Chunk being fetched, [start, end).  */
+  grub_off_t start;
+  grub_off_t end;
+  /* Data that arrived before the reader got to this chunk.  */
+  grub_net_packets_t packs;
+  int busy;
+  int done;
+  /* Failed attempts at opening a connection, and when to try next.  */
+  unsigned dial_failures;
+  grub_uint64_t dial_after;
+};
+
+struct http_ranges
+{
+  unsigned count;
+  /* Start of the chunk being handed to the reader.  */
+  grub_off_t head;
+  /* First byte not requested yet.  */
+  grub_off_t next;
+  int failed;
+  struct http_range range[0];
+};
+
+static void
+http_ranges_advance (grub_file_t file);
+static void
+http_ranges_fail (grub_file_t file);
+
+/* Whether DATA is a usable answer to a request for [START, END) of
+   FILE.  Anything else, be it a shorter or shifted range or a file that
+   changed size meanwhile, would end up at the wrong offset.  */
+static int
+http_range_ok (grub_file_t file, http_data_t data,
+	       grub_off_t start, grub_off_t end)
+{
+  return (!data->err && data->partial && !data->chunked && data->have_length
+	  && data->have_range && data->range_start == start
+	  && data->range_end + 1 == end
+	  && data->content_length == end - start
+	  && data->range_total == file->size);
+}
+
 static grub_off_t
 have_ahead (struct grub_file *file)
 {
@@ -62,6 +161,62 @@ have_ahead (struct grub_file *file)
   return ret;
 }
 
+static void
+http_body_done (grub_file_t file, http_data_t data)
+{
+  if (data->range)
+    {
+      if (!http_range_ok (file, data, data->range->start, data->range->end))
+	{
+	  http_ranges_fail (file);
+	  return;
+	}
+      data->range->done = 1;
+      http_ranges_advance (file);
+      return;
+    }
+  file->device->net->eof = 1;
+  file->device->net->stall = 1;
+}
+
+/* A range from offset 0 of an empty file, or from the end of a file,
+   can't be satisfied.  Whatever body follows only describes the
+   error.  */
+static void
+http_past_end (grub_file_t file, http_data_t data)
+{
+  data->conn_close = 1;
+  if (data->range)
+    {
+      http_ranges_fail (file);
+      return;
+    }
+  file->device->net->eof = 1;
+  file->device->net->stall = 1;
+  if (file->size == GRUB_FILE_SIZE_UNKNOWN)
+    file->size = have_ahead (file);
+}
+
+static void
+http_deliver (grub_file_t file, http_data_t data, struct grub_net_buff *nb)
+{
+  grub_net_t net = file->device->net;
+
+  if (data->range
+      && data->range->start != ((http_data_t) file->data)->ranges->head)
+    {
+      grub_net_put_packet (&data->range->packs, nb);
+      return;
+    }
+
+  grub_net_put_packet (&net->packs, nb);
+  if (net->packs.count >= 20)
+    net->stall = 1;
+
+  if (net->packs.count >= 100)
+    grub_net_tcp_stall (data->conn->sock);
+}
+
 static grub_err_t
 parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
 {
@@ -92,8 +247,16 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
   if (ptr == end)
     {
       data->headers_recv = 1;
-      if (data->chunked)
+      if (data->past_end)
+	http_past_end (file, data);
+      else if (data->chunked)
 	data->in_chunk_len = 2;
+      else if (data->have_length)
+	{
+	  data->body_rem = data->content_length;
+	  if (!data->body_rem)
+	    http_body_done (file, data);
+	}
       return GRUB_ERR_NONE;
     }
 
@@ -110,11 +273,15 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
       code = grub_strtoul (ptr, &ptr, 10);
       if (grub_errno)
 	return grub_errno;
+      data->partial = (code == 206);
       switch (code)
 	{
 	case 200:
 	case 206:
 	  break;
+	case 416:
+	  data->past_end = 1;
+	  break;
 	case 404:
 	  data->err = GRUB_ERR_FILE_NOT_FOUND;
 	  data->errmsg = grub_xasprintf (_("file `%s' not found"), data->filename);
@@ -131,13 +298,42 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
       return GRUB_ERR_NONE;
     }
   if (grub_memcmp (ptr, "Content-Length: ", sizeof ("Content-Length: ") - 1)
-      == 0 && !data->size_recv)
+      == 0)
     {
       ptr += sizeof ("Content-Length: ") - 1;
-      file->size = grub_strtoull (ptr, &ptr, 10);
+      data->content_length = grub_strtoull (ptr, &ptr, 10);
+      data->have_length = 1;
+      if (!data->size_recv && !data->past_end)
+	file->size = data->content_length;
       data->size_recv = 1;
       return GRUB_ERR_NONE;
     }
+  if (grub_memcmp (ptr, "Content-Range: bytes ",
+		   sizeof ("Content-Range: bytes ") - 1) == 0)
+    {
+      ptr += sizeof ("Content-Range: bytes ") - 1;
+      if (*ptr != '*')
+	{
+	  data->range_start = grub_strtoull (ptr, &ptr, 10);
+	  if (*ptr == '-')
+	    {
+	      data->range_end = grub_strtoull (ptr + 1, &ptr, 10);
+	      data->have_range = (*ptr == '/'
+				  && data->range_end >= data->range_start);
+	    }
+	}
+      ptr = grub_strchr (ptr, '/');
+      if (ptr && ptr[1] != '*')
+	data->range_total = grub_strtoull (ptr + 1, 0, 10);
+      grub_errno = GRUB_ERR_NONE;
+      return GRUB_ERR_NONE;
+    }
+  if (grub_memcmp (ptr, "Connection: close",
+		   sizeof ("Connection: close") - 1) == 0)
+    {
+      data->conn_close = 1;
+      return GRUB_ERR_NONE;
+    }
   if (grub_memcmp (ptr, "Transfer-Encoding: chunked",
 		   sizeof ("Transfer-Encoding: chunked") - 1) == 0)
     {
@@ -149,18 +345,50 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
 }
 
 static void
-http_err (grub_net_tcp_socket_t sock __attribute__ ((unused)),
-	  void *f)
+http_conn_free (struct http_conn *conn)
+{
+  grub_list_remove (GRUB_AS_LIST (conn));
+  grub_net_tcp_close (conn->sock, GRUB_NET_TCP_ABORT);
+  grub_free (conn->server);
+  grub_free (conn);
+}
+
+static void
+http_abort (http_data_t data)
+{
+  data->conn->closed = 1;
+  grub_net_tcp_close (data->conn->sock, GRUB_NET_TCP_ABORT);
+}
+
+/* Called when a connection of a parallel download breaks or gets an
+   unusable answer.  Receive hooks can't open connections, so this only
+   wakes the reader up; http_packets_pulled then fetches the rest over a
+   single connection.  */
+static void
+http_ranges_fail (grub_file_t file)
 {
-  grub_file_t file = f;
   http_data_t data = file->data;
 
-  if (data->sock)
-    grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
-  data->sock = 0;
+  data->ranges->failed = 1;
+  file->device->net->eof = 1;
+  file->device->net->stall = 1;
+}
+
+static void
+http_err (grub_file_t file, http_data_t data)
+{
+  if (!data->conn->closed)
+    http_abort (data);
   if (data->current_line)
     grub_free (data->current_line);
   data->current_line = 0;
+  if (data->range)
+    {
+      /* Servers may close a keep-alive connection between two chunks.  */
+      if (!data->range->done)
+	http_ranges_fail (file);
+      return;
+    }
   file->device->net->eof = 1;
   file->device->net->stall = 1;
   if (file->size == GRUB_FILE_SIZE_UNKNOWN)
@@ -168,15 +396,11 @@ http_err (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 }
 
 static grub_err_t
-http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
-	      struct grub_net_buff *nb,
-	      void *f)
+http_receive (grub_file_t file, http_data_t data, struct grub_net_buff *nb)
 {
-  grub_file_t file = f;
-  http_data_t data = file->data;
   grub_err_t err;
 
-  if (!data->sock)
+  if (data->conn->closed)
     {
       grub_netbuff_free (nb);
       return GRUB_ERR_NONE;
@@ -202,7 +426,7 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	  if (!t)
 	    {
 	      grub_netbuff_free (nb);
-	      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+	      http_abort (data);
 	      return grub_errno;
 	    }
 	      
@@ -222,7 +446,7 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	  data->current_line_len = 0;
 	  if (err)
 	    {
-	      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+	      http_abort (data);
 	      grub_netbuff_free (nb);
 	      return err;
 	    }
@@ -239,7 +463,7 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	      if (!data->current_line)
 		{
 		  grub_netbuff_free (nb);
-		  grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+		  http_abort (data);
 		  return grub_errno;
 		}
 	      data->current_line_len = (char *) nb->tail - ptr;
@@ -250,13 +474,28 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	  err = parse_line (file, data, ptr, ptr2 - ptr);
 	  if (err)
 	    {
-	      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+	      http_abort (data);
 	      grub_netbuff_free (nb);
 	      return err;
 	    }
 	  ptr = ptr2 + 1;
 	}
 
+      if (data->range && data->headers_recv
+	  && !http_range_ok (file, data, data->range->start, data->range->end))
+	{
+	  grub_netbuff_free (nb);
+	  http_abort (data);
+	  http_ranges_fail (file);
+	  return GRUB_ERR_NONE;
+	}
+
+      if (data->past_end && data->headers_recv)
+	{
+	  grub_netbuff_free (nb);
+	  return GRUB_ERR_NONE;
+	}
+
       if (((char *) nb->tail - ptr) <= 0)
 	{
 	  grub_netbuff_free (nb);
@@ -265,22 +504,33 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
       err = grub_netbuff_pull (nb, ptr - (char *) nb->data);
       if (err)
 	{
-	  grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+	  http_abort (data);
 	  grub_netbuff_free (nb);
 	  return err;
 	}
+      if (!data->chunked && data->have_length)
+	{
+	  if ((grub_uint64_t) (nb->tail - nb->data) > data->body_rem)
+	    {
+	      /* Whatever follows the body wasn't asked for.  */
+	      nb->tail = nb->data + data->body_rem;
+	      data->conn_close = 1;
+	    }
+	  data->body_rem -= nb->tail - nb->data;
+	  if (nb->tail == nb->data)
+	    grub_netbuff_free (nb);
+	  else
+	    http_deliver (file, data, nb);
+	  if (!data->body_rem)
+	    http_body_done (file, data);
+	  return GRUB_ERR_NONE;
+	}
       if (!(data->chunked && (grub_ssize_t) data->chunk_rem
 	    < nb->tail - nb->data))
 	{
-	  grub_net_put_packet (&file->device->net->packs, nb);
-	  if (file->device->net->packs.count >= 20)
-	    file->device->net->stall = 1;
-
-	  if (file->device->net->packs.count >= 100)
-	    grub_net_tcp_stall (data->sock);
-
 	  if (data->chunked)
 	    data->chunk_rem -= nb->tail - nb->data;
+	  http_deliver (file, data, nb);
 	  return GRUB_ERR_NONE;
 	}
       if (data->chunk_rem)
@@ -294,7 +544,7 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	  if (file->device->net->packs.count >= 20)
 	    {
 	      file->device->net->stall = 1;
-	      grub_net_tcp_stall (data->sock);
+	      grub_net_tcp_stall (data->conn->sock);
 	    }
 
 	  grub_net_put_packet (&file->device->net->packs, nb2);
@@ -305,25 +555,144 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 }
 
 static grub_err_t
-http_establish (struct grub_file *file, grub_off_t offset, int initial)
+http_conn_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
+		   struct grub_net_buff *nb,
+		   void *c)
+{
+  struct http_conn *conn = c;
+
+  if (conn->discard)
+    {
+      grub_size_t len = nb->tail - nb->data;
+      if (len > conn->discard)
+	len = conn->discard;
+      conn->discard -= len;
+      grub_netbuff_pull (nb, len);
+    }
+  if (nb->tail == nb->data)
+    {
+      grub_netbuff_free (nb);
+      return GRUB_ERR_NONE;
+    }
+  if (!conn->file)
+    {
+      /* Nothing was asked for.  */
+      grub_netbuff_free (nb);
+      http_conn_free (conn);
+      return GRUB_ERR_NONE;
+    }
+  return http_receive (conn->file, conn->data, nb);
+}
+
+static void
+http_conn_err (grub_net_tcp_socket_t sock __attribute__ ((unused)),
+	       void *c)
+{
+  struct http_conn *conn = c;
+
+  if (conn->file)
+    http_err (conn->file, conn->data);
+  else
+    http_conn_free (conn);
+}
+
+static struct http_conn *
+http_conn_get (const char *server, int *reused)
+{
+  struct http_conn *conn, *next;
+
+  FOR_LIST_ELEMENTS_SAFE (conn, next, idle_conns)
+    {
+      /* The address the connection went out from may have been removed
+	 since.  */
+      if (!grub_net_tcp_usable (conn->sock))
+	{
+	  http_conn_free (conn);
+	  continue;
+	}
+      if (!conn->closed && grub_strcmp (conn->server, server) == 0)
+	{
+	  grub_list_remove (GRUB_AS_LIST (conn));
+	  *reused = 1;
+	  return conn;
+	}
+    }
+
+  *reused = 0;
+  conn = grub_zalloc (sizeof (*conn));
+  if (!conn)
+    return NULL;
+  conn->server = grub_strdup (server);
+  if (!conn->server)
+    {
+      grub_free (conn);
+      return NULL;
+    }
+  conn->sock = grub_net_tcp_open (conn->server, HTTP_PORT, http_conn_receive,
+				  http_conn_err, http_conn_err, conn);
+  if (!conn->sock)
+    {
+      grub_free (conn->server);
+      grub_free (conn);
+      return NULL;
+    }
+  return conn;
+}
+
+/* Detach DATA from its connection.  The connection goes back to the idle
+   pool when the rest of the response is known and short enough to skip;
+   otherwise it is closed.  */
+static void
+http_conn_release (http_data_t data)
+{
+  struct http_conn *conn = data->conn, *idle;
+  int nidle = 0;
+
+  if (!conn)
+    return;
+  data->conn = NULL;
+  conn->file = NULL;
+  conn->data = NULL;
+
+  FOR_LIST_ELEMENTS (idle, idle_conns)
+    nidle++;
+
+  if (conn->closed || !data->headers_recv || data->err || data->conn_close
+      || data->chunked || !data->have_length
+      || data->body_rem > HTTP_MAX_DISCARD
+      || nidle >= HTTP_MAX_IDLE_CONNS)
+    {
+      http_conn_free (conn);
+      return;
+    }
+
+  conn->discard = data->body_rem;
+  grub_net_tcp_unstall (conn->sock);
+  grub_list_push (GRUB_AS_LIST_P (&idle_conns), GRUB_AS_LIST (conn));
+}
+
+/* Build a GET request for FILENAME.  With RANGE set only the bytes from
+   OFFSET up to END, or to the end of the file if END is 0, are asked
+   for.  */
+static struct grub_net_buff *
+http_build_request (struct grub_file *file, const char *filename,
+		    grub_off_t offset, grub_off_t end, int range)
 {
-  http_data_t data = file->data;
   grub_uint8_t *ptr;
-  int i;
   struct grub_net_buff *nb;
   grub_err_t err;
 
   nb = grub_netbuff_alloc (GRUB_NET_TCP_RESERVE_SIZE
 			   + sizeof ("GET ") - 1
-			   + grub_strlen (data->filename)
+			   + grub_strlen (filename)
 			   + sizeof (" HTTP/1.1\r\nHost: ") - 1
 			   + grub_strlen (file->device->net->server)
 			   + sizeof ("\r\nUser-Agent: " PACKAGE_STRING
 				     "\r\n") - 1
 			   + sizeof ("Range: bytes=XXXXXXXXXXXXXXXXXXXX"
-				     "-\r\n\r\n"));
+				     "-XXXXXXXXXXXXXXXXXXXX\r\n\r\n"));
   if (!nb)
-    return grub_errno;
+    return NULL;
 
   grub_netbuff_reserve (nb, GRUB_NET_TCP_RESERVE_SIZE);
   ptr = nb->tail;
@@ -331,26 +700,26 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, "GET ", sizeof ("GET ") - 1);
 
   ptr = nb->tail;
 
-  err = grub_netbuff_put (nb, grub_strlen (data->filename));
+  err = grub_netbuff_put (nb, grub_strlen (filename));
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
-  grub_memcpy (ptr, data->filename, grub_strlen (data->filename));
+  grub_memcpy (ptr, filename, grub_strlen (filename));
 
   ptr = nb->tail;
   err = grub_netbuff_put (nb, sizeof (" HTTP/1.1\r\nHost: ") - 1);
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, " HTTP/1.1\r\nHost: ",
 	       sizeof (" HTTP/1.1\r\nHost: ") - 1);
@@ -360,7 +729,7 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, file->device->net->server,
 	       grub_strlen (file->device->net->server));
@@ -372,11 +741,21 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, "\r\nUser-Agent: " PACKAGE_STRING "\r\n",
 	       sizeof ("\r\nUser-Agent: " PACKAGE_STRING "\r\n") - 1);
-  if (!initial)
+  if (range && end)
+    {
+      ptr = nb->tail;
+      grub_snprintf ((char *) ptr,
+		     sizeof ("Range: bytes=XXXXXXXXXXXXXXXXXXXX-"
+			     "XXXXXXXXXXXXXXXXXXXX\r\n"),
+		     "Range: bytes=%" PRIuGRUB_UINT64_T "-%" PRIuGRUB_UINT64_T
+		     "\r\n", offset, end - 1);
+      grub_netbuff_put (nb, grub_strlen ((char *) ptr));
+    }
+  else if (range)
     {
       ptr = nb->tail;
       grub_snprintf ((char *) ptr,
@@ -390,26 +769,40 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   grub_netbuff_put (nb, 2);
   grub_memcpy (ptr, "\r\n", 2);
 
-  data->sock = grub_net_tcp_open (file->device->net->server,
-				  HTTP_PORT, http_receive,
-				  http_err, http_err,
-				  file);
-  if (!data->sock)
+  return nb;
+}
+
+static grub_err_t
+http_establish_real (struct grub_file *file, grub_off_t offset,
+		     grub_off_t end, int range, int *reused)
+{
+  http_data_t data = file->data;
+  int i;
+  struct grub_net_buff *nb;
+  grub_err_t err;
+
+  nb = http_build_request (file, data->filename, offset, end, range);
+  if (!nb)
+    return grub_errno;
+
+  data->conn = http_conn_get (file->device->net->server, reused);
+  if (!data->conn)
     {
       grub_netbuff_free (nb);
       return grub_errno;
     }
+  data->conn->file = file;
+  data->conn->data = data;
 
-  //  grub_net_poll_cards (5000);
-
-  err = grub_net_send_tcp_packet (data->sock, nb, 1);
+  err = grub_net_send_tcp_packet (data->conn->sock, nb, 1);
   if (err)
     {
-      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+      http_conn_free (data->conn);
+      data->conn = NULL;
       return err;
     }
 
-  for (i = 0; !data->headers_recv && i < 100; i++)
+  for (i = 0; !data->headers_recv && !data->conn->closed && i < 100; i++)
     {
       grub_net_tcp_retransmit ();
       grub_net_poll_cards (300, &data->headers_recv);
@@ -417,7 +810,8 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
 
   if (!data->headers_recv)
     {
-      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+      http_conn_free (data->conn);
+      data->conn = NULL;
       if (data->err)
 	{
 	  char *str = data->errmsg;
@@ -431,16 +825,341 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   return GRUB_ERR_NONE;
 }
 
+/* Forget whatever was received of a response before asking again.  */
+static void
+http_data_reset (http_data_t data)
+{
+  grub_free (data->current_line);
+  data->current_line = 0;
+  data->current_line_len = 0;
+  grub_free (data->errmsg);
+  data->errmsg = 0;
+  data->err = GRUB_ERR_NONE;
+  data->headers_recv = 0;
+  data->first_line_recv = 0;
+  data->chunked = 0;
+  data->chunk_rem = 0;
+  data->in_chunk_len = 0;
+  data->have_length = 0;
+  data->content_length = 0;
+  data->body_rem = 0;
+  data->conn_close = 0;
+  data->partial = 0;
+  data->have_range = 0;
+  data->range_start = 0;
+  data->range_end = 0;
+  data->range_total = 0;
+}
+
+static grub_err_t
+http_establish (struct grub_file *file, grub_off_t offset, grub_off_t end,
+		int range)
+{
+  http_data_t data = file->data;
+  grub_err_t err;
+  int reused;
+
+  err = http_establish_real (file, offset, end, range, &reused);
+
+  /* The server may have dropped an idle connection just as we reused it.
+     If nothing at all came back, try again on a new one.  */
+  if (err && reused && !data->first_line_recv)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      http_data_reset (data);
+      file->device->net->eof = 0;
+      file->device->net->stall = 0;
+      err = http_establish_real (file, offset, end, range, &reused);
+    }
+  return err;
+}
+
+/* Number of connections to download a file with, from
+   net_http_connections.  */
+static unsigned
+http_connections (void)
+{
+  const char *val = grub_env_get ("net_http_connections");
+  unsigned long n;
+
+  if (!val)
+    return 1;
+  n = grub_strtoul (val, 0, 0);
+  grub_errno = GRUB_ERR_NONE;
+  if (n < 1)
+    return 1;
+  if (n > HTTP_MAX_CONNECTIONS)
+    return HTTP_MAX_CONNECTIONS;
+  return n;
+}
+
+/* Ask for the next chunk on RANGE.  */
+static grub_err_t
+http_range_request (grub_file_t file, struct http_range *range)
+{
+  http_data_t data = file->data;
+  struct http_ranges *ranges = data->ranges;
+  struct http_conn *conn = range->resp.conn;
+  struct grub_net_buff *nb;
+  int reused;
+
+  if (conn && (conn->closed || range->resp.conn_close))
+    {
+      http_conn_free (conn);
+      conn = NULL;
+    }
+  if (!conn)
+    {
+      range->resp.conn = NULL;
+      conn = http_conn_get (file->device->net->server, &reused);
+      if (!conn)
+	return grub_errno;
+      /* Other connections may have taken the last chunk meanwhile.  */
+      if (ranges->next >= file->size)
+	{
+	  http_conn_free (conn);
+	  return GRUB_ERR_NONE;
+	}
+    }
+
+  range->start = ranges->next;
+  range->end = ranges->next + HTTP_RANGE_SIZE;
+  if (range->end > file->size)
+    range->end = file->size;
+  ranges->next = range->end;
+  range->busy = 1;
+  range->done = 0;
+
+  /* The previous response may have been cut off in the middle of a
+     line.  */
+  grub_free (range->resp.current_line);
+  grub_free (range->resp.errmsg);
+  grub_memset (&range->resp, 0, sizeof (range->resp));
+  range->resp.size_recv = 1;
+  range->resp.filename = data->filename;
+  range->resp.range = range;
+  range->resp.conn = conn;
+  conn->file = file;
+  conn->data = &range->resp;
+
+  nb = http_build_request (file, data->filename, range->start, range->end, 1);
+  if (!nb)
+    return grub_errno;
+  return grub_net_send_tcp_packet (conn->sock, nb, 1);
+}
+
+/* Give the chunks that are left to free connections.  TCP connections
+   can't be opened from receive hooks, so new ones are only set up if
+   CONNECT is set.  */
+static void
+http_ranges_refill (grub_file_t file, int connect)
+{
+  struct http_ranges *ranges = ((http_data_t) file->data)->ranges;
+  unsigned i;
+  int busy = 0;
+
+  for (i = 0; i < ranges->count && !ranges->failed; i++)
+    {
+      struct http_range *range = &ranges->range[i];
+      struct http_conn *conn = range->resp.conn;
+
+      if (range->busy)
+	{
+	  busy = 1;
+	  continue;
+	}
+      if (ranges->next >= file->size)
+	{
+	  http_conn_release (&range->resp);
+	  continue;
+	}
+      if ((!conn || conn->closed || range->resp.conn_close)
+	  && (!connect || range->dial_failures >= HTTP_MAX_DIAL_FAILURES
+	      || grub_get_time_ms () < range->dial_after))
+	continue;
+      if (http_range_request (file, range))
+	{
+	  if (range->busy)
+	    {
+	      http_ranges_fail (file);
+	      return;
+	    }
+	  /* Couldn't connect.  Make do with fewer connections for a
+	     while.  */
+	  grub_errno = GRUB_ERR_NONE;
+	  range->dial_after = grub_get_time_ms ()
+	    + (HTTP_DIAL_DELAY << range->dial_failures);
+	  range->dial_failures++;
+	  continue;
+	}
+      range->dial_failures = 0;
+      busy |= range->busy;
+    }
+
+  if (connect && !busy && ranges->head < file->size)
+    http_ranges_fail (file);
+}
+
+/* Hand over to the reader whatever has arrived for the chunk at the head
+   and move on to the next chunk once it is complete.  */
+static void
+http_ranges_advance (grub_file_t file)
+{
+  struct http_ranges *ranges = ((http_data_t) file->data)->ranges;
+  grub_net_t net = file->device->net;
+
+  if (ranges->failed)
+    return;
+
+  while (1)
+    {
+      struct http_range *range = NULL;
+      unsigned i;
+
+      for (i = 0; i < ranges->count; i++)
+	if (ranges->range[i].busy && ranges->range[i].start == ranges->head)
+	  range = &ranges->range[i];
+      if (!range)
+	break;
+
+      while (range->packs.first)
+	{
+	  grub_net_put_packet (&net->packs, range->packs.first->nb);
+	  grub_net_remove_packet (range->packs.first);
+	}
+      if (!range->done)
+	break;
+      ranges->head = range->end;
+      range->busy = 0;
+    }
+
+  if (net->packs.count >= 20)
+    net->stall = 1;
+  if (ranges->head >= file->size)
+    {
+      net->eof = 1;
+      net->stall = 1;
+      return;
+    }
+  http_ranges_refill (file, 0);
+}
+
+/* Switch to downloading the rest of the file over COUNT connections.  The
+   response already received covers the first chunk.  */
+static grub_err_t
+http_ranges_start (grub_file_t file, unsigned count)
+{
+  http_data_t data = file->data;
+  struct http_ranges *ranges;
+  struct http_range *first;
+
+  ranges = grub_zalloc (sizeof (*ranges) + count * sizeof (ranges->range[0]));
+  if (!ranges)
+    return grub_errno;
+  ranges->count = count;
+  ranges->head = 0;
+  ranges->next = data->content_length;
+
+  first = &ranges->range[0];
+  first->resp = *data;
+  first->resp.range = first;
+  first->start = 0;
+  first->end = data->content_length;
+  first->busy = 1;
+  first->done = !data->body_rem;
+  first->resp.conn->data = &first->resp;
+  data->conn = NULL;
+  data->ranges = ranges;
+
+  file->device->net->eof = 0;
+  file->device->net->stall = 0;
+
+  http_ranges_refill (file, 1);
+  http_ranges_advance (file);
+  return GRUB_ERR_NONE;
+}
+
+static void
+http_ranges_stop (grub_file_t file)
+{
+  http_data_t data = file->data;
+  struct http_ranges *ranges = data->ranges;
+  unsigned i;
+
+  if (!ranges)
+    return;
+
+  for (i = 0; i < ranges->count; i++)
+    {
+      struct http_range *range = &ranges->range[i];
+
+      while (range->packs.first)
+	{
+	  grub_netbuff_free (range->packs.first->nb);
+	  grub_net_remove_packet (range->packs.first);
+	}
+      grub_free (range->resp.current_line);
+      grub_free (range->resp.errmsg);
+      http_conn_release (&range->resp);
+    }
+  grub_free (ranges);
+  data->ranges = NULL;
+}
+
+/* Fetch the rest of the file over a single connection after a parallel
+   download failed, starting where the data handed to the reader ends.  */
+static grub_err_t
+http_ranges_fallback (grub_file_t file)
+{
+  http_data_t data = file->data;
+  grub_net_t net = file->device->net;
+  struct grub_net_packet *last = net->packs.last;
+  grub_off_t off = have_ahead (file);
+  grub_err_t err;
+
+  http_ranges_stop (file);
+  if (off >= file->size)
+    return GRUB_ERR_NONE;
+
+  http_data_reset (data);
+  data->size_recv = 1;
+  net->eof = 0;
+  net->stall = 0;
+  err = http_establish (file, off, 0, 1);
+  if (!err && !http_range_ok (file, data, off, file->size))
+    {
+      /* Drop whatever came of the wrong part of the file.  */
+      http_conn_release (data);
+      while (net->packs.last != last)
+	{
+	  grub_netbuff_free (net->packs.last->nb);
+	  grub_net_remove_packet (net->packs.last);
+	}
+      err = grub_error (GRUB_ERR_FILE_READ_ERROR,
+			N_("premature end of file %s"), data->filename);
+    }
+  if (err)
+    {
+      net->eof = 1;
+      net->stall = 1;
+    }
+  return err;
+}
+
 static grub_err_t
 http_seek (struct grub_file *file, grub_off_t off)
 {
   struct http_data *old_data, *data;
   grub_err_t err;
+
+  /* Parallel downloads are only used for sequential reads from the
+     start.  After a seek a single connection is used.  */
+  http_ranges_stop (file);
   old_data = file->data;
-  /* FIXME: Reuse socket?  */
-  if (old_data->sock)
-    grub_net_tcp_close (old_data->sock, GRUB_NET_TCP_ABORT);
-  old_data->sock = 0;
+  if (old_data->current_line)
+    grub_free (old_data->current_line);
+  old_data->current_line = 0;
+  http_conn_release (old_data);
 
   while (file->device->net->packs.first)
     {
@@ -467,7 +1186,7 @@ http_seek (struct grub_file *file, grub_off_t off)
   grub_free (old_data);
 
   file->data = data;
-  err = http_establish (file, off, 0);
+  err = http_establish (file, off, 0, 1);
   if (err)
     {
       grub_free (data->filename);
@@ -478,11 +1197,34 @@ http_seek (struct grub_file *file, grub_off_t off)
   return GRUB_ERR_NONE;
 }
 
+/* Drop the answer to the first range request and ask again for the
+   whole file.  */
+static grub_err_t
+http_single_fallback (grub_file_t file)
+{
+  http_data_t data = file->data;
+  grub_net_t net = file->device->net;
+
+  http_conn_release (data);
+  while (net->packs.first)
+    {
+      grub_netbuff_free (net->packs.first->nb);
+      grub_net_remove_packet (net->packs.first);
+    }
+  http_data_reset (data);
+  data->size_recv = 0;
+  net->eof = 0;
+  net->stall = 0;
+  file->size = GRUB_FILE_SIZE_UNKNOWN;
+  return http_establish (file, 0, 0, 0);
+}
+
 static grub_err_t
 http_open (struct grub_file *file, const char *filename)
 {
   grub_err_t err;
   struct http_data *data;
+  unsigned connections = http_connections ();
 
   data = grub_zalloc (sizeof (*data));
   if (!data)
@@ -499,7 +1241,12 @@ http_open (struct grub_file *file, const char *filename)
   file->not_easily_seekable = 0;
   file->data = data;
 
-  err = http_establish (file, 0, 1);
+  /* With several connections the first request only asks for the first
+     chunk.  Servers that ignore ranges send the whole file instead.  */
+  if (connections > 1)
+    err = http_establish (file, 0, HTTP_RANGE_SIZE, 1);
+  else
+    err = http_establish (file, 0, 0, 0);
   if (err)
     {
       grub_free (data->filename);
@@ -507,6 +1254,39 @@ http_open (struct grub_file *file, const char *filename)
       return err;
     }
 
+  if (connections > 1 && data->partial)
+    {
+      if (!data->range_total || data->chunked || !data->have_length
+	  || !data->have_range || data->range_start != 0
+	  || data->range_end + 1 != data->content_length
+	  || data->content_length > HTTP_RANGE_SIZE
+	  || data->content_length > data->range_total)
+	{
+	  /* No usable size or range: fetch the whole file on one
+	     connection as if no ranges had been asked for.  */
+	  err = http_single_fallback (file);
+	  if (err)
+	    {
+	      grub_free (data->filename);
+	      grub_free (data);
+	      return err;
+	    }
+	  return GRUB_ERR_NONE;
+	}
+      file->size = data->range_total;
+      if (file->size > data->content_length)
+	{
+	  err = http_ranges_start (file, connections);
+	  if (err)
+	    {
+	      http_conn_release (data);
+	      grub_free (data->filename);
+	      grub_free (data);
+	      return err;
+	    }
+	}
+    }
+
   return GRUB_ERR_NONE;
 }
 
@@ -518,8 +1298,8 @@ http_close (struct grub_file *file)
   if (!data)
     return GRUB_ERR_NONE;
 
-  if (data->sock)
-    grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+  http_ranges_stop (file);
+  http_conn_release (data);
   if (data->current_line)
     grub_free (data->current_line);
   grub_free (data->filename);
@@ -532,16 +1312,53 @@ http_packets_pulled (struct grub_file *file)
 {
   http_data_t data = file->data;
 
+  if (data && data->ranges && data->ranges->failed)
+    {
+      grub_err_t err = http_ranges_fallback (file);
+      if (err)
+	return err;
+    }
+  else if (data && data->ranges)
+    http_ranges_refill (file, 1);
+
   if (file->device->net->packs.count >= 20)
     return 0;
 
   if (!file->device->net->eof)
     file->device->net->stall = 0;
-  if (data && data->sock)
-    grub_net_tcp_unstall (data->sock);
+  if (data && data->conn && !data->conn->closed)
+    grub_net_tcp_unstall (data->conn->sock);
+  if (data && data->ranges)
+    {
+      unsigned i;
+
+      for (i = 0; i < data->ranges->count; i++)
+	{
+	  struct http_conn *conn = data->ranges->range[i].resp.conn;
+	  if (conn && !conn->closed)
+	    grub_net_tcp_unstall (conn->sock);
+	}
+    }
   return 0;
 }
 
+/* Don't leave idle connections open to the OS.  */
+static grub_err_t
+http_fini_hw (int noreturn __attribute__ ((unused)))
+{
+  while (idle_conns)
+    http_conn_free (idle_conns);
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+http_restore_hw (void)
+{
+  return GRUB_ERR_NONE;
+}
+
+static struct grub_preboot *fini_hnd;
+
 static struct grub_net_app_protocol grub_http_protocol = 
   {
     .name = "http",
@@ -554,9 +1371,14 @@ static struct grub_net_app_protocol grub_http_protocol =
 GRUB_MOD_INIT (http)
 {
   grub_net_app_level_register (&grub_http_protocol);
+  /* Runs before the cards are closed.  */
+  fini_hnd = grub_loader_register_preboot_hook (http_fini_hw, http_restore_hw,
+						GRUB_LOADER_PREBOOT_HOOK_PRIO_NORMAL);
 }
 
 GRUB_MOD_FINI (http)
 {
+  grub_loader_unregister_preboot_hook (fini_hnd);
+  http_fini_hw (0);
   grub_net_app_level_unregister (&grub_http_protocol);
 }
@@ -28,6 +28,15 @@
 #define TCP_RETRANSMISSION_TIMEOUT GRUB_NET_INTERVAL
 #define TCP_RETRANSMISSION_COUNT GRUB_NET_TRIES
 
+/* Receive window.  It only goes above 64K when the peer agrees to window
+   scaling (RFC 7323).  */
+#define TCP_RECV_WINDOW (1 << 20)
+#define TCP_WINDOW_SCALE 5
+/* Without timestamps 4 SACK blocks fit into the option space.  */
+#define TCP_MAX_SACK_BLOCKS 4
+#define TCP_SYN_OPTIONS_SIZE 8
+#define TCP_SACK_OPTIONS_SIZE (4 + 8 * TCP_MAX_SACK_BLOCKS)
+
 struct unacked
 {
   struct unacked *next;
@@ -47,6 +56,21 @@ enum
     TCP_URG = 0x20,
   };
 
+enum
+  {
+    TCP_OPT_EOL = 0,
+    TCP_OPT_NOP = 1,
+    TCP_OPT_WSCALE = 3,
+    TCP_OPT_SACK_PERMITTED = 4,
+    TCP_OPT_SACK = 5
+  };
+
+struct sack_block
+{
+  grub_uint32_t start;
+  grub_uint32_t end;
+};
+
 struct grub_net_tcp_socket
 {
   struct grub_net_tcp_socket *next;
@@ -65,7 +89,12 @@ struct grub_net_tcp_socket
   grub_uint32_t my_cur_seq;
   grub_uint32_t their_start_seq;
   grub_uint32_t their_cur_seq;
-  grub_uint16_t my_window;
+  grub_uint32_t my_window;
+  int wscale_ok;
+  int sack_ok;
+  int sack_count;
+  /* Out-of-order data held in PQ, most recently changed block first.  */
+  struct sack_block sack[TCP_MAX_SACK_BLOCKS];
   struct unacked *unack_first;
   struct unacked *unack_last;
   grub_err_t (*recv_hook) (grub_net_tcp_socket_t sock, struct grub_net_buff *nb,
@@ -182,6 +211,125 @@ error (grub_net_tcp_socket_t sock)
   sock->unack_last = NULL;
 }
 
+/* Window field of an outgoing segment.  The window of SYN segments is
+   never scaled.  */
+static grub_uint16_t
+tcp_window (grub_net_tcp_socket_t sock, int syn)
+{
+  if (sock->i_stall)
+    return 0;
+  if (sock->wscale_ok && !syn)
+    return grub_cpu_to_be16 (sock->my_window >> TCP_WINDOW_SCALE);
+  return grub_cpu_to_be16 (sock->my_window > 0xffff ? 0xffff
+			   : sock->my_window);
+}
+
+static grub_size_t
+tcp_syn_options (grub_uint8_t *opt, int wscale, int sack)
+{
+  grub_uint8_t *ptr = opt;
+
+  if (wscale)
+    {
+      *ptr++ = TCP_OPT_NOP;
+      *ptr++ = TCP_OPT_WSCALE;
+      *ptr++ = 3;
+      *ptr++ = TCP_WINDOW_SCALE;
+    }
+  if (sack)
+    {
+      *ptr++ = TCP_OPT_NOP;
+      *ptr++ = TCP_OPT_NOP;
+      *ptr++ = TCP_OPT_SACK_PERMITTED;
+      *ptr++ = 2;
+    }
+  return ptr - opt;
+}
+
+/* Look for window scale and SACK-permitted options in a SYN segment and
+   fit our window to the outcome.  */
+static void
+tcp_parse_syn_options (grub_net_tcp_socket_t sock, struct tcphdr *tcph)
+{
+  grub_uint8_t *ptr = (grub_uint8_t *) (tcph + 1);
+  grub_uint8_t *end = (grub_uint8_t *) tcph
+    + (grub_be_to_cpu16 (tcph->flags) >> 12) * sizeof (grub_uint32_t);
+
+  while (ptr < end && *ptr != TCP_OPT_EOL)
+    {
+      if (*ptr == TCP_OPT_NOP)
+	{
+	  ptr++;
+	  continue;
+	}
+      if (ptr + 1 >= end || ptr[1] < 2 || ptr[1] > end - ptr)
+	break;
+      if (ptr[0] == TCP_OPT_WSCALE && ptr[1] == 3)
+	sock->wscale_ok = 1;
+      if (ptr[0] == TCP_OPT_SACK_PERMITTED && ptr[1] == 2)
+	sock->sack_ok = 1;
+      ptr += ptr[1];
+    }
+
+  /* Without scaling we can't advertise more, so don't accept more
+     either.  */
+  if (!sock->wscale_ok && sock->my_window > 0xffff)
+    sock->my_window = 0xffff;
+}
+
+static inline int
+seq_le (grub_uint32_t a, grub_uint32_t b)
+{
+  return (grub_int32_t) (a - b) <= 0;
+}
+
+/* Record that [START, END) arrived out of order.  Blocks touching it are
+   merged into it and the result becomes the first block, as RFC 2018
+   asks.  */
+static void
+tcp_sack_add (grub_net_tcp_socket_t sock, grub_uint32_t start,
+	      grub_uint32_t end)
+{
+  int i, j;
+
+  for (i = 0, j = 0; i < sock->sack_count; i++)
+    {
+      struct sack_block *blk = &sock->sack[i];
+      if (seq_le (blk->start, end) && seq_le (start, blk->end))
+	{
+	  if (!seq_le (start, blk->start))
+	    start = blk->start;
+	  if (seq_le (end, blk->end))
+	    end = blk->end;
+	  continue;
+	}
+      sock->sack[j++] = *blk;
+    }
+  if (j == TCP_MAX_SACK_BLOCKS)
+    j--;
+  grub_memmove (&sock->sack[1], &sock->sack[0], j * sizeof (sock->sack[0]));
+  sock->sack[0].start = start;
+  sock->sack[0].end = end;
+  sock->sack_count = j + 1;
+}
+
+/* Drop blocks that the cumulative ACK now covers.  */
+static void
+tcp_sack_prune (grub_net_tcp_socket_t sock)
+{
+  int i, j;
+
+  for (i = 0, j = 0; i < sock->sack_count; i++)
+    {
+      if (seq_le (sock->sack[i].end, sock->their_cur_seq))
+	continue;
+      if (seq_le (sock->sack[i].start, sock->their_cur_seq))
+	sock->sack[i].start = sock->their_cur_seq;
+      sock->sack[j++] = sock->sack[i];
+    }
+  sock->sack_count = j;
+}
+
 static grub_err_t
 tcp_send (struct grub_net_buff *nb, grub_net_tcp_socket_t socket)
 {
@@ -232,6 +380,31 @@ tcp_send (struct grub_net_buff *nb, grub_net_tcp_socket_t socket)
   return GRUB_ERR_NONE;
 }
 
+static void
+destroy_pq (grub_net_tcp_socket_t sock)
+{
+  struct grub_net_buff **nb_p;
+  while ((nb_p = grub_priority_queue_top (sock->pq)))
+    {
+      grub_netbuff_free (*nb_p);
+      grub_priority_queue_pop (sock->pq);
+    }
+
+  grub_priority_queue_destroy (sock->pq);
+}
+
+/* Whether the interface SOCK was opened on is still configured.  */
+int
+grub_net_tcp_usable (grub_net_tcp_socket_t sock)
+{
+  struct grub_net_network_level_interface *inf;
+
+  FOR_NET_NETWORK_LEVEL_INTERFACES (inf)
+    if (inf == sock->inf)
+      return 1;
+  return 0;
+}
+
 void
 grub_net_tcp_close (grub_net_tcp_socket_t sock,
 		    int discard_received)
@@ -250,6 +423,25 @@ grub_net_tcp_close (grub_net_tcp_socket_t sock,
   if (discard_received == GRUB_NET_TCP_ABORT)
     sock->i_reseted = 1;
 
+  /* Nothing can be sent through a removed interface, just forget the
+     connection.  */
+  if (discard_received != GRUB_NET_TCP_CONTINUE_RECEIVING
+      && !grub_net_tcp_usable (sock))
+    {
+      struct unacked *unack, *next;
+
+      grub_list_remove (GRUB_AS_LIST (sock));
+      for (unack = sock->unack_first; unack; unack = next)
+	{
+	  next = unack->next;
+	  grub_netbuff_free (unack->nb);
+	  grub_free (unack);
+	}
+      destroy_pq (sock);
+      grub_free (sock);
+      return;
+    }
+
   if (sock->i_closed)
     return;
 
@@ -300,8 +492,10 @@ ack_real (grub_net_tcp_socket_t sock, int res)
   struct grub_net_buff *nb_ack;
   struct tcphdr *tcph_ack;
   grub_err_t err;
+  int nsack = (!res && sock->sack_ok) ? sock->sack_count : 0;
 
-  nb_ack = grub_netbuff_alloc (sizeof (*tcph_ack) + 128);
+  nb_ack = grub_netbuff_alloc (sizeof (*tcph_ack) + TCP_SACK_OPTIONS_SIZE
+			       + 128);
   if (!nb_ack)
     return;
   err = grub_netbuff_reserve (nb_ack, 128);
@@ -313,7 +507,8 @@ ack_real (grub_net_tcp_socket_t sock, int res)
       return;
     }
 
-  err = grub_netbuff_put (nb_ack, sizeof (*tcph_ack));
+  err = grub_netbuff_put (nb_ack, sizeof (*tcph_ack)
+			  + (nsack ? 4 + 8 * nsack : 0));
   if (err)
     {
       grub_netbuff_free (nb_ack);
@@ -331,9 +526,26 @@ ack_real (grub_net_tcp_socket_t sock, int res)
   else
     {
       tcph_ack->ack = grub_cpu_to_be32 (sock->their_cur_seq);
-      tcph_ack->flags = grub_cpu_to_be16_compile_time ((5 << 12) | TCP_ACK);
-      tcph_ack->window = !sock->i_stall ? grub_cpu_to_be16 (sock->my_window)
-	: 0;
+      tcph_ack->flags = grub_cpu_to_be16 (((nsack ? 6 + 2 * nsack : 5) << 12)
+					  | TCP_ACK);
+      tcph_ack->window = tcp_window (sock, 0);
+      if (nsack)
+	{
+	  grub_uint8_t *opt = (grub_uint8_t *) (tcph_ack + 1);
+	  int i;
+
+	  opt[0] = TCP_OPT_NOP;
+	  opt[1] = TCP_OPT_NOP;
+	  opt[2] = TCP_OPT_SACK;
+	  opt[3] = 2 + 8 * nsack;
+	  for (i = 0; i < nsack; i++)
+	    {
+	      grub_set_unaligned32 (opt + 4 + 8 * i,
+				    grub_cpu_to_be32 (sock->sack[i].start));
+	      grub_set_unaligned32 (opt + 8 + 8 * i,
+				    grub_cpu_to_be32 (sock->sack[i].end));
+	    }
+	}
     }
   tcph_ack->urgent = 0;
   tcph_ack->src = grub_cpu_to_be16 (sock->in_port);
@@ -471,19 +683,6 @@ cmp (const void *a__, const void *b__)
   return 0;
 }
 
-static void
-destroy_pq (grub_net_tcp_socket_t sock)
-{
-  struct grub_net_buff **nb_p;
-  while ((nb_p = grub_priority_queue_top (sock->pq)))
-    {
-      grub_netbuff_free (*nb_p);
-      grub_priority_queue_pop (sock->pq);
-    }
-
-  grub_priority_queue_destroy (sock->pq);
-}
-
 grub_err_t
 grub_net_tcp_accept (grub_net_tcp_socket_t sock,
 		     grub_err_t (*recv_hook) (grub_net_tcp_socket_t sock,
@@ -500,6 +699,8 @@ grub_net_tcp_accept (grub_net_tcp_socket_t sock,
   grub_err_t err;
   grub_net_network_level_address_t gateway;
   struct grub_net_network_level_interface *inf;
+  grub_uint8_t opts[TCP_SYN_OPTIONS_SIZE];
+  grub_size_t optlen;
 
   sock->recv_hook = recv_hook;
   sock->error_hook = error_hook;
@@ -514,7 +715,9 @@ grub_net_tcp_accept (grub_net_tcp_socket_t sock,
   if (err)
     return err;
 
-  nb_ack = grub_netbuff_alloc (sizeof (*tcph)
+  optlen = tcp_syn_options (opts, sock->wscale_ok, sock->sack_ok);
+
+  nb_ack = grub_netbuff_alloc (sizeof (*tcph) + optlen
 			       + GRUB_NET_OUR_MAX_IP_HEADER_SIZE
 			       + GRUB_NET_MAX_LINK_HEADER_SIZE);
   if (!nb_ack)
@@ -527,16 +730,18 @@ grub_net_tcp_accept (grub_net_tcp_socket_t sock,
       return err;
     }
 
-  err = grub_netbuff_put (nb_ack, sizeof (*tcph));
+  err = grub_netbuff_put (nb_ack, sizeof (*tcph) + optlen);
   if (err)
     {
       grub_netbuff_free (nb_ack);
       return err;
     }
   tcph = (void *) nb_ack->data;
+  grub_memcpy (tcph + 1, opts, optlen);
   tcph->ack = grub_cpu_to_be32 (sock->their_cur_seq);
-  tcph->flags = grub_cpu_to_be16_compile_time ((5 << 12) | TCP_SYN | TCP_ACK);
-  tcph->window = grub_cpu_to_be16 (sock->my_window);
+  tcph->flags = grub_cpu_to_be16 (((5 + optlen / 4) << 12)
+				  | TCP_SYN | TCP_ACK);
+  tcph->window = tcp_window (sock, 1);
   tcph->urgent = 0;
   sock->established = 1;
   tcp_socket_register (sock);
@@ -604,7 +809,7 @@ grub_net_tcp_open (char *server,
   socket->fin_hook = fin_hook;
   socket->hook_data = hook_data;
 
-  nb = grub_netbuff_alloc (sizeof (*tcph) + 128);
+  nb = grub_netbuff_alloc (sizeof (*tcph) + TCP_SYN_OPTIONS_SIZE + 128);
   if (!nb)
     {
       grub_free (socket);
@@ -619,7 +824,7 @@ grub_net_tcp_open (char *server,
       return NULL;
     }
 
-  err = grub_netbuff_put (nb, sizeof (*tcph));
+  err = grub_netbuff_put (nb, sizeof (*tcph) + TCP_SYN_OPTIONS_SIZE);
   if (err)
     {
       grub_free (socket);
@@ -637,11 +842,13 @@ grub_net_tcp_open (char *server,
   tcph = (void *) nb->data;
   socket->my_start_seq = grub_get_time_ms ();
   socket->my_cur_seq = socket->my_start_seq + 1;
-  socket->my_window = 8192;
+  socket->my_window = TCP_RECV_WINDOW;
+  tcp_syn_options ((grub_uint8_t *) (tcph + 1), 1, 1);
   tcph->seqnr = grub_cpu_to_be32 (socket->my_start_seq);
   tcph->ack = grub_cpu_to_be32_compile_time (0);
-  tcph->flags = grub_cpu_to_be16_compile_time ((5 << 12) | TCP_SYN);
-  tcph->window = grub_cpu_to_be16 (socket->my_window);
+  tcph->flags = grub_cpu_to_be16_compile_time (((5 + TCP_SYN_OPTIONS_SIZE / 4)
+						<< 12) | TCP_SYN);
+  tcph->window = tcp_window (socket, 1);
   tcph->urgent = 0;
   tcph->src = grub_cpu_to_be16 (socket->in_port);
   tcph->dst = grub_cpu_to_be16 (socket->out_port);
@@ -727,8 +934,7 @@ grub_net_send_tcp_packet (const grub_net_tcp_socket_t socket,
       tcph = (struct tcphdr *) nb2->data;
       tcph->ack = grub_cpu_to_be32 (socket->their_cur_seq);
       tcph->flags = grub_cpu_to_be16_compile_time ((5 << 12) | TCP_ACK);
-      tcph->window = !socket->i_stall ? grub_cpu_to_be16 (socket->my_window)
-	: 0;
+      tcph->window = tcp_window (socket, 0);
       tcph->urgent = 0;
       err = grub_netbuff_put (nb2, fraglen);
       if (err)
@@ -751,7 +957,7 @@ grub_net_send_tcp_packet (const grub_net_tcp_socket_t socket,
   tcph->ack = grub_cpu_to_be32 (socket->their_cur_seq);
   tcph->flags = (grub_cpu_to_be16_compile_time ((5 << 12) | TCP_ACK)
 		 | (push ? grub_cpu_to_be16_compile_time (TCP_PUSH) : 0));
-  tcph->window = !socket->i_stall ? grub_cpu_to_be16 (socket->my_window) : 0;
+  tcph->window = tcp_window (socket, 0);
   tcph->urgent = 0;
   return tcp_send (nb, socket);
 }
@@ -822,6 +1028,7 @@ grub_net_recv_tcp_packet (struct grub_net_buff *nb,
       {
 	sock->their_start_seq = grub_be_to_cpu32 (tcph->seqnr);
 	sock->their_cur_seq = sock->their_start_seq + 1;
+	tcp_parse_syn_options (sock, tcph);
 	sock->established = 1;
       }
 
@@ -876,6 +1083,24 @@ grub_net_recv_tcp_packet (struct grub_net_buff *nb,
 	reset (sock);
       }
 
+    /* Don't queue anything beyond what we advertised.  */
+    if (grub_be_to_cpu32 (tcph->seqnr) - sock->their_cur_seq
+	>= sock->my_window)
+      {
+	ack (sock);
+	grub_netbuff_free (nb);
+	return GRUB_ERR_NONE;
+      }
+
+    if (sock->sack_ok && grub_be_to_cpu32 (tcph->seqnr) != sock->their_cur_seq)
+      {
+	grub_ssize_t len = nb->tail - nb->data
+	  - (grub_be_to_cpu16 (tcph->flags) >> 12) * sizeof (grub_uint32_t);
+	if (len > 0)
+	  tcp_sack_add (sock, grub_be_to_cpu32 (tcph->seqnr),
+			grub_be_to_cpu32 (tcph->seqnr) + len);
+      }
+
     err = grub_priority_queue_push (sock->pq, &nb);
     if (err)
       {
@@ -941,6 +1166,7 @@ grub_net_recv_tcp_packet (struct grub_net_buff *nb,
 	  else
 	    grub_netbuff_free (nb_top);
 	}
+      tcp_sack_prune (sock);
       if (do_ack)
 	ack (sock);
       while (sock->packs.first)
@@ -979,7 +1205,8 @@ grub_net_recv_tcp_packet (struct grub_net_buff *nb,
 	sock->their_start_seq = grub_be_to_cpu32 (tcph->seqnr);
 	sock->their_cur_seq = sock->their_start_seq + 1;
 	sock->my_cur_seq = sock->my_start_seq = grub_get_time_ms ();
-	sock->my_window = 8192;
+	sock->my_window = TCP_RECV_WINDOW;
+	tcp_parse_syn_options (sock, tcph);
 
 	sock->pq = grub_priority_queue_new (sizeof (struct grub_net_buff *),
 					    cmp);
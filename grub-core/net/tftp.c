@@ -44,6 +44,15 @@ enum
     TFTP_DEFAULTSIZE_PACKET = 512,
   };
 
+/* Number of blocks the server may send before waiting for an ACK
+   (RFC 7440).  It must stay well below the 50 packets queued on the
+   file before the transfer is stalled.  */
+enum
+  {
+    TFTP_DEFAULT_WINDOWSIZE = 1,
+    TFTP_MAX_WINDOWSIZE = 16
+  };
+
 enum
   {
     TFTP_CODE_EOF = 1,
@@ -102,7 +111,12 @@ typedef struct tftp_data
   grub_uint64_t file_size;
   grub_uint64_t block;
   grub_uint32_t block_size;
+  grub_uint32_t window_size;
   grub_uint64_t ack_sent;
+  /* ACK_SENT + 1 once the last ACK has been repeated for duplicates.  */
+  grub_uint64_t ack_repeated;
+  /* Last duplicate block seen since then.  */
+  grub_uint16_t dup_block;
   int have_oack;
   struct grub_error_saved save_err;
   grub_net_udp_socket_t sock;
@@ -159,6 +173,30 @@ ack (tftp_data_t data, grub_uint64_t block)
   return GRUB_ERR_NONE;
 }
 
+/* Handle a block we already have while transferring with a window.
+   If it is not newer than our last ACK the server apparently missed
+   that ACK and resends the window, so repeat the ACK once per resent
+   window: servers ignore duplicate ACKs (RFC 1123) and answering every
+   block of a burst would just add traffic.  A burst is over once a
+   duplicate is not newer than the previous one.  Duplicates newer than
+   our last ACK are retransmissions we asked for and need no answer.  */
+static grub_err_t
+ack_duplicate (tftp_data_t data, grub_uint16_t block)
+{
+  grub_uint16_t prev = data->dup_block;
+
+  if (cmp_block (block, data->ack_sent) > 0)
+    return GRUB_ERR_NONE;
+
+  data->dup_block = block;
+  if (data->ack_repeated == data->ack_sent + 1
+      && cmp_block (block, prev) > 0)
+    return GRUB_ERR_NONE;
+
+  data->ack_repeated = data->ack_sent + 1;
+  return ack (data, data->ack_sent);
+}
+
 static grub_err_t
 tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
 	      struct grub_net_buff *nb,
@@ -181,6 +219,7 @@ tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
     {
     case TFTP_OACK:
       data->block_size = TFTP_DEFAULTSIZE_PACKET;
+      data->window_size = TFTP_DEFAULT_WINDOWSIZE;
       data->have_oack = 1; 
       for (ptr = nb->data + sizeof (tftph->opcode); ptr < nb->tail;)
 	{
@@ -190,10 +229,15 @@ tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
 	  if (grub_memcmp (ptr, "blksize\0", sizeof ("blksize\0") - 1) == 0)
 	    data->block_size = grub_strtoul ((char *) ptr + sizeof ("blksize\0")
 					     - 1, 0, 0);
+	  if (grub_memcmp (ptr, "windowsize\0", sizeof ("windowsize\0") - 1) == 0)
+	    data->window_size = grub_strtoul ((char *) ptr + sizeof ("windowsize\0")
+					      - 1, 0, 0);
 	  while (ptr < nb->tail && *ptr)
 	    ptr++;
 	  ptr++;
 	}
+      if (data->window_size < 1 || data->window_size > TFTP_MAX_WINDOWSIZE)
+	data->window_size = TFTP_DEFAULT_WINDOWSIZE;
       data->block = 0;
       grub_netbuff_free (nb);
       err = ack (data, 0);
@@ -222,10 +266,23 @@ tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
 	    tftph = (struct tftphdr *) nb_top->data;
 	    if (cmp_block (grub_be_to_cpu16 (tftph->u.data.block), data->block + 1) >= 0)
 	      break;
-	    ack (data, grub_be_to_cpu16 (tftph->u.data.block));
+	    if (data->window_size > 1)
+	      ack_duplicate (data, grub_be_to_cpu16 (tftph->u.data.block));
+	    else
+	      ack (data, grub_be_to_cpu16 (tftph->u.data.block));
 	    grub_netbuff_free (nb_top);
 	    grub_priority_queue_pop (data->pq);
 	  }
+	/* A block of the window is missing.  Acknowledging the last block
+	   received in order makes the server resend the window from there,
+	   the blocks after the gap wait in the queue meanwhile.  */
+	if (data->window_size > 1 && data->ack_sent != data->block
+	    && cmp_block (grub_be_to_cpu16 (tftph->u.data.block), data->block + 1) > 0)
+	  {
+	    err = ack (data, data->block);
+	    if (err)
+	      return err;
+	  }
 	while (cmp_block (grub_be_to_cpu16 (tftph->u.data.block), data->block + 1) == 0)
 	  {
 	    unsigned size;
@@ -233,7 +290,13 @@ tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
 	    grub_priority_queue_pop (data->pq);
 
 	    if (file->device->net->packs.count < 50)
-	      err = ack (data, data->block + 1);
+	      {
+		/* Only the last block of a window is acknowledged.  */
+		if (data->block + 1 - data->ack_sent >= data->window_size)
+		  err = ack (data, data->block + 1);
+		else
+		  err = 0;
+	      }
 	    else
 	      {
 		file->device->net->stall = 1;
@@ -318,6 +381,7 @@ tftp_open (struct grub_file *file, const char *filename)
   data = grub_zalloc (sizeof (*data));
   if (!data)
     return grub_errno;
+  data->window_size = TFTP_DEFAULT_WINDOWSIZE;
 
   nb.head = open_data;
   nb.end = open_data + sizeof (open_data);
@@ -360,6 +424,15 @@ tftp_open (struct grub_file *file, const char *filename)
   grub_strcpy (rrq, "0");
   rrqlen += grub_strlen ("0") + 1;
   rrq += grub_strlen ("0") + 1;
+
+  grub_strcpy (rrq, "windowsize");
+  rrqlen += grub_strlen ("windowsize") + 1;
+  rrq += grub_strlen ("windowsize") + 1;
+
+  /* RFC 7440 caps the window at 65535 blocks.  */
+  grub_snprintf (rrq, sizeof ("65535"), "%d", TFTP_MAX_WINDOWSIZE);
+  rrqlen += grub_strlen (rrq) + 1;
+  rrq += grub_strlen (rrq) + 1;
   hdrlen = sizeof (tftph->opcode) + rrqlen;
 
   err = grub_netbuff_unput (&nb, nb.tail - (nb.data + hdrlen));
@@ -480,7 +553,8 @@ tftp_packets_pulled (struct grub_file *file)
 
   if (!file->device->net->eof)
     file->device->net->stall = 0;
-  if (data->ack_sent >= data->block)
+  /* Don't cut a window short, that would make the server resend it.  */
+  if (data->block - data->ack_sent < data->window_size)
     return 0;
   return ack (data, data->block);
 }
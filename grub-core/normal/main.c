@@ -22,6 +22,7 @@
 #include <grub/dl.h>
 #include <grub/misc.h>
 #include <grub/file.h>
+#include <grub/disk.h>
 #include <grub/mm.h>
 #include <grub/term.h>
 #include <grub/env.h>
@@ -471,6 +472,52 @@ grub_env_write_pager (struct grub_env_var *var __attribute__ ((unused)),
   return grub_strdup (val);
 }
 
+static char *
+grub_env_write_disk_cache_size (struct grub_env_var *var __attribute__ ((unused)),
+				const char *val)
+{
+  grub_uint64_t size = GRUB_DISK_CACHE_DEFAULT_SIZE;
+  unsigned shift = 0;
+  char *ptr;
+
+  if (*val)
+    {
+      size = grub_strtoull (val, &ptr, 0);
+      if (grub_errno)
+	return NULL;
+
+      switch (*ptr)
+	{
+	case 'K':
+	  shift = 10;
+	  ptr++;
+	  break;
+	case 'M':
+	  shift = 20;
+	  ptr++;
+	  break;
+	case 'G':
+	  shift = 30;
+	  ptr++;
+	  break;
+	}
+      if (*ptr)
+	{
+	  grub_error (GRUB_ERR_BAD_NUMBER, N_("unrecognized number"));
+	  return NULL;
+	}
+      if (size > (GRUB_SIZE_MAX >> shift))
+	{
+	  grub_error (GRUB_ERR_OUT_OF_RANGE, N_("overflow is detected"));
+	  return NULL;
+	}
+      size <<= shift;
+    }
+
+  grub_disk_cache_set_size (size);
+  return grub_strdup (val);
+}
+
 /* clear */
 static grub_err_t
 grub_mini_cmd_clear (struct grub_command *cmd __attribute__ ((unused)),
@@ -522,6 +569,10 @@ GRUB_MOD_INIT(normal)
   grub_register_variable_hook ("pager", 0, grub_env_write_pager);
   grub_env_export ("pager");
 
+  grub_register_variable_hook ("disk_cache_size", 0,
+			       grub_env_write_disk_cache_size);
+  grub_env_export ("disk_cache_size");
+
   /* Register a command "normal" for the rescue mode.  */
   grub_register_command ("normal", grub_cmd_normal,
 			 0, N_("Enter normal mode."));
@@ -564,6 +615,7 @@ GRUB_MOD_FINI(normal)
 
   grub_set_history (0);
   grub_register_variable_hook ("pager", 0, 0);
+  grub_register_variable_hook ("disk_cache_size", 0, 0);
   grub_fs_autoload_hook = 0;
   grub_unregister_command (cmd_clear);
 }
@@ -66,7 +66,8 @@ typedef enum
     GPG_ERR_WRONG_PUBKEY_ALGO,
     GPG_ERR_OUT_OF_MEMORY,
     GPG_ERR_TOO_LARGE,
-    GPG_ERR_ENOMEM
+    GPG_ERR_ENOMEM,
+    GPG_ERR_CANCELED
   } gpg_err_code_t;
 typedef gpg_err_code_t gpg_error_t;
 typedef gpg_error_t gcry_error_t;
@@ -393,6 +394,16 @@ grub_crypto_pbkdf2 (const struct gcry_md_spec *md,
 		    unsigned int c,
 		    grub_uint8_t *DK, grub_size_t dkLen);
 
+/* Like grub_crypto_pbkdf2, but give up with GPG_ERR_CANCELED as soon as
+   *CANCEL is set by another thread.  */
+gcry_err_code_t
+grub_crypto_pbkdf2_cancel (const struct gcry_md_spec *md,
+			   const grub_uint8_t *P, grub_size_t Plen,
+			   const grub_uint8_t *S, grub_size_t Slen,
+			   unsigned int c,
+			   grub_uint8_t *DK, grub_size_t dkLen,
+			   const volatile int *cancel);
+
 int
 grub_crypto_memcmp (const void *a, const void *b, grub_size_t n);
 
@@ -82,6 +82,8 @@ struct grub_cryptodisk
   char uuid[GRUB_CRYPTODISK_MAX_UUID_LENGTH + 1];
   grub_uint8_t lrw_key[GRUB_CRYPTODISK_GF_BYTES];
   grub_uint8_t *lrw_precalc;
+  /* AES-NI round keys, or NULL when the generic cipher code is used.  */
+  struct grub_cryptodisk_aesni *aesni;
   grub_uint8_t iv_prefix[64];
   grub_size_t iv_prefix_len;
   grub_uint8_t key[GRUB_CRYPTODISK_MAX_KEYLEN];
@@ -129,6 +129,12 @@ struct grub_disk
   /* Maximum number of sectors read divided by GRUB_DISK_CACHE_SIZE.  */
   unsigned int max_agglomerate;
 
+  /* Sequential read detection: the sector following the last window
+     read on a cache miss and the size of that window in units of
+     GRUB_DISK_CACHE_SIZE.  */
+  grub_disk_addr_t readahead_next;
+  unsigned int readahead_window;
+
   /* The id used by the disk cache manager.  */
   unsigned long id;
 
@@ -142,11 +148,33 @@ struct grub_disk
   /* Caller-specific data passed to the read hook.  */
   void *read_hook_data;
 
+  /* I/O statistics of this disk, if they could be allocated.  */
+  struct grub_disk_stats *stats;
+
   /* Device-specific data.  */
   void *data;
 };
 typedef struct grub_disk *grub_disk_t;
 
+/* I/O statistics of a disk.  They are kept from the first time the disk
+   is opened until GRUB exits.  */
+struct grub_disk_stats
+{
+  struct grub_disk_stats *next;
+  enum grub_disk_dev_id dev_id;
+  unsigned long disk_id;
+  char *name;
+  grub_uint64_t cache_hits;
+  grub_uint64_t cache_misses;
+  /* Bytes read by the driver, the number of its read calls and the time
+     they took in milliseconds.  */
+  grub_uint64_t bytes_read;
+  grub_uint64_t read_calls;
+  grub_uint64_t read_time_ms;
+};
+
+extern struct grub_disk_stats *EXPORT_VAR(grub_disk_stats_list);
+
 #ifdef GRUB_UTIL
 struct grub_disk_memberlist
 {
@@ -160,8 +188,12 @@ typedef struct grub_disk_memberlist *grub_disk_memberlist_t;
 #define GRUB_DISK_SECTOR_SIZE	0x200
 #define GRUB_DISK_SECTOR_BITS	9
 
-/* The maximum number of disk caches.  */
-#define GRUB_DISK_CACHE_NUM	1021
+/* The default size of the disk cache in bytes.  It can be changed at
+   runtime through the disk_cache_size variable.  */
+#define GRUB_DISK_CACHE_DEFAULT_SIZE	(16 << 20)
+
+/* The number of cache entries a sector may be stored in.  */
+#define GRUB_DISK_CACHE_WAYS	4
 
 /* The size of a disk cache in 512B units. Must be at least as big as the
    largest supported sector size, currently 16K.  */
@@ -170,12 +202,35 @@ typedef struct grub_disk_memberlist *grub_disk_memberlist_t;
 
 #define GRUB_DISK_MAX_MAX_AGGLOMERATE ((1 << (30 - GRUB_DISK_CACHE_BITS - GRUB_DISK_SECTOR_BITS)) - 1)
 
+/* The largest read-ahead window, in units of GRUB_DISK_CACHE_SIZE.  */
+#define GRUB_DISK_READAHEAD_MAX (4194304 >> (GRUB_DISK_CACHE_BITS + GRUB_DISK_SECTOR_BITS))
+
 /* Return value of grub_disk_get_size() in case disk size is unknown. */
 #define GRUB_DISK_SIZE_UNKNOWN	 0xffffffffffffffffULL
 
-/* This is called from the memory manager.  */
+/* A cache of disk contents kept elsewhere, e.g. by a filesystem.  FLUSH
+   is called whenever the disk cache is invalidated or released and must
+   drop every entry and free its memory.  */
+struct grub_disk_cache_hook
+{
+  struct grub_disk_cache_hook *next;
+  struct grub_disk_cache_hook **prev;
+  void (*flush) (void);
+};
+
+void EXPORT_FUNC(grub_disk_cache_register_hook) (struct grub_disk_cache_hook *hook);
+void EXPORT_FUNC(grub_disk_cache_unregister_hook) (struct grub_disk_cache_hook *hook);
+
+/* Forget all cached sectors.  */
 void grub_disk_cache_invalidate_all (void);
 
+/* Also free the cache memory; it is allocated again when needed.  This is
+   called from the memory manager.  */
+void grub_disk_cache_release (void);
+
+/* Resize the disk cache to SIZE bytes, 0 disables it.  */
+void EXPORT_FUNC(grub_disk_cache_set_size) (grub_size_t size);
+
 void EXPORT_FUNC(grub_disk_dev_register) (grub_disk_dev_t dev);
 void EXPORT_FUNC(grub_disk_dev_unregister) (grub_disk_dev_t dev);
 static inline int
@@ -213,14 +268,36 @@ extern grub_err_t (*EXPORT_VAR(grub_disk_write_weak)) (grub_disk_t disk,
 
 grub_uint64_t EXPORT_FUNC(grub_disk_get_size) (grub_disk_t disk);
 
-#if DISK_CACHE_STATS
 void
 EXPORT_FUNC(grub_disk_cache_get_performance) (unsigned long *hits, unsigned long *misses);
-#endif
 
 extern void (* EXPORT_VAR(grub_disk_firmware_fini)) (void);
 extern int EXPORT_VAR(grub_disk_firmware_is_tainted);
 
+/* Read SIZE bytes at ADDR of member DISKNR, for the RAID recovery hooks
+   below.  ADDR is passed through from the caller as is.  */
+typedef grub_err_t (*grub_raid_recover_read_t) (void *data, int disknr,
+						grub_uint64_t addr,
+						void *dest, grub_size_t size);
+
+/* Parity recovery for filesystems with their own RAID layout.  These are
+   set by raid5rec and raid6rec, so that such filesystems don't pull the
+   RAID modules in unless an array actually needs rebuilding.  */
+extern grub_err_t (*EXPORT_VAR(grub_raid5_recover_gen_func))
+     (void *data, grub_uint64_t nstripes, int disknr, char *buf,
+      grub_uint64_t addr, grub_size_t size, grub_raid_recover_read_t read_func);
+extern grub_err_t (*EXPORT_VAR(grub_raid6_recover_gen_func))
+     (void *data, grub_uint64_t nstripes, int disknr, int p, char *buf,
+      grub_uint64_t addr, grub_size_t size, int layout,
+      grub_raid_recover_read_t read_func);
+extern void (*EXPORT_VAR(grub_raid6_gf_mul_func)) (grub_uint8_t *buf,
+						    grub_uint8_t c,
+						    grub_size_t size);
+extern void (*EXPORT_VAR(grub_raid6_gf_mul_xor_func)) (grub_uint8_t *dst,
+							const grub_uint8_t *src,
+							grub_uint8_t c,
+							grub_size_t size);
+
 static inline void
 grub_stop_disk_firmware (void)
 {
@@ -241,9 +318,14 @@ struct grub_disk_cache
   grub_disk_addr_t sector;
   char *data;
   int lock;
+  /* Value of the cache clock at the last use, for LRU replacement.  */
+  unsigned long last_use;
 };
 
-extern struct grub_disk_cache EXPORT_VAR(grub_disk_cache_table)[GRUB_DISK_CACHE_NUM];
+/* The cache is grub_disk_cache_num_sets sets of GRUB_DISK_CACHE_WAYS
+   entries each.  The table is NULL until the cache is first used.  */
+extern struct grub_disk_cache *EXPORT_VAR(grub_disk_cache_table);
+extern unsigned EXPORT_VAR(grub_disk_cache_num_sets);
 
 #if defined (GRUB_UTIL)
 void grub_lvm_init (void);
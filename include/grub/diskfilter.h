@@ -22,6 +22,7 @@
 
 #include <grub/types.h>
 #include <grub/list.h>
+#include <grub/disk.h>
 
 enum
   {
@@ -189,6 +190,31 @@ typedef grub_err_t (*grub_raid6_recover_func_t) (struct grub_diskfilter_segment
 extern grub_raid5_recover_func_t grub_raid5_recover_func;
 extern grub_raid6_recover_func_t grub_raid6_recover_func;
 
+/* Rebuild SIZE bytes of member DISKNR of an array of NSTRIPES members from
+   the others.  Filesystems with their own RAID layout reach these through
+   grub_raid5_recover_gen_func and grub_raid6_recover_gen_func.  */
+grub_err_t
+grub_raid5_recover_gen (void *data, grub_uint64_t nstripes, int disknr,
+			char *buf, grub_uint64_t addr, grub_size_t size,
+			grub_raid_recover_read_t read_func);
+
+/* Same for RAID6 with P at member P and Q following it.  */
+grub_err_t
+grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
+			char *buf, grub_uint64_t addr, grub_size_t size,
+			int layout, grub_raid_recover_read_t read_func);
+
+/* Arithmetic in GF(2^8) with the RAID6 polynomial 0x11d.  These use SSSE3
+   when the CPU has it and grub_raid6_no_simd is clear.  RAID-Z recovery
+   reaches them through grub_raid6_gf_mul_func and
+   grub_raid6_gf_mul_xor_func.  */
+/* BUF *= C.  */
+void grub_raid6_gf_mul (grub_uint8_t *buf, grub_uint8_t c, grub_size_t size);
+/* DST ^= SRC * C.  */
+void grub_raid6_gf_mul_xor (grub_uint8_t *dst, const grub_uint8_t *src,
+			    grub_uint8_t c, grub_size_t size);
+extern int grub_raid6_no_simd;
+
 grub_err_t grub_diskfilter_vg_register (struct grub_diskfilter_vg *vg);
 
 grub_err_t
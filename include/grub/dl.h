@@ -170,6 +170,39 @@ struct grub_dl_dep
 };
 typedef struct grub_dl_dep *grub_dl_dep_t;
 
+/* A module bundle holds the modules of one platform in a single file, each
+   after all of its dependencies, so that a module and whatever it needs can
+   be read with one open and a few large reads.  The header is followed by
+   NMODS entries, NDEPS dependency indices and the module names; the module
+   images follow, each aligned to GRUB_DL_BUNDLE_ALIGN.  All fields are
+   little-endian.  */
+#define GRUB_DL_BUNDLE_NAME "modules.bundle"
+#define GRUB_DL_BUNDLE_MAGIC "GRUBMODB"
+#define GRUB_DL_BUNDLE_ALIGN 16
+
+struct grub_dl_bundle_header
+{
+  char magic[8];
+  grub_uint32_t nmods;
+  grub_uint32_t ndeps;
+  /* Size of the entries, dependencies and names.  */
+  grub_uint32_t index_size;
+  grub_uint32_t reserved;
+} GRUB_PACKED;
+
+struct grub_dl_bundle_entry
+{
+  /* Position and size of the module image in the file.  */
+  grub_uint32_t offset;
+  grub_uint32_t size;
+  /* Offset of the name in the name table.  */
+  grub_uint32_t name;
+  /* Every module this one needs, directly or not, as entry indices in
+     ascending order: deps[first_dep] to deps[first_dep + ndeps - 1].  */
+  grub_uint32_t first_dep;
+  grub_uint32_t ndeps;
+} GRUB_PACKED;
+
 #ifndef GRUB_UTIL
 struct grub_dl
 {
@@ -200,6 +233,7 @@ typedef struct grub_dl *grub_dl_t;
 grub_dl_t grub_dl_load_file (const char *filename);
 grub_dl_t EXPORT_FUNC(grub_dl_load) (const char *name);
 grub_dl_t grub_dl_load_core (void *addr, grub_size_t size);
+grub_dl_t grub_dl_load_bundled (const char *dir, const char *name);
 grub_dl_t EXPORT_FUNC(grub_dl_load_core_noinit) (void *addr, grub_size_t size);
 int EXPORT_FUNC(grub_dl_unload) (grub_dl_t mod);
 void grub_dl_unload_unneeded (void);
@@ -88,4 +88,35 @@ EXPORT_FUNC(grub_fshelp_read_file) (grub_disk_t disk, grub_fshelp_node_t node,
 				    grub_off_t filesize, int log2blocksize,
 				    grub_disk_addr_t blocks_start);
 
+/* A run of LENGTH file blocks, starting with the file block LOGICAL,
+   which is stored contiguously on disk starting with the block
+   PHYSICAL.  A PHYSICAL of 0 describes a hole which reads as zeroes.  */
+struct grub_fshelp_extent
+{
+  grub_disk_addr_t logical;
+  grub_disk_addr_t physical;
+  grub_disk_addr_t length;
+};
+
+/* Fill EXTENT with the run of blocks containing the file block BLOCK
+   of NODE.  */
+typedef grub_err_t (*grub_fshelp_get_extent_t) (grub_fshelp_node_t node,
+						grub_disk_addr_t block,
+						struct grub_fshelp_extent *extent);
+
+/* Like grub_fshelp_read_file, but GET_EXTENT translates whole runs of
+   file blocks at once, so that each physically contiguous part of the
+   file is read with a single disk read.  */
+grub_ssize_t
+EXPORT_FUNC(grub_fshelp_read_file_extents) (grub_disk_t disk,
+					    grub_fshelp_node_t node,
+					    grub_disk_read_hook_t read_hook,
+					    void *read_hook_data,
+					    grub_off_t pos, grub_size_t len,
+					    char *buf,
+					    grub_fshelp_get_extent_t get_extent,
+					    grub_off_t filesize,
+					    int log2blocksize,
+					    grub_disk_addr_t blocks_start);
+
 #endif /* ! GRUB_FSHELP_HEADER */
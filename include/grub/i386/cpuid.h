@@ -70,7 +70,8 @@ grub_cpu_is_cpuid_supported (void)
 
 #endif
 
-#ifdef __PIC__
+/* %ebx is the PIC register only on i386.  */
+#if defined (__PIC__) && !defined (__x86_64__)
 #define grub_cpuid(num,a,b,c,d) \
   asm volatile ("xchgl %%ebx, %1; cpuid; xchgl %%ebx, %1" \
                 : "=a" (a), "=r" (b), "=c" (c), "=d" (d)  \
@@ -21,5 +21,8 @@
 #define GRUB_CRC_H	1
 
 grub_uint32_t grub_getcrc32c (grub_uint32_t crc, const void *buf, int size);
+/* Portable version, used when the CPU has no CRC32C instruction.  */
+grub_uint32_t grub_getcrc32c_sw (grub_uint32_t crc, const void *buf,
+				 int size);
 
 #endif /* ! GRUB_CRC_H */
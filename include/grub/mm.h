@@ -35,6 +35,21 @@ void EXPORT_FUNC(grub_free) (void *ptr);
 void *EXPORT_FUNC(grub_realloc) (void *ptr, grub_size_t size);
 #ifndef GRUB_MACHINE_EMU
 void *EXPORT_FUNC(grub_memalign) (grub_size_t align, grub_size_t size);
+
+/* Allocations of up to 16 << (GRUB_MM_SLAB_CLASSES - 1) bytes are served
+   from slabs of one size class each.  */
+#define GRUB_MM_SLAB_CLASSES	8
+
+struct grub_mm_slab_stats
+{
+  grub_size_t obj_size;
+  grub_size_t slabs;
+  grub_size_t objects;
+  grub_size_t used;
+};
+
+/* Fill in GRUB_MM_SLAB_CLASSES entries of STATS.  */
+void EXPORT_FUNC(grub_mm_get_slab_stats) (struct grub_mm_slab_stats *stats);
 #endif
 
 void grub_mm_check_real (const char *file, int line);
@@ -65,6 +65,9 @@ enum
 void
 grub_net_tcp_close (grub_net_tcp_socket_t sock, int discard_received);
 
+int
+grub_net_tcp_usable (grub_net_tcp_socket_t sock);
+
 grub_err_t
 grub_net_tcp_accept (grub_net_tcp_socket_t sock,
 		     grub_err_t (*recv_hook) (grub_net_tcp_socket_t sock,
@@ -41,6 +41,9 @@
   { "compress", GRUB_INSTALL_OPTIONS_INSTALL_COMPRESS,		  \
     "no|xz|gz|lzo", 0,				  \
     N_("compress GRUB files [optional]"), 1 },			          \
+  { "module-bundle", GRUB_INSTALL_OPTIONS_MODULE_BUNDLE, 0, 0,		  \
+    N_("also pack the modules into one file to load them faster "	  \
+       "[experimental]"), 1 },						  \
   {"core-compress", GRUB_INSTALL_OPTIONS_INSTALL_CORE_COMPRESS,		\
       "xz|none|auto",						\
       0, N_("choose the compression to use for core image"), 2},	\
@@ -115,7 +118,8 @@ enum grub_install_options {
   GRUB_INSTALL_OPTIONS_LOCALE_DIRECTORY,
   GRUB_INSTALL_OPTIONS_THEMES_DIRECTORY,
   GRUB_INSTALL_OPTIONS_GRUB_MKIMAGE,
-  GRUB_INSTALL_OPTIONS_INSTALL_CORE_COMPRESS
+  GRUB_INSTALL_OPTIONS_INSTALL_CORE_COMPRESS,
+  GRUB_INSTALL_OPTIONS_MODULE_BUNDLE
 };
 
 extern char *grub_install_source_directory;
@@ -0,0 +1,31 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_ZSTD_HEADER
+#define GRUB_ZSTD_HEADER 1
+
+#include <grub/types.h>
+
+/* Decompress the zstd frames in INBUF, skip the first OFF bytes of the
+   result and store at most OUTSIZE bytes in OUTBUF.  Returns the number
+   of bytes stored, or -1 with grub_errno set.  */
+grub_ssize_t
+grub_zstd_decompress (const void *inbuf, grub_size_t insize, grub_off_t off,
+		      void *outbuf, grub_size_t outsize);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <grub/test.h>
+#include <grub/types.h>
+#include <grub/lib/crc.h>
+
+#define BENCH_SIZE (8 << 20)
+#define BENCH_ROUNDS 4
+
+/* The byte-at-a-time loop the library used to have, as a reference.  */
+static grub_uint32_t
+crc32c_bytewise (grub_uint32_t crc, const grub_uint8_t *data, int size)
+{
+  static grub_uint32_t table[256];
+  int i, j;
+
+  if (!table[1])
+    for (i = 0; i < 256; i++)
+      {
+	grub_uint32_t c = i;
+	for (j = 0; j < 8; j++)
+	  c = (c >> 1) ^ ((c & 1) ? 0x82f63b78 : 0);
+	table[i] = c;
+      }
+
+  crc ^= 0xffffffff;
+  for (i = 0; i < size; i++)
+    crc = (crc >> 8) ^ table[(crc & 0xff) ^ data[i]];
+  return crc ^ 0xffffffff;
+}
+
+static double
+bench (grub_uint32_t (*fn) (grub_uint32_t, const void *, int),
+       const grub_uint8_t *buf)
+{
+  clock_t start;
+  grub_uint32_t crc = 0;
+  double secs;
+  int i;
+
+  start = clock ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    crc = fn (crc, buf, BENCH_SIZE);
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  /* Keep the result alive.  */
+  if (crc == 0x12345678)
+    printf (" ");
+  return secs > 0 ? (double) BENCH_ROUNDS * BENCH_SIZE / secs / 1e6 : 0;
+}
+
+static grub_uint32_t
+bytewise_wrapper (grub_uint32_t crc, const void *buf, int size)
+{
+  return crc32c_bytewise (crc, buf, size);
+}
+
+static void
+crc32c_test (void)
+{
+  grub_uint8_t *buf;
+  grub_uint32_t seed = 1;
+  int i, len, off;
+
+  grub_test_assert (grub_getcrc32c (0, "123456789", 9) == 0xe3069283,
+		    "crc32c check value mismatch");
+  grub_test_assert (grub_getcrc32c_sw (0, "123456789", 9) == 0xe3069283,
+		    "portable crc32c check value mismatch");
+
+  buf = malloc (BENCH_SIZE);
+  if (!buf)
+    {
+      grub_test_assert (0, "out of memory");
+      return;
+    }
+  for (i = 0; i < BENCH_SIZE; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      buf[i] = seed >> 16;
+    }
+
+  /* Every alignment and all short lengths, so both the byte loops and the
+     word loops get exercised.  */
+  for (off = 0; off < 8; off++)
+    for (len = 0; len <= 80; len++)
+      {
+	grub_uint32_t expected = crc32c_bytewise (0, buf + off, len);
+	grub_test_assert (grub_getcrc32c_sw (0, buf + off, len) == expected,
+			  "portable crc32c mismatch at offset %d length %d",
+			  off, len);
+	grub_test_assert (grub_getcrc32c (0, buf + off, len) == expected,
+			  "crc32c mismatch at offset %d length %d", off, len);
+      }
+
+  /* Chaining must give the same result as a single call.  */
+  {
+    grub_uint32_t expected = crc32c_bytewise (0, buf, 65536);
+    grub_uint32_t crc;
+
+    crc = grub_getcrc32c (0, buf, 12345);
+    crc = grub_getcrc32c (crc, buf + 12345, 65536 - 12345);
+    grub_test_assert (crc == expected, "chained crc32c mismatch");
+
+    crc = grub_getcrc32c_sw (0, buf, 777);
+    crc = grub_getcrc32c_sw (crc, buf + 777, 65536 - 777);
+    grub_test_assert (crc == expected, "chained portable crc32c mismatch");
+  }
+
+  printf ("crc32c: bytewise %.0f MB/s, slice-by-8 %.0f MB/s, "
+	  "grub_getcrc32c %.0f MB/s\n",
+	  bench (bytewise_wrapper, buf), bench (grub_getcrc32c_sw, buf),
+	  bench (grub_getcrc32c, buf));
+
+  free (buf);
+}
+
+GRUB_UNIT_TEST ("crc32c_unit_test", crc32c_test);
@@ -0,0 +1,301 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The bundle reader is part of the kernel.  Build it here on top of
+   hostfs, with a stand-in for the ELF loader that checks and records the
+   images it is handed.  */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/types.h>
+#include <grub/file.h>
+#include <grub/i18n.h>
+#include <grub/emu/misc.h>
+#include <grub/util/misc.h>
+#include <grub/test.h>
+
+/* Utilities have no platform of their own; any directory name does.  */
+#define GRUB_TARGET_CPU "test"
+#define GRUB_PLATFORM "bundle"
+
+struct grub_dl
+{
+  char *name;
+  int ref_count;
+  struct grub_dl *next;
+};
+
+grub_dl_t grub_dl_head;
+
+void grub_host_init (void);
+void grub_hostfs_init (void);
+void grub_host_fini (void);
+void grub_hostfs_fini (void);
+
+static grub_dl_t
+grub_dl_get (const char *name)
+{
+  grub_dl_t l;
+
+  FOR_LIST_ELEMENTS (l, grub_dl_head)
+    if (grub_strcmp (name, l->name) == 0)
+      return l;
+  return 0;
+}
+
+#include "../grub-core/kern/dl_bundle.c"
+
+static const struct
+{
+  const char *name;
+  unsigned ndeps;
+  grub_uint32_t deps[2];
+} mods[] =
+  {
+    { "alpha", 0, { 0 } },
+    { "beta", 1, { 0 } },
+    { "gamma", 2, { 0, 1 } },
+    { "delta", 0, { 0 } },
+    { "epsilon", 2, { 0, 3 } }
+  };
+
+static char loaded[ARRAY_SIZE (mods) + 1][16];
+static unsigned nloaded;
+
+static grub_size_t
+image_size (unsigned i)
+{
+  return 100 + 37 * i;
+}
+
+static grub_uint8_t
+image_byte (unsigned i, grub_size_t j)
+{
+  return i * 7 + j;
+}
+
+/* An image is the module name followed by a pattern that depends on its
+   index.  */
+grub_dl_t
+grub_dl_load_core (void *addr, grub_size_t size)
+{
+  const char *image = addr;
+  grub_dl_t mod;
+  grub_size_t j;
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (mods); i++)
+    if (strcmp (image, mods[i].name) == 0)
+      break;
+  grub_test_assert (i < ARRAY_SIZE (mods), "unknown image `%s'", image);
+  if (i == ARRAY_SIZE (mods))
+    return 0;
+  grub_test_assert (size == image_size (i), "%s has %lu bytes instead of %lu",
+		    image, (unsigned long) size,
+		    (unsigned long) image_size (i));
+  for (j = strlen (image) + 1; j < size; j++)
+    if ((grub_uint8_t) image[j] != image_byte (i, j))
+      break;
+  grub_test_assert (j >= size, "%s is corrupted at byte %lu", image,
+		    (unsigned long) j);
+
+  if (nloaded < ARRAY_SIZE (loaded))
+    strcpy (loaded[nloaded++], image);
+
+  mod = grub_zalloc (sizeof (*mod));
+  mod->name = grub_strdup (image);
+  mod->ref_count = 1;
+  mod->next = grub_dl_head;
+  grub_dl_head = mod;
+  return mod;
+}
+
+static void
+unload_all (void)
+{
+  grub_dl_t mod, next;
+
+  for (mod = grub_dl_head; mod; mod = next)
+    {
+      next = mod->next;
+      grub_free (mod->name);
+      grub_free (mod);
+    }
+  grub_dl_head = 0;
+  nloaded = 0;
+}
+
+static void
+write_bundle (const char *path, int corrupt)
+{
+  struct grub_dl_bundle_header hdr;
+  struct grub_dl_bundle_entry entries[ARRAY_SIZE (mods)];
+  grub_uint32_t deps[2 * ARRAY_SIZE (mods)];
+  char names[64];
+  grub_uint32_t ndeps = 0, name_pos = 0, index_size, offset;
+  unsigned i, j;
+  FILE *fp;
+
+  for (i = 0; i < ARRAY_SIZE (mods); i++)
+    {
+      name_pos += strlen (mods[i].name) + 1;
+      ndeps += mods[i].ndeps;
+    }
+  index_size = sizeof (entries) + ndeps * sizeof (deps[0]) + name_pos;
+  offset = ALIGN_UP (sizeof (hdr) + index_size, GRUB_DL_BUNDLE_ALIGN);
+
+  ndeps = name_pos = 0;
+  for (i = 0; i < ARRAY_SIZE (mods); i++)
+    {
+      entries[i].offset = grub_cpu_to_le32 (offset);
+      entries[i].size = grub_cpu_to_le32 (image_size (i));
+      entries[i].name = grub_cpu_to_le32 (name_pos);
+      entries[i].first_dep = grub_cpu_to_le32 (ndeps);
+      entries[i].ndeps = grub_cpu_to_le32 (mods[i].ndeps);
+      for (j = 0; j < mods[i].ndeps; j++)
+	deps[ndeps++] = grub_cpu_to_le32 (mods[i].deps[j]);
+      strcpy (names + name_pos, mods[i].name);
+      name_pos += strlen (mods[i].name) + 1;
+      offset = ALIGN_UP (offset + image_size (i), GRUB_DL_BUNDLE_ALIGN);
+    }
+  /* A module may only depend on the ones before it.  */
+  if (corrupt)
+    deps[0] = grub_cpu_to_le32 (4);
+
+  memcpy (hdr.magic, GRUB_DL_BUNDLE_MAGIC, sizeof (hdr.magic));
+  hdr.nmods = grub_cpu_to_le32 (ARRAY_SIZE (mods));
+  hdr.ndeps = grub_cpu_to_le32 (ndeps);
+  hdr.index_size = grub_cpu_to_le32 (index_size);
+  hdr.reserved = 0;
+
+  fp = grub_util_fopen (path, "wb");
+  if (!fp)
+    grub_util_error ("cannot open `%s'", path);
+  fwrite (&hdr, sizeof (hdr), 1, fp);
+  fwrite (entries, sizeof (entries), 1, fp);
+  fwrite (deps, sizeof (deps[0]), ndeps, fp);
+  fwrite (names, 1, name_pos, fp);
+  offset = sizeof (hdr) + index_size;
+  for (i = 0; i < ARRAY_SIZE (mods); i++)
+    {
+      grub_size_t k;
+
+      for (; offset % GRUB_DL_BUNDLE_ALIGN; offset++)
+	fputc (0, fp);
+      fputs (mods[i].name, fp);
+      fputc (0, fp);
+      for (k = strlen (mods[i].name) + 1; k < image_size (i); k++)
+	fputc (image_byte (i, k), fp);
+      offset += image_size (i);
+    }
+  fclose (fp);
+}
+
+static void
+check_loaded (const char *what, const char *const *expected, unsigned n)
+{
+  unsigned i;
+
+  grub_test_assert (nloaded == n, "%s: %u modules loaded instead of %u",
+		    what, nloaded, n);
+  for (i = 0; i < n && i < nloaded; i++)
+    grub_test_assert (strcmp (loaded[i], expected[i]) == 0,
+		      "%s: module %u is %s instead of %s", what, i,
+		      loaded[i], expected[i]);
+}
+
+static void
+dl_bundle_test (void)
+{
+  static const char *const gamma_order[] = { "alpha", "beta", "gamma" };
+  static const char *const epsilon_order[] = { "delta", "epsilon" };
+  char *root, *platdir, *path, *prefix;
+  grub_dl_t mod;
+
+  grub_host_init ();
+  grub_hostfs_init ();
+
+  root = xstrdup ("/tmp/dl_bundle_test.XXXXXX");
+  if (!mkdtemp (root))
+    {
+      grub_test_assert (0, "cannot create a temporary directory");
+      return;
+    }
+  platdir = xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM, root);
+  mkdir (platdir, 0755);
+  path = xasprintf ("%s/" GRUB_DL_BUNDLE_NAME, platdir);
+  prefix = xasprintf ("(host)%s", root);
+
+  write_bundle (path, 0);
+
+  /* The dependencies come along, in order.  */
+  mod = grub_dl_load_bundled (prefix, "gamma");
+  grub_test_assert (mod && strcmp (mod->name, "gamma") == 0,
+		    "gamma was not loaded: %s", grub_errmsg);
+  grub_test_assert (!mod || mod->ref_count == 0,
+		    "gamma has %d references", mod ? mod->ref_count : 0);
+  check_loaded ("gamma", gamma_order, ARRAY_SIZE (gamma_order));
+
+  /* What is loaded already is not loaded again.  */
+  nloaded = 0;
+  mod = grub_dl_load_bundled (prefix, "epsilon");
+  grub_test_assert (mod && strcmp (mod->name, "epsilon") == 0,
+		    "epsilon was not loaded: %s", grub_errmsg);
+  check_loaded ("epsilon", epsilon_order, ARRAY_SIZE (epsilon_order));
+
+  /* Modules that are not in the bundle are left to the caller.  */
+  nloaded = 0;
+  mod = grub_dl_load_bundled (prefix, "zeta");
+  grub_test_assert (!mod && grub_errno == GRUB_ERR_NONE,
+		    "zeta was found: %s", grub_errmsg);
+  check_loaded ("zeta", NULL, 0);
+
+  /* So is everything if the bundle is broken.  The index is kept as long
+     as the file keeps its size, so drop it first.  */
+  unload_all ();
+  grub_dl_bundle_forget ();
+  write_bundle (path, 1);
+  mod = grub_dl_load_bundled (prefix, "gamma");
+  grub_test_assert (!mod && grub_errno == GRUB_ERR_NONE,
+		    "a broken bundle was used: %s", grub_errmsg);
+  check_loaded ("broken", NULL, 0);
+
+  unload_all ();
+  grub_dl_bundle_forget ();
+  unlink (path);
+  rmdir (platdir);
+  rmdir (root);
+  free (prefix);
+  free (path);
+  free (platdir);
+  free (root);
+
+  grub_hostfs_fini ();
+  grub_host_fini ();
+}
+
+GRUB_UNIT_TEST ("dl_bundle_unit_test", dl_bundle_test);
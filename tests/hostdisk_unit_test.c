@@ -0,0 +1,171 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config-util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <grub/test.h>
+#include <grub/types.h>
+#include <grub/disk.h>
+#include <grub/emu/hostdisk.h>
+
+/* Large enough to span many disk cache blocks.  */
+#define IMAGE_SIZE (1 << 20)
+#define RANDOM_READS 20000
+#define RANDOM_SIZE 4096
+#define SEQ_SIZE 65536
+#define SEQ_PASSES 64
+
+static grub_uint8_t
+pattern (grub_uint64_t pos)
+{
+  return (pos >> 9) * 31 + pos;
+}
+
+static int
+check (const grub_uint8_t *buf, grub_uint64_t pos, grub_size_t len)
+{
+  grub_size_t i;
+
+  for (i = 0; i < len; i++)
+    if (buf[i] != pattern (pos + i))
+      return 0;
+  return 1;
+}
+
+static int
+read_at (grub_disk_t disk, grub_uint64_t pos, grub_size_t len, void *buf)
+{
+  return grub_disk_read (disk, pos >> GRUB_DISK_SECTOR_BITS,
+			 pos & (GRUB_DISK_SECTOR_SIZE - 1), len, buf)
+    == GRUB_ERR_NONE;
+}
+
+static grub_uint64_t
+random_pos (grub_uint32_t *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return ((*seed >> 4) % (IMAGE_SIZE - RANDOM_SIZE)) & ~(grub_uint64_t) 7;
+}
+
+static void
+check_reads (grub_disk_t disk)
+{
+  static grub_uint8_t buf[SEQ_SIZE];
+  grub_uint32_t seed = 1;
+  grub_uint64_t pos = 0;
+  int i, ok = 1;
+
+  grub_disk_cache_invalidate_all ();
+  for (i = 0; i < 256 && ok; i++)
+    {
+      pos = random_pos (&seed);
+      ok = read_at (disk, pos, RANDOM_SIZE, buf) && check (buf, pos, RANDOM_SIZE);
+    }
+  grub_test_assert (ok, "random read mismatch at %llu",
+		    (unsigned long long) pos);
+  grub_disk_cache_invalidate_all ();
+  for (pos = 0; pos < IMAGE_SIZE && ok; pos += SEQ_SIZE)
+    ok = read_at (disk, pos, SEQ_SIZE, buf) && check (buf, pos, SEQ_SIZE);
+  grub_test_assert (ok, "sequential read mismatch at %llu",
+		    (unsigned long long) pos);
+}
+
+/* Random RANDOM_SIZE reads, then SEQ_PASSES sequential passes over the
+   image, each starting with a cold disk cache.  The image stays in the
+   host page cache, so this times the host read path, not the device.  */
+static void
+bench (grub_disk_t disk)
+{
+  static grub_uint8_t buf[SEQ_SIZE];
+  grub_uint32_t seed = 1;
+  clock_t start;
+  double secs, rate, seq;
+  grub_uint64_t pos;
+  int i;
+
+  grub_disk_cache_invalidate_all ();
+  start = clock ();
+  for (i = 0; i < RANDOM_READS; i++)
+    read_at (disk, random_pos (&seed), RANDOM_SIZE, buf);
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  rate = secs > 0 ? RANDOM_READS / secs : 0;
+
+  start = clock ();
+  for (i = 0; i < SEQ_PASSES; i++)
+    {
+      grub_disk_cache_invalidate_all ();
+      for (pos = 0; pos < IMAGE_SIZE; pos += SEQ_SIZE)
+	read_at (disk, pos, SEQ_SIZE, buf);
+    }
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  seq = secs > 0 ? (double) SEQ_PASSES * IMAGE_SIZE / secs / 1e6 : 0;
+
+  printf ("hostdisk: random %d KiB reads: %.0f/s; sequential: %.0f MB/s\n",
+	  RANDOM_SIZE >> 10, rate, seq);
+}
+
+static void
+hostdisk_test (void)
+{
+  grub_uint8_t *buf;
+  grub_disk_t disk;
+  char *image;
+  const char *name;
+  FILE *f;
+  int i;
+
+  buf = malloc (IMAGE_SIZE);
+  if (!buf)
+    {
+      grub_test_assert (0, "out of memory");
+      return;
+    }
+  for (i = 0; i < IMAGE_SIZE; i++)
+    buf[i] = pattern (i);
+
+  image = grub_util_make_temporary_file ();
+  f = fopen (image, "wb");
+  grub_test_assert (f && fwrite (buf, 1, IMAGE_SIZE, f) == IMAGE_SIZE
+		    && fclose (f) == 0, "cannot write %s", image);
+  free (buf);
+
+  grub_util_biosdisk_init (NULL);
+  name = grub_hostdisk_os_dev_to_grub_drive (image, 1);
+
+  disk = grub_disk_open (name);
+  grub_test_assert (disk != NULL, "cannot open %s", name);
+  if (disk)
+    {
+      check_reads (disk);
+      /* Timings are only wanted when working on the read path.  */
+      if (getenv ("GRUB_TEST_BENCH"))
+	bench (disk);
+      grub_disk_close (disk);
+    }
+
+  grub_util_biosdisk_fini ();
+  unlink (image);
+  free (image);
+}
+
+GRUB_UNIT_TEST ("hostdisk_unit_test", hostdisk_test);
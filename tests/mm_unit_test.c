@@ -0,0 +1,275 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The utilities use the host allocator, so build the firmware one here
+   under other names and give it a heap of its own.  */
+#define grub_malloc test_mm_malloc
+#define grub_zalloc test_mm_zalloc
+#define grub_free test_mm_free
+#define grub_realloc test_mm_realloc
+#define grub_memalign test_mm_memalign
+#define grub_mm_init_region test_mm_init_region
+#define grub_mm_base test_mm_base
+#define grub_mm_get_slab_stats test_mm_get_slab_stats
+
+#include "../grub-core/kern/mm.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <grub/test.h>
+
+#define HEAP_SIZE (64 << 20)
+#define SLOTS 4096
+#define STEPS 400000
+#define BENCH_LIVE 16384
+#define BENCH_RING 64
+#define BENCH_ROUNDS 1000000
+
+static grub_uint32_t seed = 1;
+
+static grub_uint32_t
+rnd (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static grub_size_t
+random_size (void)
+{
+  /* Mostly small, sometimes large, like the callers in the tree.  */
+  if (rnd () % 10)
+    return rnd () % (1 << (rnd () % 12));
+  return rnd () % 65536;
+}
+
+static struct
+{
+  char *ptr;
+  grub_size_t size;
+  grub_uint8_t fill;
+} slots[SLOTS];
+
+static int
+check_fill (int i)
+{
+  grub_size_t j;
+
+  for (j = 0; j < slots[i].size; j++)
+    if ((grub_uint8_t) slots[i].ptr[j] != slots[i].fill)
+      return 0;
+  return 1;
+}
+
+static void
+stress (void)
+{
+  int step, i;
+
+  for (step = 0; step < STEPS; step++)
+    {
+      i = rnd () % SLOTS;
+      if (!slots[i].ptr)
+	{
+	  grub_size_t size = random_size ();
+	  grub_size_t j;
+	  unsigned how = rnd () % 4;
+
+	  if (how == 0)
+	    {
+	      slots[i].ptr = test_mm_zalloc (size);
+	      for (j = 0; slots[i].ptr && j < size; j++)
+		if (slots[i].ptr[j])
+		  break;
+	      grub_test_assert (j == size, "zalloc (%lu) is not zeroed",
+				(unsigned long) size);
+	    }
+	  else if (how == 1)
+	    {
+	      slots[i].ptr = test_mm_memalign (64, size);
+	      grub_test_assert (((grub_addr_t) slots[i].ptr & 63) == 0,
+				"memalign (64) returned %p", slots[i].ptr);
+	    }
+	  else
+	    slots[i].ptr = test_mm_malloc (size);
+	  grub_test_assert (slots[i].ptr != NULL, "allocating %lu bytes failed",
+			    (unsigned long) size);
+	  grub_test_assert (((grub_addr_t) slots[i].ptr & 15) == 0,
+			    "%p is not aligned", slots[i].ptr);
+	  slots[i].size = size;
+	  slots[i].fill = rnd ();
+	  memset (slots[i].ptr, slots[i].fill, size);
+	  continue;
+	}
+
+      grub_test_assert (check_fill (i), "block %p of %lu bytes was clobbered",
+			slots[i].ptr, (unsigned long) slots[i].size);
+
+      switch (rnd () % 4)
+	{
+	case 0:
+	case 1:
+	  test_mm_free (slots[i].ptr);
+	  slots[i].ptr = NULL;
+	  break;
+
+	case 2:
+	  {
+	    grub_size_t size = random_size () + 1;
+	    char *p = test_mm_realloc (slots[i].ptr, size);
+
+	    grub_test_assert (p != NULL, "realloc to %lu bytes failed",
+			      (unsigned long) size);
+	    if (size < slots[i].size)
+	      slots[i].size = size;
+	    slots[i].ptr = p;
+	    grub_test_assert (check_fill (i), "realloc lost data");
+	    memset (p, slots[i].fill, size);
+	    slots[i].size = size;
+	  }
+	  break;
+
+	default:
+	  break;
+	}
+    }
+
+  for (i = 0; i < SLOTS; i++)
+    if (slots[i].ptr)
+      {
+	grub_test_assert (check_fill (i), "block %p was clobbered",
+			  slots[i].ptr);
+	test_mm_free (slots[i].ptr);
+	slots[i].ptr = NULL;
+      }
+}
+
+static int
+free_blocks (grub_size_t *largest)
+{
+  grub_mm_region_t r;
+  int n = 0;
+
+  *largest = 0;
+  for (r = test_mm_base; r; r = r->next)
+    {
+      grub_mm_header_t p = r->first;
+
+      if (p->magic != GRUB_MM_FREE_MAGIC)
+	continue;
+      do
+	{
+	  if ((p->size << GRUB_MM_ALIGN_LOG2) > *largest)
+	    *largest = p->size << GRUB_MM_ALIGN_LOG2;
+	  n++;
+	  p = p->next;
+	}
+      while (p != r->first);
+    }
+  return n;
+}
+
+static double
+bench (int use_slabs)
+{
+  static void *live[BENCH_LIVE];
+  void *ring[BENCH_RING];
+  static const grub_size_t sizes[] = { 24, 40, 64, 100, 200, 512 };
+  clock_t start;
+  double secs;
+  int i;
+
+  /* Leave the heap full of holes, as after a while of real use.  */
+  for (i = 0; i < BENCH_LIVE; i++)
+    live[i] = test_mm_memalign (0, 16 + rnd () % 4096);
+  for (i = 0; i < BENCH_LIVE; i += 2)
+    test_mm_free (live[i]);
+
+  memset (ring, 0, sizeof (ring));
+  start = clock ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+      grub_size_t size = sizes[i % ARRAY_SIZE (sizes)];
+      void **slot = &ring[i % BENCH_RING];
+
+      test_mm_free (*slot);
+      *slot = use_slabs ? test_mm_malloc (size) : test_mm_memalign (0, size);
+    }
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+  for (i = 0; i < BENCH_RING; i++)
+    test_mm_free (ring[i]);
+  for (i = 1; i < BENCH_LIVE; i += 2)
+    test_mm_free (live[i]);
+
+  return secs > 0 ? BENCH_ROUNDS / secs / 1e6 : 0;
+}
+
+static void
+mm_test (void)
+{
+  struct grub_mm_slab_stats stats[GRUB_MM_SLAB_CLASSES];
+  grub_size_t largest, heap_size;
+  char *heap;
+  unsigned i;
+  double region, slab;
+
+  heap = malloc (HEAP_SIZE);
+  if (!heap)
+    {
+      grub_test_assert (0, "out of memory");
+      return;
+    }
+  test_mm_init_region (heap, HEAP_SIZE);
+  heap_size = test_mm_base->size;
+
+  stress ();
+
+  test_mm_get_slab_stats (stats);
+  for (i = 0; i < GRUB_MM_SLAB_CLASSES; i++)
+    {
+      grub_test_assert (stats[i].used == 0, "%lu objects of %lu bytes leaked",
+			(unsigned long) stats[i].used,
+			(unsigned long) stats[i].obj_size);
+      grub_test_assert (stats[i].slabs <= 1, "%lu empty slabs of %lu bytes kept",
+			(unsigned long) stats[i].slabs,
+			(unsigned long) stats[i].obj_size);
+    }
+
+  /* With the spare slabs gone, everything must merge back together.  */
+  slab_release_empty ();
+  grub_test_assert (free_blocks (&largest) == 1 && largest == heap_size,
+		    "heap did not coalesce: %d free blocks, largest %lu of %lu",
+		    free_blocks (&largest), (unsigned long) largest,
+		    (unsigned long) heap_size);
+
+  region = bench (0);
+  slab = bench (1);
+  printf ("mm: small malloc/free pairs on a fragmented heap: "
+	  "regions %.2f M/s, slabs %.2f M/s\n", region, slab);
+
+  slab_release_empty ();
+  grub_test_assert (free_blocks (&largest) == 1 && largest == heap_size,
+		    "heap did not coalesce after the benchmark");
+
+  free (heap);
+}
+
+GRUB_UNIT_TEST ("mm_unit_test", mm_test);
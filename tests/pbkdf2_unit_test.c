@@ -0,0 +1,148 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <grub/test.h>
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/crypto.h>
+
+#define BENCH_ITERATIONS 100000
+
+/* PBKDF2 the way the library used to compute it, one full HMAC per
+   iteration.  */
+static gcry_err_code_t
+pbkdf2_reference (const struct gcry_md_spec *md,
+		  const grub_uint8_t *P, grub_size_t Plen,
+		  const grub_uint8_t *S, grub_size_t Slen,
+		  unsigned int c, grub_uint8_t *DK, grub_size_t dkLen)
+{
+  unsigned int hLen = md->mdlen;
+  grub_uint8_t U[GRUB_CRYPTO_MAX_MDLEN], T[GRUB_CRYPTO_MAX_MDLEN];
+  grub_uint8_t tmp[256];
+  unsigned int i, u, k, l, r;
+  gcry_err_code_t rc;
+
+  l = ((dkLen - 1) / hLen) + 1;
+  r = dkLen - (l - 1) * hLen;
+  memcpy (tmp, S, Slen);
+
+  for (i = 1; i <= l; i++)
+    {
+      tmp[Slen + 0] = i >> 24;
+      tmp[Slen + 1] = i >> 16;
+      tmp[Slen + 2] = i >> 8;
+      tmp[Slen + 3] = i;
+      memset (T, 0, hLen);
+      for (u = 0; u < c; u++)
+	{
+	  if (u == 0)
+	    rc = grub_crypto_hmac_buffer (md, P, Plen, tmp, Slen + 4, U);
+	  else
+	    rc = grub_crypto_hmac_buffer (md, P, Plen, U, hLen, U);
+	  if (rc)
+	    return rc;
+	  for (k = 0; k < hLen; k++)
+	    T[k] ^= U[k];
+	}
+      memcpy (DK + (i - 1) * hLen, T, i == l ? r : hLen);
+    }
+  return GPG_ERR_NO_ERROR;
+}
+
+static double
+bench (gcry_err_code_t (*fn) (const struct gcry_md_spec *,
+			      const grub_uint8_t *, grub_size_t,
+			      const grub_uint8_t *, grub_size_t,
+			      unsigned int, grub_uint8_t *, grub_size_t),
+       const struct gcry_md_spec *md)
+{
+  grub_uint8_t dk[GRUB_CRYPTO_MAX_MDLEN];
+  clock_t start;
+  double secs;
+
+  start = clock ();
+  fn (md, (const grub_uint8_t *) "password", 8,
+      (const grub_uint8_t *) "salt", 4, BENCH_ITERATIONS, dk, md->mdlen);
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  return secs > 0 ? BENCH_ITERATIONS / secs : 0;
+}
+
+static void
+pbkdf2_unit_test (void)
+{
+  static const char *const hashes[] = { "sha1", "sha256", "sha512" };
+  /* Longer than any hash block, so the key gets hashed first.  */
+  static const char long_pass[] =
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+    "0123456789";
+  const struct gcry_md_spec *md;
+  grub_uint8_t dk[200], ref[200];
+  gcry_err_code_t err;
+  unsigned h, len;
+
+  grub_gcry_init_all ();
+
+  /* RFC 6070.  */
+  md = grub_crypto_lookup_md_by_name ("sha1");
+  grub_test_assert (md != NULL, "sha1 not available");
+  if (!md)
+    return;
+  err = grub_crypto_pbkdf2 (md, (const grub_uint8_t *) "password", 8,
+			    (const grub_uint8_t *) "salt", 4, 4096, dk, 20);
+  grub_test_assert (err == GPG_ERR_NO_ERROR
+		    && memcmp (dk, "\x4b\x00\x79\x01\xb7\x65\x48\x9a\xbe\xad"
+			       "\x49\xd9\x26\xf7\x21\xd0\x65\xa4\x29\xc1",
+			       20) == 0, "RFC 6070 vector mismatch");
+
+  for (h = 0; h < ARRAY_SIZE (hashes); h++)
+    {
+      md = grub_crypto_lookup_md_by_name (hashes[h]);
+      grub_test_assert (md != NULL, "%s not available", hashes[h]);
+      if (!md)
+	continue;
+
+      /* Output lengths on and off the digest boundary, short and long
+	 passwords.  */
+      for (len = 1; len <= sizeof (dk); len += 33)
+	{
+	  err = grub_crypto_pbkdf2 (md, (const grub_uint8_t *) long_pass,
+				    len % 2 ? sizeof (long_pass) - 1 : 6,
+				    (const grub_uint8_t *) "NaCl", 4, 17,
+				    dk, len);
+	  grub_test_assert (err == GPG_ERR_NO_ERROR, "%s: pbkdf2 failed",
+			    hashes[h]);
+	  pbkdf2_reference (md, (const grub_uint8_t *) long_pass,
+			    len % 2 ? sizeof (long_pass) - 1 : 6,
+			    (const grub_uint8_t *) "NaCl", 4, 17, ref, len);
+	  grub_test_assert (memcmp (dk, ref, len) == 0,
+			    "%s: mismatch for length %u", hashes[h], len);
+	}
+
+      printf ("pbkdf2-%s: %.0f iterations/s (full HMAC per iteration: "
+	      "%.0f iterations/s)\n", hashes[h],
+	      bench (grub_crypto_pbkdf2, md), bench (pbkdf2_reference, md));
+    }
+
+  grub_gcry_fini_all ();
+}
+
+GRUB_UNIT_TEST ("pbkdf2_unit_test", pbkdf2_unit_test);
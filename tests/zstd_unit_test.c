@@ -0,0 +1,819 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <grub/test.h>
+#include <grub/types.h>
+#include <grub/err.h>
+#include <grub/misc.h>
+#include <grub/zstd.h>
+
+#define BENCH_ROUNDS 200
+
+/* The frames below were produced by the zstd command line tool from the
+   data the fill_* functions generate.  */
+static grub_uint32_t seed;
+
+static unsigned
+next_random (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+static void
+fill_words (grub_uint8_t *buf, grub_size_t size)
+{
+  static const char *words[] =
+    {
+      "grub", "boot", "kernel", "module", "disk", "sector", "linux", "initrd",
+      "menuentry", "search", "set", "root", "insmod", "part_gpt", "ext2",
+      "echo"
+    };
+  grub_size_t i = 0;
+
+  while (i < size)
+    {
+      const char *w = words[next_random () & 15];
+
+      for (; *w && i < size; w++)
+	buf[i++] = *w;
+      if (i < size)
+	buf[i++] = (next_random () & 7) ? ' ' : '\n';
+    }
+}
+
+/* 4K of words repeated over and over with an occasional changed byte: long
+   matches, many blocks and plenty of repeat offsets.  */
+static void
+fill_repeats (grub_uint8_t *buf, grub_size_t size)
+{
+  grub_size_t i;
+
+  fill_words (buf, size < 4096 ? size : 4096);
+  for (i = 4096; i < size; i++)
+    buf[i] = buf[i - 4096];
+  for (i = 4096; i < size; i += 1000)
+    buf[i] = 'a' + next_random () % 26;
+}
+
+static void
+fill_noise (grub_uint8_t *buf, grub_size_t size)
+{
+  grub_size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = next_random ();
+}
+
+static void
+fill_zeros (grub_uint8_t *buf, grub_size_t size)
+{
+  memset (buf, 0, size);
+}
+
+/* zstd -19 of fill_words (3000 bytes).  */
+static const grub_uint8_t words_l19[] =
+  {
+    0x28, 0xb5, 0x2f, 0xfd, 0x64, 0xb8, 0x0a, 0x4d, 0x14, 0x00, 0x52, 0x86,
+    0x12, 0x11, 0xb0, 0xeb, 0x60, 0x94, 0xa2, 0xad, 0xaa, 0x69, 0xa3, 0x6a,
+    0xa3, 0x61, 0x42, 0x1c, 0x83, 0x66, 0x1d, 0xff, 0xff, 0xff, 0x7c, 0xfe,
+    0x78, 0x6c, 0x22, 0xf7, 0xea, 0x5b, 0x5d, 0xa0, 0xa1, 0xfe, 0x10, 0x16,
+    0xea, 0x98, 0x35, 0x51, 0xf5, 0x0a, 0x5b, 0xf9, 0x56, 0x57, 0xb8, 0xd1,
+    0xa2, 0x64, 0x87, 0x68, 0x61, 0xcb, 0x2d, 0xca, 0x6e, 0x26, 0x34, 0x8b,
+    0x96, 0xc9, 0xa1, 0x92, 0x4a, 0x97, 0x35, 0x71, 0x36, 0x63, 0x23, 0xe1,
+    0x5b, 0xa4, 0x02, 0x81, 0x3b, 0xa8, 0x91, 0x2f, 0x29, 0x29, 0x14, 0xda,
+    0x33, 0x21, 0x08, 0x01, 0x84, 0x91, 0x28, 0x97, 0xf4, 0x06, 0x11, 0x20,
+    0x34, 0x49, 0x30, 0x61, 0x94, 0xcc, 0x5c, 0x90, 0x34, 0x06, 0x5d, 0x0d,
+    0x37, 0xf2, 0xe0, 0x3e, 0x28, 0x81, 0xdc, 0x3c, 0x16, 0x53, 0x60, 0x67,
+    0x4a, 0xbd, 0x7b, 0xab, 0x49, 0x9a, 0xe5, 0xa6, 0x73, 0x6f, 0xb6, 0xe2,
+    0xbe, 0x5d, 0xe8, 0xa0, 0x8c, 0xe5, 0xfa, 0xb9, 0xd1, 0x60, 0x23, 0x3c,
+    0x9a, 0xbd, 0xae, 0xa2, 0xe5, 0x17, 0xc5, 0x5a, 0xe7, 0x34, 0x65, 0x53,
+    0x3e, 0x67, 0xcd, 0x46, 0x39, 0xf2, 0xb2, 0xa2, 0x6a, 0x8c, 0xeb, 0x92,
+    0x64, 0x31, 0xef, 0x21, 0x08, 0x90, 0xc2, 0x5c, 0xe0, 0x69, 0x70, 0x45,
+    0x0b, 0xe8, 0xb1, 0x69, 0x94, 0xbb, 0x28, 0x8f, 0x2c, 0x60, 0x0a, 0x8b,
+    0x87, 0x2f, 0xb1, 0x9f, 0xf6, 0x87, 0xe0, 0x2c, 0xa4, 0xf8, 0xd6, 0x33,
+    0x29, 0xa0, 0xa4, 0x70, 0xef, 0x14, 0x92, 0x00, 0xd7, 0x80, 0x9d, 0x21,
+    0x30, 0x27, 0x75, 0x26, 0x38, 0x35, 0x62, 0x57, 0x83, 0x63, 0x8b, 0x62,
+    0x9b, 0x8a, 0xcc, 0xaf, 0x38, 0x83, 0x58, 0x45, 0xba, 0x54, 0xc6, 0x02,
+    0x05, 0x7d, 0x96, 0x3a, 0x1a, 0x27, 0x15, 0xb2, 0x97, 0x56, 0x29, 0x52,
+    0x53, 0x40, 0x36, 0xfe, 0x0f, 0x38, 0xab, 0xc7, 0xe5, 0x99, 0x9f, 0x2a,
+    0xc3, 0x8f, 0x60, 0x81, 0xc1, 0xd3, 0x5a, 0xaf, 0x81, 0x38, 0x92, 0x42,
+    0x4d, 0x9c, 0xf5, 0xf8, 0x61, 0x8c, 0x05, 0xde, 0xb1, 0x65, 0x60, 0xb5,
+    0x68, 0x05, 0xcb, 0x4d, 0xd0, 0x99, 0x96, 0x8d, 0xb8, 0xcc, 0xc4, 0x31,
+    0xa2, 0xde, 0x4b, 0x27, 0xe5, 0xc1, 0xdb, 0x96, 0x30, 0x77, 0x7f, 0x55,
+    0x2f, 0xa5, 0xa8, 0x85, 0x70, 0xab, 0xf9, 0xaf, 0x70, 0x18, 0x6d, 0x46,
+    0x06, 0xcc, 0x22, 0x47, 0x47, 0x6a, 0x10, 0xd4, 0xd0, 0x33, 0xe0, 0x9c,
+    0xfc, 0x1d, 0xa5, 0xe6, 0x83, 0xe9, 0x0d, 0xf0, 0x40, 0x25, 0x7e, 0x28,
+    0xb6, 0x42, 0x60, 0xec, 0xdc, 0x6d, 0x70, 0x12, 0xde, 0x1a, 0x24, 0x81,
+    0x23, 0xfa, 0x99, 0x23, 0xd5, 0x74, 0x80, 0x0c, 0x65, 0x9e, 0xaf, 0x68,
+    0xc5, 0x43, 0x5a, 0xfa, 0x0a, 0x07, 0xa3, 0x0f, 0xcf, 0x48, 0xbe, 0x7c,
+    0x55, 0x43, 0xc2, 0xf2, 0xda, 0x9a, 0x83, 0x98, 0x0b, 0xa3, 0xea, 0x11,
+    0x68, 0x90, 0x7a, 0xb0, 0xa7, 0x34, 0x57, 0x64, 0x46, 0x14, 0xd6, 0x3b,
+    0xc6, 0x7f, 0x57, 0x49, 0x70, 0xc4, 0xca, 0xbe, 0x00, 0xc4, 0x29, 0x9e,
+    0xb1, 0xf7, 0x82, 0x58, 0x7a, 0x20, 0x39, 0xf2, 0x8f, 0xed, 0x88, 0x11,
+    0xdc, 0x27, 0xd9, 0x01, 0xf8, 0xdd, 0x81, 0x7a, 0x82, 0x6b, 0x44, 0xcf,
+    0x18, 0xc5, 0x86, 0x25, 0xad, 0x18, 0xe8, 0x0a, 0x82, 0x21, 0xce, 0x37,
+    0xdd, 0x30, 0x49, 0x1d, 0xe2, 0x2c, 0x7b, 0xd9, 0x66, 0xd6, 0xb0, 0xd0,
+    0xe6, 0x35, 0x90, 0x92, 0x50, 0xa3, 0x0d, 0xc7, 0x92, 0x43, 0x23, 0x07,
+    0x17, 0x58, 0x84, 0xec, 0x08, 0xa0, 0xff, 0x4a, 0x2d, 0x56, 0x65, 0x3e,
+    0x43, 0xcb, 0x26, 0x1a, 0x3f, 0xa2, 0x66, 0x30, 0x43, 0xa1, 0xd1, 0x86,
+    0x99, 0xad, 0x33, 0x47, 0x3f, 0x26, 0x8d, 0x01, 0x26, 0x17, 0xf0, 0x43,
+    0x09, 0xb6, 0x85, 0x59, 0x71, 0x4d, 0x10, 0x41, 0xc5, 0x5a, 0x4a, 0xca,
+    0xbd, 0x62, 0x13, 0x8a, 0x78, 0xd0, 0x76, 0x89, 0x64, 0xee, 0x78, 0xfb,
+    0xfd, 0xad, 0x93, 0x40, 0xd5, 0xa8, 0x4c, 0xa9, 0x08, 0xdd, 0x17, 0xdb,
+    0xba, 0xfd, 0xbe, 0x33, 0x2d, 0xbe, 0x8e, 0x92, 0xeb, 0x6d, 0x7b, 0xb1,
+    0x79, 0x6d, 0x74, 0x4c, 0x77, 0x05, 0x32, 0x8b, 0xe0, 0x03, 0x2f, 0x75,
+    0x36, 0x9a, 0x50, 0x55, 0x3d, 0x52, 0xa0, 0xb8, 0x3d, 0xa1, 0xa2, 0x33,
+    0x51, 0x72, 0x4d, 0x41, 0x96, 0x92, 0xff, 0xe9, 0xae, 0x3f, 0x34, 0x01,
+    0x37, 0x69, 0x18, 0xf1, 0x97, 0x05, 0x59, 0xc6, 0x93, 0x90, 0xb1, 0x03,
+    0x5a, 0x95, 0x0d, 0x68, 0x5b, 0xac, 0x5d, 0xbf, 0x8f, 0x5c, 0x96, 0x0c,
+    0x60, 0xd0, 0x62, 0x41, 0x78, 0x65, 0x4f, 0x87, 0xdb, 0xdf, 0x36, 0xe9,
+    0x8b, 0xea, 0x5d, 0xa1, 0xe7, 0x44, 0x44, 0x05, 0xc0, 0x52, 0x03, 0x75,
+    0x2e, 0x78, 0x80,
+  };
+
+/* zstd -3 of fill_repeats (300000 bytes).  */
+static const grub_uint8_t repeats_l3[] =
+  {
+    0x28, 0xb5, 0x2f, 0xfd, 0xa4, 0xe0, 0x93, 0x04, 0x00, 0xb4, 0x31, 0x00,
+    0x46, 0x5a, 0x44, 0x17, 0x80, 0xa5, 0xed, 0x66, 0x1f, 0xdd, 0x9d, 0xe0,
+    0x4a, 0x3f, 0x5f, 0xda, 0x63, 0x92, 0xd8, 0xcd, 0xc0, 0x2c, 0x23, 0xcf,
+    0x51, 0xed, 0xf4, 0x3b, 0x00, 0x3a, 0x00, 0x3f, 0x00, 0xa7, 0xa4, 0x23,
+    0xfd, 0x9b, 0x6b, 0x33, 0x01, 0xfc, 0x91, 0xf7, 0xa7, 0xb4, 0x90, 0x7e,
+    0x9f, 0xde, 0xfc, 0x85, 0x19, 0xb3, 0x58, 0x86, 0xd3, 0x7d, 0xba, 0x7d,
+    0xba, 0xe9, 0xd7, 0xd5, 0xe3, 0x53, 0x12, 0x0d, 0x27, 0x5f, 0xbd, 0x57,
+    0x43, 0xc0, 0xb7, 0xa0, 0x0e, 0xb9, 0x9a, 0x2b, 0x72, 0x3b, 0xd1, 0x3d,
+    0x73, 0xdf, 0x33, 0xe3, 0x1d, 0x6b, 0xb5, 0x08, 0x8b, 0x4f, 0x61, 0x4d,
+    0x50, 0x38, 0x4e, 0x59, 0xa5, 0xae, 0xdc, 0x1b, 0xa4, 0x28, 0x12, 0xe1,
+    0x3e, 0xd8, 0x67, 0x9f, 0x6e, 0x98, 0x7e, 0x68, 0x6d, 0xdd, 0x86, 0xc8,
+    0xd5, 0xa4, 0xdb, 0xa7, 0x9b, 0xdd, 0x33, 0xb7, 0xb5, 0x99, 0xe1, 0xe4,
+    0x66, 0xb8, 0x7a, 0xe0, 0x53, 0xd2, 0x9a, 0xbf, 0xa4, 0xb7, 0xd9, 0xa7,
+    0x9f, 0xa5, 0xe3, 0xea, 0x81, 0x03, 0x69, 0x19, 0x0d, 0x8a, 0x68, 0x95,
+    0xdf, 0x4c, 0xc2, 0xa0, 0x8b, 0x52, 0x50, 0x31, 0x11, 0x0e, 0x7d, 0x38,
+    0x2e, 0x7c, 0x81, 0x1b, 0x5d, 0x28, 0xb3, 0x41, 0x67, 0x53, 0x32, 0x8a,
+    0xc1, 0xc4, 0x9d, 0x46, 0x10, 0x02, 0x6d, 0x73, 0xd2, 0xeb, 0x35, 0x02,
+    0x3f, 0x4e, 0xdd, 0xe9, 0x6e, 0x4a, 0xee, 0x40, 0x74, 0x0c, 0x52, 0x7b,
+    0xa0, 0x54, 0x62, 0x10, 0x2e, 0xda, 0x60, 0xab, 0xd2, 0xac, 0xce, 0xbc,
+    0x3f, 0x6a, 0x81, 0xf7, 0x85, 0x4c, 0x10, 0x17, 0x82, 0x55, 0x00, 0xf2,
+    0xbe, 0xfb, 0xc9, 0xad, 0x5b, 0xf6, 0x81, 0x57, 0xe9, 0x8c, 0x3d, 0x02,
+    0x2a, 0x18, 0x35, 0x0c, 0x71, 0x2e, 0x59, 0xe0, 0x8c, 0x3d, 0xb8, 0x00,
+    0x1f, 0x2f, 0x47, 0xbc, 0xb6, 0x7f, 0xbf, 0x80, 0x60, 0x06, 0x1a, 0xd3,
+    0x3a, 0xc7, 0xb0, 0x3a, 0x0f, 0x87, 0x82, 0x71, 0x2d, 0x23, 0x47, 0xe0,
+    0x82, 0xae, 0xa8, 0x62, 0xac, 0xa5, 0x49, 0x25, 0xed, 0x6f, 0x42, 0x0b,
+    0x1a, 0x8a, 0x43, 0x79, 0x9c, 0x4b, 0x1f, 0x12, 0x60, 0xf0, 0x38, 0x90,
+    0xc4, 0x51, 0x0e, 0x64, 0x14, 0x21, 0x84, 0x10, 0x01, 0x11, 0x12, 0xe1,
+    0xff, 0xa9, 0x42, 0x3f, 0x6c, 0x91, 0x11, 0x61, 0x9a, 0x11, 0x61, 0xca,
+    0x20, 0x61, 0xc9, 0x98, 0x30, 0xc8, 0x80, 0xb0, 0x67, 0x98, 0xb0, 0x66,
+    0x4c, 0x18, 0x65, 0x4c, 0x58, 0x32, 0x40, 0x18, 0x30, 0x20, 0xcc, 0x30,
+    0x26, 0x2c, 0x18, 0x22, 0x4c, 0x18, 0x10, 0x26, 0x19, 0x10, 0x06, 0x0c,
+    0x10, 0x36, 0x8c, 0x09, 0x13, 0x8c, 0x08, 0x13, 0x06, 0xc8, 0x4b, 0xc2,
+    0x84, 0x11, 0xf2, 0x46, 0x18, 0x60, 0x90, 0xb0, 0x21, 0x4f, 0x98, 0x10,
+    0x66, 0xc8, 0x23, 0x23, 0x08, 0x23, 0x36, 0xc2, 0x00, 0x76, 0xf2, 0x0e,
+    0x61, 0x84, 0x81, 0xb0, 0xc0, 0x90, 0x30, 0xc0, 0x80, 0x30, 0x23, 0x4f,
+    0xb0, 0x12, 0xc6, 0x30, 0x11, 0x56, 0x8c, 0x21, 0xec, 0x6c, 0x10, 0x06,
+    0x4c, 0x08, 0x23, 0xcc, 0x09, 0x03, 0x6c, 0x84, 0x39, 0x06, 0x08, 0x3b,
+    0x43, 0x08, 0x0b, 0x23, 0xc2, 0x08, 0x46, 0xc2, 0x02, 0x03, 0xc2, 0x80,
+    0x01, 0xc2, 0x9c, 0x11, 0xc2, 0xc2, 0x10, 0x61, 0x82, 0x91, 0x30, 0x81,
+    0x81, 0x30, 0x60, 0x00, 0x61, 0x67, 0x84, 0x30, 0x61, 0x44, 0x98, 0x60,
+    0x48, 0x58, 0x60, 0x20, 0x0c, 0x30, 0x40, 0xd8, 0x19, 0x42, 0x58, 0x18,
+    0x91, 0x47, 0x08, 0x73, 0x76, 0x08, 0x33, 0x46, 0x84, 0x05, 0xc3, 0x84,
+    0xa9, 0x20, 0x42, 0x08, 0x53, 0xcc, 0x10, 0x76, 0x66, 0x10, 0x06, 0x26,
+    0x84, 0x21, 0xe4, 0x91, 0x11, 0xc2, 0x84, 0x11, 0x61, 0x82, 0x21, 0x61,
+    0x81, 0x81, 0x30, 0xc0, 0x00, 0x61, 0x67, 0x08, 0x61, 0x61, 0x44, 0x18,
+    0xc1, 0x48, 0x58, 0x60, 0x40, 0x18, 0x30, 0x40, 0x98, 0x33, 0x42, 0x58,
+    0x18, 0x22, 0x4c, 0x30, 0x12, 0x26, 0x30, 0x10, 0x06, 0x0c, 0x20, 0xec,
+    0x8c, 0x10, 0x26, 0x8c, 0x08, 0x13, 0x0c, 0x09, 0x0b, 0x0c, 0x84, 0x01,
+    0x06, 0x08, 0x3b, 0x43, 0x08, 0x0b, 0x23, 0xc2, 0x08, 0x46, 0xf2, 0x02,
+    0x61, 0xc4, 0x84, 0xb0, 0xc1, 0x94, 0xb0, 0xc1, 0x44, 0x98, 0x23, 0x2f,
+    0x18, 0x13, 0x46, 0x30, 0x10, 0x16, 0x0c, 0x10, 0x86, 0x0c, 0x10, 0x66,
+    0x8c, 0x08, 0x0b, 0x86, 0x09, 0x13, 0x0c, 0x84, 0x09, 0x06, 0x84, 0x21,
+    0x03, 0x80, 0x3d, 0x32, 0x83, 0xb0, 0x64, 0x43, 0x18, 0x60, 0x23, 0xec,
+    0x30, 0x48, 0xd8, 0x30, 0x22, 0x4c, 0x18, 0x21, 0x4c, 0x19, 0x20, 0x2c,
+    0x18, 0x08, 0x03, 0x18, 0x12, 0x36, 0x0c, 0x11, 0x16, 0x46, 0x08, 0xa3,
+    0x0c, 0x08, 0x0b, 0x06, 0x84, 0x01, 0x86, 0x84, 0x19, 0x46, 0x84, 0x85,
+    0x21, 0x84, 0x29, 0x03, 0xc2, 0x04, 0x03, 0x79, 0x80, 0x3c, 0x26, 0x0f,
+    0x30, 0xc9, 0x03, 0xd0, 0xb1, 0x08, 0xd8, 0x48, 0xbd, 0x34, 0xe9, 0x2b,
+    0x5e, 0xcf, 0x21, 0x31, 0x97, 0xad, 0x3c, 0x52, 0xcb, 0xe4, 0x85, 0x2a,
+    0x02, 0xad, 0x68, 0x68, 0xa7, 0xf1, 0x17, 0xde, 0xec, 0x5d, 0x80, 0x57,
+    0xf7, 0x92, 0xf2, 0x7a, 0xa5, 0xae, 0x1d, 0x9f, 0x6f, 0x97, 0x2b, 0xa3,
+    0x85, 0x28, 0x9e, 0x7d, 0x97, 0xb8, 0x76, 0x4d, 0x0b, 0xab, 0xda, 0x2d,
+    0xf6, 0x43, 0x79, 0xef, 0xfd, 0x51, 0xe8, 0x6a, 0xfc, 0x52, 0xd4, 0x2d,
+    0x39, 0x5d, 0x45, 0x67, 0xcd, 0xac, 0x38, 0x4a, 0xff, 0xf0, 0xed, 0x16,
+    0xf0, 0x53, 0x34, 0xb9, 0xc8, 0xa4, 0xda, 0x95, 0x1b, 0x48, 0x12, 0xa9,
+    0x46, 0xb3, 0x78, 0x8d, 0xe9, 0x89, 0xcd, 0x06, 0x61, 0xfc, 0x9f, 0xe8,
+    0x03, 0x7d, 0x48, 0x8e, 0xf0, 0x5c, 0xe0, 0x7a, 0xd6, 0x3c, 0x63, 0x3a,
+    0x66, 0xe6, 0xc2, 0x46, 0x6c, 0xfd, 0x20, 0xbd, 0x13, 0x49, 0x08, 0x75,
+    0xa5, 0x2e, 0x0b, 0xd0, 0xd1, 0xb4, 0xf6, 0xa7, 0x9a, 0x23, 0x7b, 0x74,
+    0x30, 0xb1, 0x8c, 0x10, 0x82, 0x22, 0xfe, 0x7c, 0x4b, 0xb5, 0xf6, 0x61,
+    0x98, 0x37, 0xfb, 0xa5, 0x87, 0xf6, 0x7f, 0x2d, 0x6a, 0x6a, 0x0f, 0xfc,
+    0x9d, 0x5b, 0xb5, 0xcf, 0x17, 0x52, 0x2b, 0x9f, 0x03, 0x4e, 0x55, 0x83,
+    0xf0, 0x0a, 0x75, 0xfc, 0x02, 0x8c, 0xdd, 0x23, 0xa5, 0x84, 0xeb, 0x03,
+    0x16, 0xb8, 0xa3, 0xee, 0xf2, 0xd6, 0x9f, 0xcf, 0x29, 0xe7, 0xa7, 0xe1,
+    0x71, 0xf4, 0xf3, 0xa1, 0x46, 0x6b, 0x3e, 0x57, 0x98, 0x9a, 0x9b, 0x24,
+    0xc3, 0x2b, 0x94, 0xf9, 0x35, 0x93, 0xb3, 0xe1, 0xea, 0x88, 0x01, 0x17,
+    0x19, 0x50, 0xa0, 0xf9, 0x48, 0x16, 0xfd, 0x65, 0xda, 0xba, 0x36, 0xd5,
+    0xa0, 0xda, 0x82, 0xd3, 0xb0, 0x47, 0x4b, 0xfb, 0x36, 0xbb, 0xbc, 0x0b,
+    0xba, 0x8d, 0xcb, 0xe1, 0xb5, 0x74, 0xc5, 0x8e, 0x72, 0x0d, 0x93, 0xc5,
+    0x68, 0xa1, 0x4d, 0x2f, 0x38, 0x7d, 0xf8, 0x4d, 0xd1, 0xc8, 0x13, 0xbd,
+    0x69, 0x0a, 0x6c, 0x81, 0xaf, 0x4c, 0x90, 0xc3, 0x92, 0xb2, 0x9c, 0x53,
+    0x9d, 0x1d, 0xc1, 0xf1, 0x02, 0x2b, 0x8c, 0x80, 0x58, 0xae, 0xfd, 0xf2,
+    0x7e, 0xdd, 0xc5, 0xa3, 0xbf, 0xad, 0xc9, 0xc3, 0x63, 0x4f, 0xfc, 0x0a,
+    0x4a, 0xce, 0x81, 0xc9, 0x3a, 0xcd, 0xd1, 0x2d, 0xaa, 0xcf, 0xf5, 0x27,
+    0x5b, 0xa3, 0x5c, 0x4e, 0xd8, 0x31, 0xe0, 0x38, 0x98, 0xb3, 0xaf, 0x0b,
+    0x6d, 0xb2, 0xa7, 0x41, 0x3d, 0x14, 0x10, 0x00, 0x89, 0x72, 0x8b, 0x78,
+    0x7d, 0x79, 0x69, 0xe4, 0xea, 0x1a, 0xe4, 0xd7, 0x5c, 0x5a, 0x93, 0x24,
+    0xd7, 0xfd, 0x79, 0x04, 0x02, 0x12, 0x17, 0xd2, 0xa5, 0x60, 0x0a, 0xce,
+    0x8c, 0xe0, 0xdf, 0x61, 0x96, 0x79, 0x39, 0x6b, 0x71, 0x4b, 0x4f, 0x8f,
+    0xe6, 0x99, 0x05, 0xcd, 0x21, 0xca, 0x0e, 0xa3, 0xfe, 0x63, 0x00, 0x03,
+    0xd6, 0xce, 0xce, 0x43, 0xe9, 0x5b, 0x6f, 0x6f, 0x55, 0x4f, 0x6f, 0xa9,
+    0x2a, 0xd1, 0xf2, 0x62, 0xc2, 0x7e, 0x65, 0xc9, 0x61, 0x53, 0x01, 0x6f,
+    0x14, 0xfc, 0xef, 0xa8, 0x55, 0x2c, 0x2d, 0x42, 0xc4, 0x37, 0x41, 0x51,
+    0xe8, 0x8e, 0x04, 0xa3, 0xd3, 0xd4, 0x34, 0x01, 0xa7, 0x83, 0x21, 0x28,
+    0x75, 0xdc, 0x69, 0x42, 0xc2, 0x4d, 0xc7, 0xff, 0x0c, 0x8e, 0x76, 0x3e,
+    0x0a, 0x18, 0x75, 0x14, 0x4d, 0xc5, 0xa6, 0x5e, 0x18, 0x20, 0xe0, 0x05,
+    0xb7, 0x49, 0x1a, 0x90, 0x47, 0x72, 0x5f, 0xda, 0x11, 0x73, 0xb2, 0xfc,
+    0x64, 0x2e, 0x06, 0x66, 0xf4, 0x4e, 0x58, 0x32, 0x63, 0x3e, 0x16, 0x1a,
+    0x65, 0xbb, 0xe3, 0xc8, 0xa4, 0x7e, 0xa6, 0x77, 0x79, 0x1f, 0x43, 0xd4,
+    0xcf, 0x8c, 0x81, 0x31, 0x70, 0x0d, 0x2e, 0x77, 0xe1, 0x22, 0x4b, 0xe7,
+    0x9d, 0x5d, 0x32, 0xd6, 0x2f, 0x3d, 0xa2, 0x9e, 0x09, 0xcc, 0xf3, 0x28,
+    0xcc, 0xdc, 0xac, 0x49, 0x36, 0x98, 0xb9, 0x06, 0xd3, 0xac, 0xea, 0xa8,
+    0x5b, 0x80, 0x19, 0x02, 0xd3, 0x77, 0xdc, 0x80, 0xb7, 0xce, 0xc4, 0xc9,
+    0x0a, 0x30, 0x64, 0x8c, 0x65, 0x30, 0xa3, 0xed, 0x10, 0xc5, 0x4f, 0x9a,
+    0x23, 0x32, 0x8d, 0xd4, 0xad, 0x82, 0x22, 0x00, 0xae, 0x7d, 0x26, 0x7a,
+    0xcf, 0xad, 0xda, 0x9f, 0xc8, 0xc8, 0x39, 0x50, 0xee, 0x1b, 0x67, 0xd5,
+    0x66, 0xc0, 0x86, 0x05, 0x35, 0x2b, 0x77, 0x4f, 0x95, 0x48, 0xc5, 0xbd,
+    0x56, 0x0d, 0x8e, 0x1e, 0xfa, 0x8f, 0x84, 0x2d, 0xf7, 0xaa, 0xba, 0xba,
+    0x52, 0xf5, 0x1a, 0xac, 0x4e, 0xaa, 0x58, 0xae, 0x03, 0xf1, 0x8f, 0x20,
+    0x75, 0x1a, 0xaa, 0x0b, 0x7e, 0x34, 0x2c, 0x57, 0x31, 0xe8, 0x0d, 0xbc,
+    0x81, 0x39, 0x01, 0xe8, 0x4d, 0xfc, 0xbd, 0x05, 0xc4, 0xe8, 0xbc, 0x2c,
+    0xfb, 0x6f, 0x60, 0x94, 0x33, 0x05, 0x70, 0xee, 0x3d, 0xd1, 0xea, 0xa6,
+    0x02, 0x7b, 0x1c, 0x94, 0x99, 0xcd, 0xe4, 0x09, 0x0d, 0x24, 0x6c, 0xbc,
+    0x74, 0x01, 0x2c, 0x72, 0xe0, 0x60, 0x26, 0xa0, 0x32, 0xa7, 0x4b, 0xbe,
+    0x8a, 0xbe, 0x12, 0x8b, 0x42, 0x63, 0x91, 0x2a, 0x46, 0x53, 0xc1, 0xab,
+    0x90, 0xe5, 0x58, 0x9a, 0xc8, 0xc3, 0x9d, 0x35, 0x7e, 0xb6, 0xbc, 0x80,
+    0x49, 0x53, 0x19, 0x92, 0xb4, 0x3f, 0x83, 0x20, 0x1e, 0x07, 0x39, 0x43,
+    0x18, 0xaf, 0xed, 0x15, 0x3b, 0x44, 0xb1, 0x04, 0x1a, 0x29, 0x2c, 0x2c,
+    0x92, 0xba, 0x23, 0xf5, 0xca, 0xfd, 0x72, 0xd7, 0xba, 0xa9, 0x66, 0x9f,
+    0x1d, 0x36, 0x27, 0x28, 0xa6, 0x37, 0xc6, 0x95, 0xd6, 0x8b, 0x2c, 0x56,
+    0xdb, 0xcc, 0xcf, 0xb8, 0xbf, 0x33, 0x3a, 0x7e, 0x73, 0x12, 0xf1, 0xba,
+    0xad, 0x2d, 0xce, 0x5c, 0x16, 0xb3, 0xd1, 0x4b, 0xaf, 0x6a, 0x0f, 0xae,
+    0xb5, 0x58, 0xac, 0x1c, 0x4f, 0x63, 0x70, 0x86, 0xc1, 0x67, 0x42, 0xc4,
+    0xae, 0xf2, 0x0a, 0x08, 0x65, 0x54, 0x37, 0x05, 0x40, 0xce, 0x09, 0xc8,
+    0x8f, 0xa3, 0x40, 0xa9, 0xe0, 0xbd, 0x51, 0x76, 0x97, 0xb3, 0x18, 0x77,
+    0x9e, 0xc8, 0x08, 0xd5, 0xcd, 0xe5, 0xa9, 0xad, 0x40, 0x46, 0x6f, 0x73,
+    0xcf, 0x29, 0x55, 0x23, 0xda, 0x6a, 0x80, 0xf9, 0x5f, 0xb4, 0x06, 0x6a,
+    0xac, 0x58, 0x34, 0x3e, 0x41, 0x19, 0x45, 0xea, 0x39, 0xc6, 0xfa, 0x93,
+    0xc1, 0x34, 0x93, 0x38, 0x9c, 0x84, 0x27, 0x1d, 0x39, 0x3f, 0xe7, 0x85,
+    0xb5, 0x87, 0x38, 0xa1, 0x14, 0x4e, 0x03, 0x9a, 0xf1, 0x5c, 0x5c, 0x91,
+    0x55, 0x80, 0x53, 0x3c, 0x7b, 0xd9, 0x68, 0x6a, 0xe5, 0xc7, 0x4e, 0x63,
+    0x37, 0x83, 0x68, 0xad, 0xb0, 0xd2, 0x0d, 0x91, 0x5d, 0x9f, 0x8a, 0x0e,
+    0xaa, 0x95, 0xae, 0xfa, 0xb0, 0xc7, 0xee, 0xc4, 0x9b, 0xd7, 0x10, 0x99,
+    0x3c, 0xef, 0x4b, 0x03, 0x7a, 0x2b, 0xbc, 0x0d, 0x00, 0xc3, 0x0f, 0x27,
+    0x01, 0xd3, 0x82, 0xc6, 0x36, 0xa7, 0xeb, 0x8c, 0x00, 0xa5, 0x03, 0x0c,
+    0xf0, 0x90, 0x99, 0xc4, 0x22, 0x07, 0x75, 0x13, 0x29, 0xbe, 0xba, 0x85,
+    0x8e, 0x2b, 0x0e, 0x7e, 0x71, 0xef, 0x09, 0xfa, 0x21, 0x80, 0xea, 0xc4,
+    0x1c, 0x1c, 0xd8, 0x72, 0x4a, 0x10, 0xa0, 0x4d, 0x94, 0x86, 0x97, 0x35,
+    0xbc, 0x49, 0xa4, 0xf2, 0x45, 0xa6, 0x47, 0x16, 0xa7, 0x60, 0x0f, 0xcf,
+    0x24, 0xa5, 0x2f, 0x9a, 0x7b, 0x00, 0x92, 0x73, 0x47, 0x51, 0x48, 0x08,
+    0xa4, 0x1a, 0xb3, 0x2c, 0x28, 0xa9, 0x0c, 0x4e, 0xd0, 0x95, 0x7e, 0x25,
+    0x23, 0x48, 0x79, 0x86, 0x96, 0x43, 0xc8, 0x21, 0x50, 0xac, 0xd6, 0x76,
+    0xb9, 0xe1, 0x40, 0x66, 0x24, 0xe8, 0x37, 0x38, 0x50, 0x2a, 0x96, 0x7c,
+    0x9a, 0x6d, 0xe3, 0x0c, 0x76, 0xc9, 0x3b, 0x59, 0x74, 0xe0, 0x55, 0x80,
+    0x80, 0x7a, 0x50, 0xf4, 0x19, 0x16, 0xe8, 0x60, 0x38, 0x99, 0x0e, 0x52,
+    0xce, 0x41, 0xac, 0x5f, 0xdf, 0x81, 0x13, 0xb0, 0x0f, 0x09, 0x9a, 0x67,
+    0x47, 0x47, 0x12, 0x4c, 0x20, 0xea, 0xad, 0x1a, 0xe9, 0xf0, 0xa1, 0x08,
+    0x81, 0x04, 0x98, 0x31, 0xfc, 0x00, 0x12, 0x50, 0x10, 0x40, 0x10, 0x40,
+    0x10, 0xf8, 0x04, 0x81, 0x82, 0xe0, 0x7f, 0x84, 0xc0, 0x5e, 0xe0, 0x0f,
+    0x24, 0x8f, 0x70, 0x4e, 0x38, 0x27, 0x9c, 0x11, 0x46, 0x1e, 0x43, 0x38,
+    0x23, 0x8c, 0x11, 0xce, 0x08, 0xe3, 0x08, 0xe3, 0x84, 0x73, 0xc2, 0x18,
+    0xc2, 0x18, 0xe1, 0x8c, 0x30, 0x46, 0x38, 0x27, 0x8c, 0x13, 0xce, 0x09,
+    0x83, 0x11, 0xce, 0x09, 0x67, 0x84, 0x31, 0xc2, 0x39, 0x61, 0x9c, 0x70,
+    0x4e, 0x18, 0x46, 0x38, 0x27, 0x9c, 0x21, 0x8c, 0x11, 0xce, 0x09, 0xe3,
+    0x84, 0x73, 0xc2, 0x30, 0xc2, 0x39, 0xe1, 0x8c, 0x30, 0x46, 0x38, 0x27,
+    0x0c, 0x27, 0x9c, 0x13, 0x86, 0x11, 0xce, 0x09, 0x67, 0x84, 0x31, 0xc2,
+    0x39, 0x61, 0x9c, 0x70, 0x4e, 0x18, 0x86, 0x70, 0x4e, 0xfa, 0x56, 0x40,
+    0x4e, 0x18, 0x43, 0x38, 0x23, 0x8c, 0x11, 0xce, 0x08, 0xe3, 0x84, 0xf1,
+    0xf3, 0xf7, 0xba, 0x30, 0xc2, 0x18, 0xe1, 0x2c, 0x79, 0x84, 0x71, 0xc2,
+    0x38, 0xe1, 0x9c, 0x30, 0xf2, 0x73, 0xc2, 0x39, 0xe1, 0x8c, 0x30, 0x46,
+    0x38, 0x27, 0x2c, 0x27, 0x9c, 0x13, 0x86, 0x11, 0xce, 0x09, 0x67, 0x84,
+    0x31, 0xc2, 0x39, 0x79, 0x84, 0x33, 0xc2, 0x18, 0x61, 0x31, 0xc2, 0xc9,
+    0x63, 0x84, 0x33, 0xc2, 0x38, 0x61, 0x9c, 0xcb, 0xbd, 0x82, 0x18, 0xe1,
+    0x8c, 0x70, 0x46, 0x18, 0x27, 0x9c, 0x13, 0xce, 0x08, 0x63, 0x84, 0x65,
+    0x84, 0x33, 0xc2, 0x19, 0xc2, 0x38, 0xe1, 0x9c, 0x70, 0x46, 0x18, 0x23,
+    0x2c, 0x23, 0x9c, 0x11, 0xce, 0xd2, 0x5e, 0xd5, 0xc2, 0x09, 0xe3, 0x84,
+    0xf1, 0x84, 0x33, 0xc2, 0x72, 0xc2, 0x39, 0xe1, 0x8c, 0x30, 0x46, 0x38,
+    0x27, 0x8c, 0x13, 0xce, 0x09, 0xc3, 0x08, 0xcf, 0x09, 0x67, 0x84, 0x31,
+    0xc2, 0x39, 0x61, 0x9c, 0x70, 0x4e, 0x18, 0x46, 0x38, 0x27, 0x9f, 0x70,
+    0x46, 0x18, 0x4e, 0x38, 0x27, 0x9c, 0x3c, 0x46, 0x38, 0x43, 0x38, 0x23,
+    0x8c, 0x31, 0xcc, 0x32, 0x6d, 0x04, 0x00, 0xb3, 0x84, 0x0b, 0xe7, 0x07,
+    0xdb, 0xc0, 0x84, 0xa3, 0x6b, 0x1f, 0x77, 0xd6, 0x24, 0xc2, 0x24, 0x55,
+    0x8c, 0xbb, 0xf9, 0x5c, 0xf6, 0x5b, 0x19, 0x39, 0x24, 0x72, 0x46, 0x29,
+    0x5b, 0x9e, 0x38, 0x25, 0x0c, 0x6e, 0x60, 0x14, 0xc0, 0x5b, 0xf4, 0x01,
+    0x0c, 0x00, 0x6d, 0xe1, 0x20, 0x1e, 0xae, 0x08, 0x4d, 0x98, 0x20, 0x7e,
+    0x00, 0x12, 0x60, 0x10, 0xf8, 0xff, 0xff, 0x1b, 0x04, 0xfe, 0x02, 0x7f,
+    0x24, 0x33, 0xc2, 0x39, 0xe1, 0x8c, 0x30, 0x4e, 0x38, 0x23, 0x9c, 0x13,
+    0xc6, 0x08, 0x63, 0x09, 0xe3, 0x84, 0x31, 0xc2, 0x71, 0xc2, 0x39, 0xe1,
+    0x8c, 0x70, 0x46, 0x18, 0x27, 0x8c, 0x25, 0x9c, 0x13, 0xc6, 0x4e, 0x60,
+    0x0a, 0xe4, 0x84, 0x73, 0xc2, 0x18, 0xe1, 0x38, 0xe1, 0x9c, 0x70, 0x46,
+    0x38, 0x23, 0x8c, 0x23, 0x8c, 0x11, 0xce, 0x09, 0x63, 0x84, 0x31, 0xc2,
+    0x38, 0x61, 0x0c, 0xe1, 0x8c, 0x70, 0x9e, 0x70, 0x46, 0x18, 0x27, 0x9c,
+    0x11, 0xae, 0x31, 0xbd, 0xe5, 0x54, 0xff, 0xad,
+  };
+
+/* zstd -19 of fill_repeats (300000 bytes).  */
+static const grub_uint8_t repeats_l19[] =
+  {
+    0x28, 0xb5, 0x2f, 0xfd, 0xa4, 0xe0, 0x93, 0x04, 0x00, 0xa4, 0x14, 0x00,
+    0x12, 0xc6, 0x11, 0x11, 0xb0, 0xeb, 0x60, 0x94, 0x61, 0xab, 0xaa, 0x69,
+    0xa3, 0x6a, 0xa3, 0x61, 0x42, 0x1c, 0x83, 0xc8, 0x23, 0x99, 0xcf, 0xcc,
+    0xcc, 0x7c, 0xfe, 0x39, 0xde, 0x4d, 0x7c, 0xf3, 0x3e, 0xde, 0x05, 0x1a,
+    0xee, 0x21, 0x17, 0x67, 0x4d, 0x56, 0x3d, 0xcd, 0x5e, 0x57, 0xde, 0x88,
+    0x91, 0xb2, 0x43, 0xb6, 0xb0, 0xe5, 0x18, 0x69, 0x37, 0x13, 0xfa, 0xa2,
+    0x69, 0x72, 0xa8, 0xa8, 0x5a, 0xfe, 0xa6, 0x6b, 0x33, 0x36, 0x14, 0x3e,
+    0x46, 0x2a, 0x81, 0x43, 0xa8, 0x81, 0x33, 0x48, 0x8d, 0x42, 0x7b, 0x06,
+    0x21, 0x08, 0x01, 0x45, 0x91, 0x24, 0xa7, 0xf4, 0x06, 0x21, 0x08, 0x8c,
+    0x70, 0x48, 0xe0, 0x24, 0x12, 0xd4, 0x82, 0x24, 0x1d, 0xb0, 0x91, 0x6d,
+    0xec, 0xf9, 0xa9, 0xdb, 0xd4, 0x69, 0xe9, 0x19, 0x72, 0x7b, 0x0f, 0x92,
+    0x41, 0x1a, 0xa4, 0x7d, 0x3c, 0x98, 0x82, 0xff, 0x2c, 0x15, 0xed, 0x6c,
+    0x98, 0xa4, 0xb3, 0x34, 0x77, 0x8e, 0xcd, 0x4e, 0x4d, 0x70, 0x17, 0x28,
+    0x40, 0xb8, 0x1c, 0x7e, 0x6e, 0x04, 0x6c, 0x74, 0x8f, 0x7c, 0x6f, 0x51,
+    0x55, 0xf9, 0xc5, 0xb2, 0x21, 0x1b, 0x88, 0xce, 0xa7, 0x25, 0xdd, 0x73,
+    0x68, 0x9a, 0x8e, 0xdc, 0x56, 0xec, 0xc6, 0x84, 0xbb, 0x9c, 0x61, 0x3c,
+    0xc8, 0x0d, 0x34, 0x4b, 0xf9, 0xd6, 0xd3, 0x64, 0xae, 0x68, 0x01, 0x8d,
+    0x4d, 0xb3, 0xdc, 0x95, 0x78, 0x64, 0x01, 0x54, 0xe1, 0x71, 0x30, 0xb1,
+    0x98, 0xfe, 0x8f, 0xe0, 0x59, 0x16, 0x71, 0xdf, 0x03, 0xa2, 0x60, 0x90,
+    0xc2, 0xe7, 0x53, 0x18, 0x02, 0x4c, 0x03, 0x77, 0x86, 0xc0, 0x9c, 0x94,
+    0xe3, 0xc1, 0x99, 0xcc, 0x19, 0x5b, 0x36, 0xab, 0xe4, 0x83, 0xa9, 0xf0,
+    0xbe, 0x8b, 0x27, 0x86, 0x55, 0xf4, 0x4b, 0xed, 0xfd, 0xd8, 0xde, 0xce,
+    0x8c, 0x4e, 0xe2, 0xe4, 0x41, 0x76, 0xa5, 0x85, 0x04, 0x4f, 0x16, 0xb0,
+    0xd1, 0x7f, 0x07, 0x07, 0x75, 0x8c, 0x38, 0xa0, 0x53, 0xf1, 0x42, 0xfd,
+    0x22, 0x80, 0xf2, 0xfe, 0x96, 0x69, 0xe0, 0x44, 0x26, 0x28, 0x8b, 0x9d,
+    0x8f, 0x97, 0x79, 0x01, 0x46, 0x5e, 0xc3, 0x62, 0x58, 0x15, 0x0f, 0x82,
+    0x0d, 0xc6, 0xb5, 0xab, 0xe5, 0x46, 0x5c, 0x66, 0x3f, 0xc7, 0x88, 0x84,
+    0x00, 0x2e, 0x83, 0x4e, 0xb0, 0x70, 0x77, 0x6d, 0x4d, 0xbe, 0xf4, 0xa9,
+    0x83, 0xf0, 0x50, 0xf3, 0x11, 0x0b, 0x83, 0x98, 0x2f, 0x81, 0x62, 0x49,
+    0x23, 0x21, 0x63, 0x08, 0x25, 0xe8, 0x1e, 0x68, 0x4e, 0xc6, 0x8e, 0x1a,
+    0x3e, 0xb0, 0x79, 0x57, 0x58, 0xa3, 0x0e, 0x3f, 0x31, 0x5b, 0x47, 0xb8,
+    0xec, 0x24, 0x36, 0xe8, 0x8f, 0xde, 0x06, 0x88, 0x38, 0x44, 0x7e, 0x8f,
+    0x13, 0xa5, 0x26, 0x26, 0x19, 0x9c, 0xec, 0x5f, 0x31, 0x14, 0xcf, 0x69,
+    0xe1, 0x6b, 0x1d, 0x0c, 0x3d, 0xbc, 0x23, 0x5f, 0xd9, 0x56, 0x6d, 0xc2,
+    0xc9, 0x4b, 0x6b, 0x1a, 0x64, 0x77, 0x29, 0xeb, 0x89, 0x68, 0xd8, 0x16,
+    0xb5, 0x13, 0xc9, 0x15, 0x98, 0x71, 0xd2, 0x5e, 0x8a, 0xf8, 0x03, 0x32,
+    0xe1, 0xf0, 0xc9, 0xde, 0x80, 0xcd, 0x91, 0xbc, 0x83, 0xf7, 0x0d, 0xd1,
+    0x3d, 0x14, 0xc4, 0xe8, 0x00, 0xe3, 0x22, 0x28, 0xe0, 0x13, 0xea, 0x03,
+    0xf8, 0x4d, 0x05, 0x82, 0x08, 0x7e, 0xa2, 0x3d, 0xbc, 0x63, 0x8f, 0xcb,
+    0x81, 0x98, 0x72, 0x05, 0x32, 0x90, 0x93, 0x58, 0xb1, 0x70, 0x9c, 0x3a,
+    0xc6, 0x71, 0xee, 0x85, 0x61, 0x42, 0x0d, 0x44, 0x15, 0x4f, 0x47, 0x2e,
+    0x82, 0xa7, 0x4d, 0xfa, 0x21, 0x0e, 0xa5, 0xac, 0x5c, 0xb1, 0xa8, 0xd9,
+    0xb1, 0x41, 0xfb, 0x25, 0x46, 0xfb, 0xaa, 0xaa, 0x67, 0x68, 0x36, 0x32,
+    0xae, 0x65, 0xed, 0x02, 0x13, 0x75, 0xd7, 0x86, 0x67, 0x36, 0xcc, 0x34,
+    0xfc, 0x60, 0x1a, 0xe7, 0x5c, 0xb9, 0xf4, 0x87, 0x50, 0xb8, 0x56, 0x00,
+    0x58, 0x77, 0x02, 0x7e, 0x8a, 0xc7, 0x75, 0xcb, 0x2d, 0xe5, 0x01, 0xa1,
+    0xa1, 0x12, 0x70, 0x57, 0x20, 0x70, 0x17, 0xda, 0x4b, 0x1e, 0x3b, 0x08,
+    0x54, 0x8c, 0x2a, 0x54, 0x8a, 0xfa, 0x2a, 0xce, 0xad, 0xc9, 0x4f, 0x81,
+    0x13, 0x13, 0x54, 0x27, 0xe4, 0xbd, 0xbd, 0x2f, 0x04, 0x5f, 0x34, 0x5e,
+    0xa6, 0x6e, 0x05, 0x1c, 0x44, 0x10, 0x03, 0xcb, 0x04, 0x1b, 0x40, 0xa8,
+    0x5c, 0x8a, 0x2c, 0xea, 0x55, 0xd0, 0x0c, 0x85, 0x98, 0x86, 0xba, 0x49,
+    0x48, 0x4a, 0x69, 0x7e, 0x85, 0x2b, 0x5e, 0x91, 0x84, 0x56, 0xa9, 0x8c,
+    0xec, 0xd7, 0x05, 0x0e, 0xfd, 0x54, 0xc4, 0xbb, 0xa6, 0x25, 0x98, 0x32,
+    0xa4, 0xb6, 0x01, 0xa8, 0x60, 0x8a, 0x18, 0x8f, 0x01, 0xac, 0x2f, 0x90,
+    0xa3, 0xa5, 0x20, 0xf3, 0xa2, 0xe8, 0x58, 0xf3, 0x33, 0xec, 0x3f, 0x9b,
+    0x2e, 0x95, 0x93, 0x3e, 0x3b, 0x1e, 0x9d, 0x88, 0xa8, 0xb0, 0x06, 0x6a,
+    0xfc, 0x0c, 0x00, 0xe4, 0x02, 0x0a, 0x72, 0x0a, 0x74, 0x74, 0x68, 0x6f,
+    0x79, 0x65, 0x6c, 0x79, 0x74, 0x63, 0x70, 0x6e, 0x68, 0x61, 0x7a, 0x6f,
+    0x68, 0x75, 0x70, 0x72, 0x64, 0x6c, 0x79, 0x7a, 0x70, 0x76, 0x69, 0x76,
+    0x6b, 0x78, 0x7a, 0x6e, 0x69, 0x70, 0x78, 0x71, 0x6e, 0x72, 0x69, 0x6f,
+    0x6e, 0x6a, 0x79, 0x80, 0xa1, 0xa8, 0x80, 0x1f, 0x60, 0x4c, 0x20, 0x22,
+    0x32, 0x53, 0x45, 0x8d, 0x01, 0x12, 0x08, 0x11, 0xb0, 0x08, 0x42, 0x9e,
+    0x24, 0x20, 0x09, 0x40, 0x04, 0x22, 0x60, 0x08, 0x1e, 0x21, 0xfc, 0x3b,
+    0x04, 0x0e, 0xe8, 0x07, 0x65, 0xe2, 0x67, 0x65, 0xb9, 0xe7, 0x07, 0x52,
+    0x76, 0xf3, 0x13, 0x95, 0xaf, 0xfc, 0x48, 0x2b, 0x33, 0x7e, 0x56, 0xca,
+    0x3d, 0x3f, 0x10, 0x79, 0xf7, 0x32, 0xc7, 0xcf, 0x44, 0xb9, 0xf0, 0x03,
+    0x5a, 0xb6, 0xf3, 0x03, 0x16, 0x1e, 0x00, 0x64, 0x25, 0x81, 0x1c, 0x66,
+    0xb1, 0x3a, 0x07, 0x54, 0xcc, 0x97, 0x43, 0x15, 0xbb, 0xc5, 0x41, 0x8a,
+    0xc1, 0x39, 0xec, 0x62, 0x51, 0x0e, 0x50, 0x31, 0x2b, 0x0e, 0x59, 0xec,
+    0x9d, 0x83, 0x2a, 0x06, 0xe5, 0x30, 0x14, 0xcb, 0x71, 0x80, 0xc5, 0x9c,
+    0x39, 0xb4, 0xd8, 0x4d, 0x0e, 0xa2, 0x18, 0x8c, 0xc3, 0x2e, 0x16, 0xe7,
+    0x00, 0x8b, 0x59, 0x72, 0x48, 0xc5, 0xde, 0x38, 0xa8, 0x62, 0x70, 0x0e,
+    0xa3, 0x58, 0x96, 0x03, 0x54, 0xcc, 0x89, 0x83, 0x90, 0xbf, 0x90, 0x2f,
+    0x40, 0x7e, 0x00, 0x0a, 0xc2, 0x81, 0x37, 0x45, 0xde, 0x47, 0x1e, 0x20,
+    0x7f, 0x29, 0x3c, 0x00, 0xc4, 0xc1, 0x91, 0x3c, 0x8f, 0xbc, 0x89, 0x3c,
+    0x00, 0xf2, 0x03, 0x30, 0x96, 0xe7, 0xc8, 0x01, 0xea, 0xbb, 0x5b, 0x35,
+    0x33, 0x5e, 0x69, 0x49, 0x15, 0xad, 0xd4, 0x55, 0x80, 0x94, 0xcb, 0x7f,
+    0x05, 0x65, 0x3c, 0x56, 0x52, 0xec, 0xd4, 0xcb, 0x42, 0xfa, 0xf2, 0x3b,
+    0x18, 0xd5, 0x63, 0xdf, 0x6d, 0x1a, 0x6c, 0x89, 0xa6, 0xeb, 0xcc, 0xac,
+    0x49, 0xb4, 0xba, 0x1f, 0x43, 0x07, 0x4a, 0x59, 0x1e, 0x31, 0xaf, 0x9c,
+    0xfc, 0xa9, 0x16, 0x89, 0x83, 0x54, 0x84, 0x4b, 0xb4, 0x8b, 0x92, 0xf5,
+    0x3c, 0xea, 0x83, 0x55, 0x29, 0xca, 0xf5, 0x51, 0xf9, 0xcc, 0xd2, 0x95,
+    0x33, 0x75, 0x1a, 0xd1, 0x82, 0x20, 0xaa, 0xc8, 0xd2, 0x50, 0x70, 0x87,
+    0xb5, 0x25, 0xee, 0x87, 0xb2, 0xaa, 0x21, 0xbf, 0xd7, 0x32, 0xbc, 0x61,
+    0x2d, 0x22, 0xaa, 0x67, 0x0f, 0x99, 0xb1, 0xff, 0xaf, 0xbc, 0x4f, 0xd0,
+    0xbc, 0xad, 0x85, 0xae, 0xfd, 0x6e, 0x61, 0x93, 0x0f, 0x42, 0x0f, 0x9d,
+    0x11, 0xca, 0xb2, 0xd5, 0x44, 0xed, 0x84, 0x79, 0xff, 0xba, 0x46, 0x61,
+    0xb3, 0x5f, 0x0c, 0xb2, 0xe0, 0xb4, 0x04, 0xd2, 0x73, 0xb7, 0xf4, 0x70,
+    0xf9, 0x39, 0x47, 0x88, 0x4d, 0x24, 0xf0, 0xab, 0x80, 0x51, 0x6c, 0x32,
+    0x6c, 0x3d, 0x1f, 0xae, 0x09, 0x37, 0x18, 0x62, 0xc4, 0x8c, 0x3d, 0xe8,
+    0x1b, 0x8f, 0x05, 0xe2, 0x9f, 0x55, 0x16, 0x4a, 0x7d, 0x01, 0x14, 0x0a,
+    0x00, 0x02, 0x45, 0x10, 0x11, 0xa0, 0x3d, 0x44, 0x8e, 0x5f, 0xd3, 0x63,
+    0x17, 0x4b, 0x45, 0x3f, 0xff, 0xff, 0xff, 0xff, 0xac, 0x01, 0x2a, 0xb4,
+    0xa2, 0x48, 0x67, 0x72, 0x25, 0x1b, 0x9a, 0xef, 0x39, 0x56, 0xe7, 0x39,
+    0xbc, 0xb7, 0x58, 0x09, 0x72, 0x03, 0x27, 0x8d, 0xe9, 0xf2, 0xbe, 0xf8,
+    0xc4, 0x9a, 0x45, 0x52, 0x4f, 0x1a, 0xa4, 0x00, 0x74, 0xa0, 0x01, 0x5b,
+    0x46, 0xdc, 0x5d, 0x6f, 0x52, 0xe8, 0xf3, 0xef, 0x1d, 0x80, 0xa2, 0xa8,
+    0x20, 0x3f, 0x30, 0x1f, 0x12, 0xf8, 0xff, 0xff, 0x7f, 0x76, 0x84, 0x7f,
+    0xcc, 0x5d, 0x2e, 0x7e, 0x50, 0x36, 0x3f, 0x28, 0x93, 0x9f, 0x94, 0xc9,
+    0xcf, 0xca, 0xe6, 0x27, 0x65, 0xf3, 0xb3, 0xb2, 0xf9, 0x49, 0x99, 0xfc,
+    0xa4, 0x4c, 0x7e, 0xa6, 0x2c, 0x3f, 0x57, 0x26, 0x3f, 0x29, 0x9b, 0x9f,
+    0x94, 0xcd, 0xcf, 0xca, 0xe6, 0x67, 0x65, 0xf2, 0xb3, 0xb2, 0xf9, 0x49,
+    0xd9, 0xfc, 0x8c, 0x7c, 0x65, 0xe4, 0x07, 0xe4, 0x29, 0x13, 0x3f, 0x97,
+    0xd7, 0xc9, 0xa6, 0x48, 0xfc, 0xb0, 0xbc, 0x4e, 0x47, 0x51, 0xf0, 0x83,
+    0x65, 0xf8, 0x99, 0x32, 0xf9, 0x19, 0x79, 0xca, 0xe6, 0x07, 0xf2, 0x50,
+    0x1e, 0x3f, 0x2d, 0xa7, 0x53, 0xae, 0x28, 0xfc, 0xbc, 0x0c, 0x7e, 0x27,
+    0x8f, 0x65, 0xf3, 0xb3, 0x32, 0xf9, 0xb9, 0xb2, 0xfc, 0x4c, 0x99, 0xfc,
+    0xac, 0x4c, 0x7e, 0x56, 0x26, 0x3f, 0x2b, 0x93, 0x9f, 0x95, 0xcd, 0x4f,
+    0xca, 0xe6, 0x67, 0x65, 0xf3, 0xb3, 0x32, 0xf9, 0x59, 0x99, 0xfc, 0xa4,
+    0x6c, 0x7e, 0xaa, 0x4c, 0x7e, 0x52, 0x36, 0x3f, 0x29, 0x9b, 0x9f, 0x95,
+    0xcd, 0xcf, 0xca, 0xe4, 0x67, 0x65, 0xf3, 0x93, 0xb2, 0xf9, 0x59, 0xd9,
+    0xfc, 0xa4, 0x4c, 0x7e, 0x42, 0x9e, 0x32, 0xf1, 0xc3, 0xb2, 0xf8, 0xc1,
+    0x32, 0xfc, 0x74, 0x99, 0x4e, 0x0e, 0x88, 0x70, 0x99, 0xfc, 0xa8, 0x5c,
+    0x7e, 0x50, 0x2e, 0x3f, 0x2a, 0xb7, 0x53, 0xb3, 0xe8, 0xf8, 0x61, 0x59,
+    0xfc, 0xac, 0x6c, 0x7e, 0x52, 0x36, 0x3f, 0x2b, 0x9b, 0x9f, 0x95, 0xc9,
+    0xcf, 0xca, 0xe4, 0x27, 0x65, 0xf3, 0x53, 0x65, 0xf2, 0x93, 0xb2, 0xf9,
+    0x49, 0xd9, 0xfc, 0xac, 0x6c, 0x7e, 0x56, 0x26, 0x3f, 0x2b, 0x9b, 0x9f,
+    0x94, 0xcd, 0xcf, 0xca, 0xe6, 0x27, 0x65, 0xf2, 0xa3, 0x4d, 0x24, 0x44,
+    0x0f, 0x00, 0x12, 0x88, 0x17, 0x10, 0xa0, 0x6f, 0x60, 0x83, 0x75, 0xcc,
+    0x8d, 0x3c, 0xb2, 0xbf, 0xe6, 0xff, 0x7f, 0xd4, 0xdf, 0x61, 0x80, 0xb0,
+    0x0b, 0x8e, 0xb3, 0x49, 0x52, 0x06, 0xaa, 0x62, 0xb5, 0x68, 0x91, 0x26,
+    0x91, 0xe0, 0x3f, 0xd1, 0x9e, 0x92, 0x6d, 0xbe, 0x7a, 0x2e, 0x2f, 0xb4,
+    0x49, 0x55, 0xe6, 0xf4, 0xbd, 0xda, 0x61, 0xde, 0xd0, 0xd6, 0xe4, 0xb0,
+    0x2b, 0x19, 0x22, 0x54, 0x3e, 0xe6, 0x76, 0x75, 0x16, 0xb7, 0xf4, 0xfc,
+    0x27, 0x7b, 0x7f, 0xac, 0xc9, 0x6e, 0x98, 0x44, 0x5a, 0x68, 0xe9, 0xd8,
+    0xa5, 0x51, 0xd5, 0x20, 0x08, 0x89, 0xbf, 0x67, 0xd6, 0x14, 0x21, 0xb1,
+    0x26, 0x2d, 0x01, 0x81, 0x00, 0xb8, 0x10, 0xfd, 0x12, 0xf8, 0x7f, 0x05,
+    0x81, 0xff, 0x04, 0x81, 0xe5, 0x0d, 0x7f, 0x4f, 0x9e, 0x65, 0xf2, 0xa3,
+    0xf2, 0xf9, 0xb9, 0x72, 0xf9, 0x59, 0xf9, 0x9d, 0x2e, 0x8b, 0xca, 0x0f,
+    0xcb, 0xe6, 0x67, 0x65, 0xe2, 0xa7, 0x65, 0xf2, 0xb3, 0x32, 0xf8, 0x79,
+    0x99, 0xfc, 0xa4, 0x2c, 0x7e, 0xa2, 0x4c, 0x7e, 0x56, 0x36, 0x3f, 0x2b,
+    0x93, 0x9f, 0x95, 0xc9, 0x4f, 0xcb, 0xe6, 0x67, 0x65, 0xe3, 0xe7, 0x65,
+    0xf3, 0x93, 0xb2, 0xf8, 0x79, 0xd9, 0xfc, 0xa4, 0x2c, 0x7e, 0xaa, 0x4c,
+    0x7e, 0x56, 0x36, 0x3f, 0x29, 0x93, 0x9f, 0x94, 0xcd, 0xcf, 0xcb, 0xe4,
+    0x27, 0x65, 0xe3, 0xa7, 0x65, 0xf2, 0x93, 0x32, 0xf8, 0x79, 0xd9, 0xfc,
+    0x46, 0x9e, 0xcb, 0xe4, 0xe7, 0xca, 0xe4, 0x67, 0x65, 0xf3, 0x93, 0x32,
+    0xf9, 0x69, 0xd9, 0xfc, 0xac, 0x4c, 0xfc, 0xb4, 0x6c, 0x7e, 0x52, 0x06,
+    0x3f, 0x2d, 0x93, 0x9f, 0x95, 0xc5, 0xcf, 0x95, 0xc9, 0xcf, 0xca, 0xe6,
+    0x67, 0x65, 0xf2, 0xb3, 0x32, 0xf9, 0x69, 0xd9, 0xfc, 0xac, 0x3c, 0x7e,
+    0x4c, 0x9e, 0xcb, 0xe6, 0x07, 0x65, 0xf0, 0x93, 0x32, 0xf9, 0x59, 0xd9,
+    0xfc, 0x5c, 0x99, 0xfc, 0xac, 0x6c, 0x7e, 0x5e, 0x26, 0x3f, 0x2b, 0x13,
+    0x3f, 0x2d, 0x9b, 0x9f, 0x95, 0xc5, 0xcf, 0xc9, 0x57, 0x66, 0x7e, 0x50,
+    0x26, 0x3f, 0x28, 0x93, 0x9f, 0x95, 0xef, 0xe4, 0x5d, 0x64, 0x7e, 0x58,
+    0x3e, 0x3f, 0x2b, 0x17, 0x3f, 0x2f, 0x9f, 0x9f, 0x2b, 0x87, 0x9f, 0x97,
+    0xcf, 0xcf, 0xca, 0xe1, 0x67, 0xe5, 0xf2, 0x93, 0xf2, 0xf9, 0x59, 0xf9,
+    0xfc, 0xac, 0x7c, 0x7e, 0x5a, 0x3e, 0x3f, 0x4b, 0xbe, 0xe5, 0xf2, 0x83,
+    0xf2, 0xf8, 0xe1, 0x72, 0xf9, 0x51, 0x79, 0x9d, 0x3a, 0x8b, 0xc2, 0x0f,
+    0xcb, 0xe6, 0x67, 0x65, 0xf0, 0x93, 0x32, 0xf9, 0x59, 0x99, 0xfc, 0xac,
+    0x4c, 0x7e, 0x52, 0x36, 0x3f, 0x59, 0x26, 0x3f, 0x2b, 0x1b, 0x3f, 0x2f,
+    0x93, 0x9f, 0x95, 0xc1, 0x4f, 0xcb, 0xe6, 0x67, 0xe5, 0xf8, 0x11, 0x79,
+    0x2e, 0x9b, 0x1f, 0x94, 0xc9, 0x4f, 0xca, 0xe4, 0xe7, 0x65, 0xf3, 0x73,
+    0x65, 0xe2, 0xe7, 0x65, 0xf3, 0xb3, 0x32, 0xf8, 0x79, 0x99, 0xfc, 0xa4,
+    0x2c, 0x7e, 0x56, 0x36, 0x3f, 0x2b, 0x9b, 0x9f, 0x94, 0xcd, 0xcf, 0xca,
+    0xe6, 0xa7, 0x65, 0xf3, 0x53, 0x65, 0xe2, 0xe7, 0x65, 0xf3, 0x93, 0x32,
+    0xf8, 0x69, 0xd9, 0xfc, 0xac, 0x0c, 0x7e, 0x52, 0x36, 0x3f, 0x29, 0x93,
+    0x9f, 0x94, 0xc9, 0xcf, 0xca, 0xe6, 0xe7, 0xcb, 0xe4, 0x67, 0x65, 0xe3,
+    0xe7, 0x65, 0xf9, 0x11, 0x79, 0x28, 0xc7, 0x8f, 0xc8, 0xbb, 0x9c, 0xfc,
+    0xa0, 0x6c, 0x7e, 0x54, 0xbe, 0x13, 0x7e, 0x11, 0xf9, 0x61, 0xf9, 0xfc,
+    0xac, 0x5c, 0xfc, 0xb4, 0x5c, 0x7e, 0xee, 0x00, 0xae, 0x08, 0xcd, 0x04,
+    0x00, 0x64, 0x02, 0x67, 0x6b, 0x61, 0x69, 0x77, 0x74, 0x63, 0x6f, 0x6b,
+    0x67, 0x76, 0x70, 0x6a, 0x63, 0x63, 0x77, 0x79, 0x67, 0x77, 0x70, 0x74,
+    0x63, 0x74, 0x6e, 0x62, 0x70, 0x6d, 0x6a, 0x64, 0x68, 0x78, 0x69, 0x62,
+    0x6a, 0x67, 0x6f, 0x73, 0x6f, 0x4b, 0xfc, 0x04, 0xf2, 0xe3, 0xb2, 0xf9,
+    0x59, 0x19, 0xfc, 0xac, 0x4c, 0x7e, 0x52, 0x36, 0x3f, 0x2b, 0x9b, 0x9f,
+    0x95, 0xcd, 0x4f, 0xcb, 0xe6, 0x67, 0x65, 0xe3, 0xa7, 0xe5, 0xf9, 0x01,
+    0x79, 0x50, 0x16, 0x3f, 0x2a, 0x9b, 0x9f, 0x95, 0xc9, 0xcf, 0xca, 0xe4,
+    0x27, 0x65, 0xf3, 0xf3, 0xb2, 0xf9, 0x59, 0xd9, 0xf8, 0x69, 0xd9, 0xfc,
+    0xac, 0x2c, 0x7e, 0x5a, 0x36, 0x3f, 0x55, 0x06, 0x3f, 0x2b, 0x9b, 0x9f,
+    0x94, 0xc9, 0x4f, 0xca, 0xe6, 0x67, 0x65, 0xf2, 0xd3, 0xb2, 0xf9, 0x49,
+    0x99, 0xf8, 0x69, 0x99, 0xfc, 0xac, 0x2c, 0x7e, 0xbe, 0x4c, 0x7e, 0x56,
+    0x16, 0x3f, 0x2b, 0x93, 0x9f, 0x95, 0xc9, 0x4f, 0xca, 0xe6, 0x67, 0x65,
+    0xf3, 0xf3, 0xb2, 0xf9, 0x49, 0xf9, 0x66, 0x57, 0xce, 0x03, 0xe5, 0x54,
+    0xff, 0xad,
+  };
+
+/* zstd -3 of fill_noise (1000 bytes), stored as a raw block.  */
+static const grub_uint8_t noise_l3[] =
+  {
+    0x28, 0xb5, 0x2f, 0xfd, 0x64, 0xe8, 0x02, 0x41, 0x1f, 0x00, 0xc6, 0x7e,
+    0x81, 0x6b, 0x4b, 0xfb, 0xe2, 0xfb, 0x54, 0xf6, 0xbd, 0xdf, 0x7c, 0x1c,
+    0xe1, 0x87, 0x01, 0xbf, 0x31, 0xde, 0x56, 0x72, 0x0f, 0x47, 0x67, 0x66,
+    0x87, 0x59, 0xaa, 0x88, 0x3c, 0x59, 0xea, 0x56, 0x13, 0x7b, 0xd2, 0x85,
+    0xa1, 0xd8, 0x3c, 0x54, 0x55, 0x2f, 0x37, 0xae, 0x65, 0x5b, 0xda, 0x02,
+    0x79, 0x98, 0xcc, 0xe3, 0x1a, 0x76, 0x8e, 0x5f, 0xd9, 0x99, 0x8f, 0x1f,
+    0x3f, 0x36, 0xee, 0x43, 0x78, 0x4d, 0x0d, 0xfa, 0xbe, 0xa6, 0xda, 0xe4,
+    0x86, 0x8e, 0xdc, 0x29, 0x6d, 0x4e, 0xff, 0x56, 0xe1, 0x70, 0x20, 0xfb,
+    0x8f, 0xb1, 0x58, 0x05, 0x90, 0xc5, 0x09, 0xdc, 0x53, 0xcd, 0xaa, 0x3b,
+    0x48, 0x99, 0x52, 0xd3, 0x52, 0x9d, 0x06, 0x9f, 0xea, 0xb5, 0xc2, 0x06,
+    0x13, 0x98, 0x49, 0xb2, 0x01, 0x1e, 0xac, 0x32, 0x88, 0x31, 0x9c, 0x52,
+    0x46, 0x95, 0x71, 0x36, 0x8f, 0x57, 0xf6, 0x39, 0x1d, 0x16, 0xfa, 0x88,
+    0x74, 0xf5, 0x98, 0x7c, 0x17, 0x5c, 0x41, 0xbb, 0x6d, 0x71, 0x8e, 0x0f,
+    0x70, 0x59, 0xc7, 0x01, 0x1b, 0x2f, 0x33, 0x3d, 0x91, 0xc0, 0x1d, 0xa5,
+    0x0d, 0x0d, 0xab, 0x33, 0x8d, 0x7e, 0x5e, 0x8f, 0x3e, 0xe6, 0x68, 0x74,
+    0xa6, 0x3a, 0xb1, 0xc3, 0x93, 0x11, 0xa8, 0x64, 0xc7, 0xdb, 0xca, 0xe0,
+    0x60, 0xe1, 0xf3, 0xbf, 0x09, 0x00, 0x67, 0xa2, 0xe3, 0x25, 0xa0, 0x21,
+    0x31, 0x87, 0xd5, 0x62, 0xc5, 0xa8, 0x4f, 0x7e, 0x2e, 0x09, 0x6b, 0x94,
+    0x9f, 0xb0, 0x6d, 0xa9, 0x9e, 0x5a, 0x0b, 0x46, 0x70, 0x80, 0xb6, 0xcf,
+    0x47, 0x0c, 0xa6, 0xa5, 0x2a, 0xd8, 0xac, 0xfb, 0xa0, 0xeb, 0xb7, 0x79,
+    0x24, 0x72, 0x23, 0x92, 0x48, 0x80, 0xc5, 0xa6, 0xa7, 0x85, 0xb7, 0xd7,
+    0x8c, 0x90, 0xe4, 0xab, 0x63, 0x44, 0x52, 0x66, 0xe3, 0x9c, 0x33, 0x25,
+    0xf9, 0x5e, 0xaa, 0xba, 0x73, 0x60, 0x5d, 0x4b, 0x71, 0x7e, 0xbe, 0xa9,
+    0x8c, 0x57, 0x19, 0x71, 0xc3, 0xca, 0x5e, 0xe5, 0x2a, 0x33, 0xac, 0x88,
+    0x51, 0x66, 0xa1, 0x7b, 0x75, 0x67, 0x64, 0x9a, 0x69, 0xef, 0x6f, 0x56,
+    0x42, 0xa0, 0x1d, 0x51, 0xc5, 0x02, 0xf7, 0xbb, 0x92, 0x45, 0xbe, 0x6f,
+    0x0d, 0xb6, 0x38, 0xcc, 0x10, 0xfd, 0xbb, 0x54, 0x51, 0x1c, 0x7b, 0x07,
+    0x94, 0x27, 0x93, 0x7d, 0x92, 0xc3, 0xd4, 0xc6, 0xa5, 0x61, 0x51, 0x01,
+    0x38, 0x38, 0xa7, 0xbf, 0xf1, 0x04, 0x0d, 0x15, 0x9b, 0x80, 0x1f, 0x83,
+    0xd5, 0xa4, 0x69, 0x88, 0x7c, 0x9f, 0xb6, 0x01, 0xda, 0x93, 0x17, 0x45,
+    0x8b, 0x12, 0xb2, 0x02, 0x33, 0x5c, 0x50, 0xd6, 0xe1, 0x56, 0xa4, 0xad,
+    0x42, 0x4a, 0x5c, 0xdd, 0x86, 0x61, 0xe9, 0x03, 0x12, 0xe1, 0x0f, 0x9b,
+    0xea, 0x26, 0x2c, 0x61, 0xdc, 0x62, 0x48, 0x6b, 0x6d, 0x14, 0xe0, 0x03,
+    0x85, 0x4a, 0x72, 0x46, 0xda, 0x96, 0xc8, 0x7d, 0x1c, 0xd1, 0x05, 0x3e,
+    0xe5, 0x92, 0x70, 0x43, 0x5f, 0x6c, 0x03, 0x05, 0xb3, 0xeb, 0xb3, 0x20,
+    0x35, 0x4d, 0x7e, 0x66, 0x50, 0x01, 0x36, 0xc0, 0x33, 0xe1, 0x0f, 0xc9,
+    0x38, 0x2e, 0xe9, 0x29, 0x19, 0x4f, 0x5e, 0xb1, 0xd1, 0x49, 0x8b, 0x3b,
+    0x53, 0xfd, 0x9f, 0x3f, 0xee, 0x25, 0x25, 0x35, 0x7b, 0x0d, 0x11, 0xaf,
+    0x4c, 0x11, 0x8c, 0x32, 0xd4, 0xda, 0x7f, 0xd8, 0x16, 0x57, 0xe1, 0xa6,
+    0xce, 0x7d, 0xc1, 0xae, 0x62, 0xbf, 0x13, 0xe4, 0x87, 0x4c, 0x3a, 0xc1,
+    0xb3, 0x0c, 0x59, 0x99, 0x47, 0x58, 0x5a, 0xbd, 0x78, 0x7c, 0xba, 0x50,
+    0x01, 0xed, 0x1b, 0xea, 0x8a, 0x49, 0x88, 0xee, 0xd6, 0x14, 0x85, 0xab,
+    0xb0, 0x2c, 0xde, 0x35, 0x93, 0x11, 0x2d, 0x01, 0x1c, 0xd7, 0x28, 0x43,
+    0x30, 0xe7, 0xb0, 0x08, 0xed, 0x79, 0x99, 0x13, 0x51, 0xd2, 0x3a, 0x77,
+    0xad, 0x3d, 0xb4, 0xf8, 0xc7, 0xca, 0x03, 0x22, 0xd2, 0xc9, 0xc6, 0x27,
+    0x0f, 0x04, 0xce, 0x7a, 0x3f, 0xc0, 0x68, 0x2c, 0xcf, 0x72, 0x6a, 0x09,
+    0xc2, 0x42, 0x00, 0x72, 0x5e, 0x41, 0x34, 0xf8, 0x96, 0x69, 0x3f, 0xbd,
+    0x3a, 0x58, 0x91, 0x8b, 0xe1, 0xcc, 0xa2, 0xb1, 0x92, 0xdd, 0x77, 0xa1,
+    0x35, 0xfe, 0xf3, 0x4b, 0xbc, 0xb1, 0xe3, 0x37, 0x11, 0x0d, 0xc7, 0x65,
+    0xbe, 0xf1, 0x61, 0xe5, 0x5e, 0x06, 0xff, 0x35, 0xc7, 0x76, 0x89, 0x5d,
+    0xf4, 0x6e, 0x4a, 0xcc, 0xb5, 0x54, 0x7e, 0xf1, 0x15, 0xc8, 0xa0, 0x99,
+    0x8f, 0x5c, 0x70, 0x0b, 0xef, 0x14, 0xc6, 0xe5, 0x0a, 0x9c, 0x19, 0xb4,
+    0x1d, 0x4c, 0xce, 0x56, 0x06, 0xdc, 0x42, 0x11, 0x25, 0xe7, 0x96, 0x6f,
+    0x0f, 0x21, 0x3d, 0xdf, 0xf9, 0x57, 0x47, 0x0d, 0xdf, 0x2b, 0x6a, 0xfc,
+    0x77, 0x8d, 0xd5, 0xe9, 0xd9, 0xf9, 0xb5, 0xe0, 0xeb, 0x72, 0x84, 0x1a,
+    0x8e, 0x42, 0x14, 0x1d, 0x8a, 0x6e, 0x5f, 0x92, 0x3a, 0xfb, 0x0b, 0xe5,
+    0xf6, 0xe4, 0xc0, 0x9f, 0x45, 0xd6, 0x2a, 0x83, 0xbf, 0xb1, 0xcd, 0x6a,
+    0xc4, 0xbf, 0x8c, 0xde, 0xdf, 0xb2, 0xf7, 0x79, 0xf7, 0x60, 0x57, 0xfc,
+    0x3b, 0x3d, 0x7b, 0x2e, 0xcb, 0x9c, 0x41, 0x7b, 0x27, 0xa5, 0xe3, 0x48,
+    0x58, 0x15, 0x07, 0x17, 0xe0, 0xb9, 0x85, 0x5f, 0x63, 0xa8, 0xf6, 0x29,
+    0x12, 0x43, 0x00, 0x6a, 0xdb, 0xee, 0x64, 0x24, 0x52, 0x8b, 0xc4, 0x3b,
+    0x5d, 0xbb, 0x35, 0x18, 0xa2, 0xd3, 0x89, 0xff, 0xb2, 0xa0, 0x59, 0x30,
+    0xf2, 0xdb, 0xd5, 0xc1, 0x4d, 0x6a, 0x4b, 0x36, 0x9c, 0x5d, 0x78, 0xe6,
+    0xd0, 0xa3, 0x92, 0x0d, 0xe5, 0x90, 0x11, 0xb0, 0x86, 0x0f, 0x41, 0x34,
+    0x80, 0xa6, 0x89, 0xbd, 0xe9, 0x2f, 0x78, 0x47, 0x0d, 0x50, 0x95, 0x87,
+    0x1b, 0xbf, 0xe3, 0x7f, 0x94, 0x37, 0x36, 0xe4, 0x6f, 0x39, 0x38, 0x2f,
+    0x0c, 0x83, 0x3a, 0x85, 0xdf, 0x51, 0xbc, 0x48, 0xd9, 0x56, 0xbb, 0x79,
+    0x95, 0x79, 0xbd, 0xd4, 0x48, 0x50, 0x9d, 0xa9, 0x65, 0x5d, 0x17, 0x7c,
+    0x13, 0x0b, 0x12, 0x5c, 0x4f, 0x67, 0xb0, 0x04, 0xe1, 0x9e, 0x18, 0xb3,
+    0x00, 0x3a, 0xfe, 0xcb, 0xc4, 0x1c, 0xf7, 0x2b, 0x50, 0x38, 0x7e, 0x4e,
+    0xbb, 0x13, 0xc5, 0x20, 0xc3, 0xfe, 0x3d, 0xa4, 0x30, 0x0f, 0xe4, 0x47,
+    0x0a, 0xe4, 0x52, 0x01, 0x7a, 0x17, 0x81, 0x31, 0x80, 0x80, 0x5f, 0x35,
+    0x5a, 0x2d, 0x15, 0xcc, 0xb0, 0x22, 0x15, 0x2d, 0x80, 0xd1, 0xe6, 0xe4,
+    0xcc, 0x58, 0xaf, 0x6f, 0x05, 0x7d, 0x85, 0x9c, 0x35, 0x6a, 0x74, 0xa0,
+    0xf0, 0x28, 0x4f, 0xf7, 0xf9, 0xdc, 0x38, 0x00, 0xb3, 0xc4, 0xee, 0x54,
+    0x4e, 0xf1, 0xd9, 0xea, 0xad, 0xc2, 0xd7, 0xeb, 0x19, 0x24, 0xc4, 0x56,
+    0xa8, 0x8b, 0xcb, 0x54, 0x6b, 0xaf, 0x70, 0x58, 0x5a, 0x07, 0x59, 0xfe,
+    0x00, 0x06, 0xdf, 0xa1, 0xe6, 0x18, 0x59, 0xba, 0xc1, 0x5b, 0x23, 0xfc,
+    0x5b, 0x1e, 0x70, 0x30, 0x42, 0x1a, 0xd4, 0xd0, 0x32, 0x72, 0x90, 0x66,
+    0x42, 0x6c, 0x9d, 0xa2, 0xd1, 0xed, 0x77, 0x3e, 0x30, 0xb6, 0xae, 0x92,
+    0x0d, 0x61, 0x2e, 0xf6, 0xa2, 0x1a, 0x49, 0xdb, 0xa1, 0x1d, 0x89, 0xa8,
+    0xde, 0xf2, 0x38, 0x56, 0xba, 0x6b, 0xab, 0xca, 0x53, 0x5a, 0x53, 0xf6,
+    0x6d, 0x13, 0x81, 0xae, 0x1f, 0xa5, 0xfc, 0x4a, 0x3d, 0xd7, 0x45, 0x01,
+    0x89, 0xe4, 0xa4, 0x00, 0x98, 0xf6, 0xfb, 0x4d, 0x86, 0x64, 0x46, 0x5f,
+    0x59, 0xac, 0x1d, 0xa8, 0x6f, 0xfb,
+  };
+
+/* zstd -3 of 200000 zero bytes, a single RLE block.  */
+static const grub_uint8_t zeros_l3[] =
+  {
+    0x28, 0xb5, 0x2f, 0xfd, 0xa4, 0x40, 0x0d, 0x03, 0x00, 0x54, 0x00, 0x00,
+    0x10, 0x00, 0x00, 0x01, 0x00, 0xfb, 0xff, 0x39, 0xc0, 0x02, 0x03, 0x6a,
+    0x08, 0x00, 0xc4, 0xe9, 0x74, 0x70,
+  };
+
+struct vector
+{
+  const char *name;
+  const grub_uint8_t *frame;
+  grub_size_t frame_size;
+  void (*fill) (grub_uint8_t *buf, grub_size_t size);
+  grub_size_t size;
+};
+
+#define VECTOR(name, fill, size) { #name, name, sizeof (name), fill, size }
+
+static const struct vector vectors[] =
+  {
+    VECTOR (words_l19, fill_words, 3000),
+    VECTOR (repeats_l3, fill_repeats, 300000),
+    VECTOR (repeats_l19, fill_repeats, 300000),
+    VECTOR (noise_l3, fill_noise, 1000),
+    VECTOR (zeros_l3, fill_zeros, 200000)
+  };
+
+static grub_uint8_t *
+expected_data (const struct vector *v)
+{
+  grub_uint8_t *buf = malloc (v->size);
+
+  if (buf)
+    {
+      seed = 1;
+      v->fill (buf, v->size);
+    }
+  return buf;
+}
+
+static void
+check_vector (const struct vector *v)
+{
+  grub_uint8_t *expected, *out;
+  static const grub_size_t offsets[] = { 0, 1, 4095, 4096, 131072, 131073 };
+  grub_ssize_t ret;
+  unsigned i;
+
+  expected = expected_data (v);
+  out = malloc (v->size + 16);
+  if (!expected || !out)
+    {
+      grub_test_assert (0, "out of memory");
+      goto out;
+    }
+
+  /* The whole thing, with room to spare.  */
+  ret = grub_zstd_decompress (v->frame, v->frame_size, 0, out, v->size + 16);
+  grub_test_assert (ret == (grub_ssize_t) v->size,
+		    "%s: got %d bytes instead of %d", v->name, (int) ret,
+		    (int) v->size);
+  grub_test_assert (ret < 0 || memcmp (out, expected, v->size) == 0,
+		    "%s: wrong data", v->name);
+  grub_errno = GRUB_ERR_NONE;
+
+  /* Windows into the output, as the filesystems read them.  */
+  for (i = 0; i < ARRAY_SIZE (offsets); i++)
+    {
+      grub_size_t off = offsets[i], len = 1000;
+
+      if (off >= v->size)
+	continue;
+      if (len > v->size - off)
+	len = v->size - off;
+      ret = grub_zstd_decompress (v->frame, v->frame_size, off, out, len);
+      grub_test_assert (ret == (grub_ssize_t) len,
+			"%s: got %d bytes at offset %d", v->name, (int) ret,
+			(int) off);
+      grub_test_assert (ret < 0 || memcmp (out, expected + off, len) == 0,
+			"%s: wrong data at offset %d", v->name, (int) off);
+      grub_errno = GRUB_ERR_NONE;
+    }
+
+ out:
+  free (expected);
+  free (out);
+}
+
+static void
+check_framing (void)
+{
+  static const grub_uint8_t skippable[] =
+    { 0x5e, 0x2a, 0x4d, 0x18, 0x03, 0x00, 0x00, 0x00, 0xaa, 0xbb, 0xcc };
+  grub_uint8_t *in, *out, *words, *noise;
+  grub_size_t insize;
+  grub_ssize_t ret;
+
+  words = expected_data (&vectors[0]);
+  noise = expected_data (&vectors[3]);
+  in = malloc (sizeof (words_l19) + sizeof (skippable) + sizeof (noise_l3)
+	       + 512);
+  out = malloc (4000);
+  if (!words || !noise || !in || !out)
+    {
+      grub_test_assert (0, "out of memory");
+      goto out;
+    }
+
+  /* Concatenated frames with a skippable one in between, followed by the
+     zero padding of a compressed extent.  */
+  insize = 0;
+  memcpy (in + insize, words_l19, sizeof (words_l19));
+  insize += sizeof (words_l19);
+  memcpy (in + insize, skippable, sizeof (skippable));
+  insize += sizeof (skippable);
+  memcpy (in + insize, noise_l3, sizeof (noise_l3));
+  insize += sizeof (noise_l3);
+  memset (in + insize, 0, 512);
+  insize += 512;
+
+  ret = grub_zstd_decompress (in, insize, 0, out, 4000);
+  grub_test_assert (ret == 4000, "concatenated frames: got %d bytes",
+		    (int) ret);
+  grub_test_assert (ret != 4000
+		    || (memcmp (out, words, 3000) == 0
+			&& memcmp (out + 3000, noise, 1000) == 0),
+		    "concatenated frames: wrong data");
+  grub_errno = GRUB_ERR_NONE;
+
+  /* Garbage must be rejected, not crash.  */
+  ret = grub_zstd_decompress (noise, 1000, 0, out, 4000);
+  grub_test_assert (ret < 0 && grub_errno == GRUB_ERR_BAD_COMPRESSED_DATA,
+		    "garbage was not rejected");
+  grub_errno = GRUB_ERR_NONE;
+
+ out:
+  free (words);
+  free (noise);
+  free (in);
+  free (out);
+}
+
+/* Flip bytes all over a frame: the result does not matter as long as the
+   decoder stays within its buffers.  */
+static void
+check_corruption (void)
+{
+  grub_uint8_t *in, *out;
+  grub_size_t i;
+
+  in = malloc (sizeof (repeats_l19));
+  out = malloc (300000);
+  if (!in || !out)
+    {
+      grub_test_assert (0, "out of memory");
+      goto out;
+    }
+
+  seed = 7;
+  for (i = 0; i < 2000; i++)
+    {
+      memcpy (in, repeats_l19, sizeof (repeats_l19));
+      in[next_random () % sizeof (repeats_l19)] ^= 1 << (next_random () & 7);
+      in[next_random () % sizeof (repeats_l19)] = next_random ();
+      grub_zstd_decompress (in, sizeof (repeats_l19), 0, out, 300000);
+      grub_errno = GRUB_ERR_NONE;
+    }
+
+ out:
+  free (in);
+  free (out);
+}
+
+static void
+benchmark (void)
+{
+  const struct vector *v = &vectors[2];
+  grub_uint8_t *out;
+  clock_t start;
+  double secs;
+  int i;
+
+  out = malloc (v->size);
+  if (!out)
+    return;
+
+  start = clock ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    grub_zstd_decompress (v->frame, v->frame_size, 0, out, v->size);
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  if (secs > 0)
+    printf ("zstd: %s decodes at %.0f MB/s\n", v->name,
+	    (double) BENCH_ROUNDS * v->size / secs / 1e6);
+  free (out);
+}
+
+static void
+zstd_test (void)
+{
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (vectors); i++)
+    check_vector (&vectors[i]);
+  check_framing ();
+  check_corruption ();
+  benchmark ();
+}
+
+GRUB_UNIT_TEST ("zstd_unit_test", zstd_test);
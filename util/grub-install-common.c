@@ -32,6 +32,7 @@
 #include <grub/crypto.h>
 #include <grub/command.h>
 #include <grub/i18n.h>
+#include <grub/dl.h>
 #include <grub/zfs/zfs.h>
 #include <grub/util/install.h>
 #include <grub/util/resolve.h>
@@ -72,6 +73,7 @@ grub_install_help_filter (int key, const char *text,
 #pragma GCC diagnostic error "-Wformat-nonliteral"
 
 static int (*compress_func) (const char *src, const char *dest) = NULL;
+static int module_bundle;
 char *grub_install_copy_buffer;
 
 int
@@ -199,7 +201,8 @@ clean_grub_dir (const char *di)
 		   || strcmp (ext, ".mo") == 0)
 	   && strcmp (de->d_name, "menu.lst") != 0)
 	  || strcmp (de->d_name, "efiemu32.o") == 0
-	  || strcmp (de->d_name, "efiemu64.o") == 0)
+	  || strcmp (de->d_name, "efiemu64.o") == 0
+	  || strcmp (de->d_name, GRUB_DL_BUNDLE_NAME) == 0)
 	{
 	  char *x = grub_util_path_concat (2, di, de->d_name);
 	  if (grub_util_unlink (x) < 0)
@@ -387,6 +390,9 @@ grub_install_parse (int key, char *arg)
 	  return 1;
 	}
       grub_util_error (_("Unrecognized compression `%s'"), arg);
+    case GRUB_INSTALL_OPTIONS_MODULE_BUNDLE:
+      module_bundle = 1;
+      return 1;
     case GRUB_INSTALL_OPTIONS_GRUB_MKIMAGE:
       return 1;
     default:
@@ -718,6 +724,198 @@ grub_install_get_platform_platform (enum grub_install_plat platid)
 }
 
 
+static char *
+bundle_module_name (const char *path)
+{
+  const char *base = strrchr (path, '/');
+  size_t len;
+  char *ret;
+
+  base = base ? base + 1 : path;
+  len = strlen (base);
+  if (len > 4 && strcmp (base + len - 4, ".mod") == 0)
+    len -= 4;
+  ret = xmalloc (len + 1);
+  memcpy (ret, base, len);
+  ret[len] = '\0';
+  return ret;
+}
+
+static int
+bundle_cmp_index (const void *p1, const void *p2)
+{
+  grub_uint32_t a = *(const grub_uint32_t *) p1;
+  grub_uint32_t b = *(const grub_uint32_t *) p2;
+
+  return (a > b) - (a < b);
+}
+
+/* Pack every module installed in DST_PLATFORM into GRUB_DL_BUNDLE_NAME
+   there, in dependency order, with the full list of modules each one needs.
+   The images are taken uncompressed from SRC.  */
+static void
+make_module_bundle (const char *src, const char *dst_platform)
+{
+  grub_util_fd_dir_t d;
+  grub_util_fd_dirent_t de;
+  char **installed = NULL;
+  size_t ninstalled = 0;
+  struct grub_util_path_list *order, *p;
+  struct
+  {
+    char *name;
+    const char *path;
+    size_t size;
+    grub_uint32_t *deps;
+    grub_uint32_t ndeps;
+  } *mods = NULL;
+  size_t nmods = 0, ndeps = 0, names_size = 0, index_size, i, j;
+  grub_uint64_t offset;
+  struct grub_dl_bundle_header hdr;
+  char *index, *dstf;
+  FILE *fp;
+
+  d = grub_util_fd_opendir (dst_platform);
+  if (!d)
+    grub_util_error (_("cannot open directory `%s': %s"),
+		     dst_platform, grub_util_fd_strerror ());
+  while ((de = grub_util_fd_readdir (d)))
+    {
+      const char *ext = strrchr (de->d_name, '.');
+      if (ext && strcmp (ext, ".mod") == 0)
+	{
+	  installed = xrealloc (installed,
+				(ninstalled + 2) * sizeof (installed[0]));
+	  installed[ninstalled++] = bundle_module_name (de->d_name);
+	}
+    }
+  grub_util_fd_closedir (d);
+  if (!ninstalled)
+    return;
+  /* Keep the output independent of directory order.  */
+  qsort (installed, ninstalled, sizeof (installed[0]), grub_qsort_strcmp);
+  installed[ninstalled] = NULL;
+
+  /* Dependencies come before their users here.  */
+  order = grub_util_resolve_dependencies (src, "moddep.lst", installed);
+  for (p = order; p; p = p->next)
+    {
+      if (!grub_util_is_regular (p->name))
+	{
+	  grub_util_warn (_("cannot open `%s': %s"), p->name, strerror (errno));
+	  grub_util_warn ("%s", _("not creating the module bundle"));
+	  goto out;
+	}
+      mods = xrealloc (mods, (nmods + 1) * sizeof (mods[0]));
+      mods[nmods].name = bundle_module_name (p->name);
+      mods[nmods].path = p->name;
+      mods[nmods].size = grub_util_get_image_size (p->name);
+      names_size += strlen (mods[nmods].name) + 1;
+      nmods++;
+    }
+
+  for (i = 0; i < nmods; i++)
+    {
+      char *one[2] = { mods[i].name, NULL };
+      struct grub_util_path_list *closure, *q;
+
+      closure = grub_util_resolve_dependencies (src, "moddep.lst", one);
+      mods[i].deps = NULL;
+      mods[i].ndeps = 0;
+      for (q = closure; q; q = q->next)
+	{
+	  char *name = bundle_module_name (q->name);
+
+	  for (j = 0; j < i; j++)
+	    if (strcmp (mods[j].name, name) == 0)
+	      break;
+	  /* Everything else is the module itself.  */
+	  if (j < i)
+	    {
+	      mods[i].deps = xrealloc (mods[i].deps, (mods[i].ndeps + 1)
+				       * sizeof (mods[i].deps[0]));
+	      mods[i].deps[mods[i].ndeps++] = j;
+	    }
+	  free (name);
+	}
+      grub_util_free_path_list (closure);
+      if (mods[i].ndeps)
+	qsort (mods[i].deps, mods[i].ndeps, sizeof (mods[i].deps[0]),
+	       bundle_cmp_index);
+      ndeps += mods[i].ndeps;
+    }
+
+  index_size = nmods * sizeof (struct grub_dl_bundle_entry)
+    + ndeps * sizeof (grub_uint32_t) + names_size;
+  index = xmalloc (index_size);
+  offset = ALIGN_UP (sizeof (hdr) + index_size, GRUB_DL_BUNDLE_ALIGN);
+  {
+    struct grub_dl_bundle_entry *entries = (void *) index;
+    grub_uint32_t *deps = (void *) (index + nmods * sizeof (entries[0]));
+    char *names = (char *) (deps + ndeps);
+    grub_uint32_t dep_pos = 0, name_pos = 0;
+
+    for (i = 0; i < nmods; i++)
+      {
+	if (offset + mods[i].size > GRUB_UINT_MAX)
+	  grub_util_error ("%s", _("module bundle is too large"));
+	entries[i].offset = grub_cpu_to_le32 (offset);
+	entries[i].size = grub_cpu_to_le32 (mods[i].size);
+	entries[i].name = grub_cpu_to_le32 (name_pos);
+	entries[i].first_dep = grub_cpu_to_le32 (dep_pos);
+	entries[i].ndeps = grub_cpu_to_le32 (mods[i].ndeps);
+	for (j = 0; j < mods[i].ndeps; j++)
+	  deps[dep_pos++] = grub_cpu_to_le32 (mods[i].deps[j]);
+	strcpy (names + name_pos, mods[i].name);
+	name_pos += strlen (mods[i].name) + 1;
+	offset = ALIGN_UP (offset + mods[i].size, GRUB_DL_BUNDLE_ALIGN);
+      }
+  }
+
+  memcpy (hdr.magic, GRUB_DL_BUNDLE_MAGIC, sizeof (hdr.magic));
+  hdr.nmods = grub_cpu_to_le32 (nmods);
+  hdr.ndeps = grub_cpu_to_le32 (ndeps);
+  hdr.index_size = grub_cpu_to_le32 (index_size);
+  hdr.reserved = 0;
+
+  dstf = grub_util_path_concat (2, dst_platform, GRUB_DL_BUNDLE_NAME);
+  fp = grub_util_fopen (dstf, "wb");
+  if (!fp)
+    grub_util_error (_("cannot open `%s': %s"), dstf, strerror (errno));
+  grub_util_write_image ((char *) &hdr, sizeof (hdr), fp, dstf);
+  grub_util_write_image (index, index_size, fp, dstf);
+  offset = sizeof (hdr) + index_size;
+  for (i = 0; i < nmods; i++)
+    {
+      static const char zero[GRUB_DL_BUNDLE_ALIGN];
+      char *img;
+
+      grub_util_write_image (zero, ALIGN_UP (offset, GRUB_DL_BUNDLE_ALIGN)
+			     - offset, fp, dstf);
+      offset = ALIGN_UP (offset, GRUB_DL_BUNDLE_ALIGN);
+      img = grub_util_read_image (mods[i].path);
+      grub_util_write_image (img, mods[i].size, fp, dstf);
+      free (img);
+      offset += mods[i].size;
+    }
+  grub_util_file_sync (fp);
+  fclose (fp);
+  free (dstf);
+  free (index);
+
+ out:
+  for (i = 0; i < nmods; i++)
+    {
+      free (mods[i].name);
+      free (mods[i].deps);
+    }
+  free (mods);
+  grub_util_free_path_list (order);
+  for (i = 0; i < ninstalled; i++)
+    free (installed[i]);
+  free (installed);
+}
+
 void
 grub_install_copy_files (const char *src,
 			 const char *dst,
@@ -727,6 +925,11 @@ grub_install_copy_files (const char *src,
   const char *pkgdatadir = grub_util_get_pkgdatadir ();
   char *themes_dir;
 
+  /* Every insmod seeks to its module in the bundle, and a compressed
+     stream would have to be decompressed from the start each time.  */
+  if (module_bundle && compress_func)
+    grub_util_error ("%s", _("--module-bundle can't be used with --compress"));
+
   {
     char *platform;
     platform = xasprintf ("%s-%s", platforms[platid].cpu,
@@ -769,6 +972,9 @@ grub_install_copy_files (const char *src,
       grub_util_free_path_list (path_list);
     }
 
+  if (module_bundle)
+    make_module_bundle (src, dst_platform);
+
   const char *pkglib_DATA[] = {"efiemu32.o", "efiemu64.o",
 			       "moddep.lst", "command.lst",
 			       "fs.lst", "partmap.lst",
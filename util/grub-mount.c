@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #pragma GCC diagnostic ignored "-Wmissing-prototypes"
 #pragma GCC diagnostic ignored "-Wmissing-declarations"
@@ -59,6 +60,13 @@ static int fuse_argc = 0;
 static int num_disks = 0;
 static int mount_crypt = 0;
 
+/* FUSE runs its callbacks from several threads, but grub_errno, the disk
+   cache, the loopback files and the filesystem drivers are shared and
+   unlocked.  Every call into GRUB, reads included, holds this lock; only
+   FUSE's own work and the copies to and from the kernel run in
+   parallel.  */
+static pthread_mutex_t grub_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static grub_err_t
 execute_command (const char *name, int n, char **args)
 {
@@ -147,7 +155,7 @@ fuse_getattr_find_file (const char *cur_filename,
 }
 
 static int
-fuse_getattr (const char *path, struct stat *st)
+fuse_getattr_real (const char *path, struct stat *st)
 {
   struct fuse_getattr_ctx ctx;
   char *pathname, *path2;
@@ -230,58 +238,79 @@ fuse_getattr (const char *path, struct stat *st)
   return 0;
 }
 
+static int
+fuse_getattr (const char *path, struct stat *st)
+{
+  int ret;
+
+  pthread_mutex_lock (&grub_lock);
+  ret = fuse_getattr_real (path, st);
+  pthread_mutex_unlock (&grub_lock);
+  return ret;
+}
+
 static int
 fuse_opendir (const char *path, struct fuse_file_info *fi) 
 {
   return 0;
 }
 
-/* FIXME */
-static grub_file_t files[65536];
-static int first_fd = 1;
-
+/* The open file lives in FI->fh until release, so reads only seek.  */
 static int 
-fuse_open (const char *path, struct fuse_file_info *fi __attribute__ ((unused)))
+fuse_open (const char *path, struct fuse_file_info *fi)
 {
   grub_file_t file;
+  int ret = 0;
+
+  pthread_mutex_lock (&grub_lock);
   file = grub_file_open (path);
   if (! file)
-    return translate_error ();
-  files[first_fd++] = file;
-  fi->fh = first_fd;
-  files[first_fd++] = file;
-  grub_errno = GRUB_ERR_NONE;
-  return 0;
+    ret = translate_error ();
+  else
+    {
+      fi->fh = (grub_addr_t) file;
+      /* Nothing changes the image behind the kernel's back.  */
+      fi->keep_cache = 1;
+      grub_errno = GRUB_ERR_NONE;
+    }
+  pthread_mutex_unlock (&grub_lock);
+  return ret;
 } 
 
 static int 
 fuse_read (const char *path, char *buf, size_t sz, off_t off,
 	   struct fuse_file_info *fi)
 {
-  grub_file_t file = files[fi->fh];
+  grub_file_t file = (grub_file_t) (grub_addr_t) fi->fh;
   grub_ssize_t size;
+  int ret;
 
   if (off > file->size)
     return -EINVAL;
 
+  /* Seek and read as one step, like pread.  */
+  pthread_mutex_lock (&grub_lock);
   file->offset = off;
-  
   size = grub_file_read (file, buf, sz);
   if (size < 0)
-    return translate_error ();
+    ret = translate_error ();
   else
     {
       grub_errno = GRUB_ERR_NONE;
-      return size;
+      ret = size;
     }
+  pthread_mutex_unlock (&grub_lock);
+  return ret;
 } 
 
 static int 
 fuse_release (const char *path, struct fuse_file_info *fi)
 {
-  grub_file_close (files[fi->fh]);
-  files[fi->fh] = NULL;
+  pthread_mutex_lock (&grub_lock);
+  grub_file_close ((grub_file_t) (grub_addr_t) fi->fh);
+  fi->fh = 0;
   grub_errno = GRUB_ERR_NONE;
+  pthread_mutex_unlock (&grub_lock);
   return 0;
 }
 
@@ -352,9 +381,11 @@ fuse_readdir (const char *path, void *buf,
 	 && pathname[grub_strlen (pathname) - 1] == '/')
     pathname[grub_strlen (pathname) - 1] = 0;
 
+  pthread_mutex_lock (&grub_lock);
   (fs->dir) (dev, pathname, fuse_readdir_call_fill, &ctx);
-  free (pathname);
   grub_errno = GRUB_ERR_NONE;
+  pthread_mutex_unlock (&grub_lock);
+  free (pathname);
   return 0;
 }
 
@@ -550,7 +581,10 @@ argp_parser (int key, char *arg, struct argp_state *state)
 
 struct argp argp = {
   options, argp_parser, N_("IMAGE1 [IMAGE2 ...] MOUNTPOINT"),
-  N_("Debug tool for filesystem driver."), 
+  N_("Debug tool for filesystem driver.")"\v"
+  N_("FUSE requests are accepted by several threads, but only one at a "
+     "time is served by GRUB, so reads are not done in parallel.  Pass -s "
+     "to run FUSE with a single thread."),
   NULL, NULL, NULL
 };
 
@@ -562,12 +596,9 @@ main (int argc, char *argv[])
 
   grub_util_host_init (&argc, &argv);
 
-  fuse_args = xrealloc (fuse_args, (fuse_argc + 2) * sizeof (fuse_args[0]));
+  fuse_args = xrealloc (fuse_args, (fuse_argc + 1) * sizeof (fuse_args[0]));
   fuse_args[fuse_argc] = xstrdup (argv[0]);
   fuse_argc++;
-  /* Run single-threaded.  */
-  fuse_args[fuse_argc] = xstrdup ("-s");
-  fuse_argc++;
 
   argp_parse (&argp, argc, argv, 0, 0, 0);
   